@@ -1,7 +1,10 @@
 // Copyright 2020 The Khronos® Group Inc.
 #pragma once
 
+#include <cstddef>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "GLTFBufferView.h"
 #include "GLTFConstants.h"
@@ -13,23 +16,47 @@ class Accessor : public GLTF::Object {
   enum class Type { SCALAR, VEC2, VEC3, VEC4, MAT2, MAT3, MAT4, UNKNOWN };
 
   GLTF::BufferView* bufferView = NULL;
-  int byteOffset = 0;
+  size_t byteOffset = 0;
   GLTF::Constants::WebGL componentType;
-  int count = 0;
+  size_t count = 0;
   float* max = NULL;
   float* min = NULL;
+  bool normalized = false;
   Type type = Type::UNKNOWN;
+  /**
+   * Sparse storage: the elements at the `sparseIndices` are replaced with
+   * the `sparseValues`. Other elements are read from the bufferView, or are
+   * zero without one.
+   */
+  GLTF::Accessor* sparseIndices = NULL;
+  GLTF::Accessor* sparseValues = NULL;
 
   Accessor(GLTF::Accessor::Type type, GLTF::Constants::WebGL componentType);
 
   Accessor(GLTF::Accessor::Type type, GLTF::Constants::WebGL componentType,
-           unsigned char* data, int count, GLTF::Constants::WebGL target);
+           unsigned char* data, size_t count, GLTF::Constants::WebGL target);
 
   Accessor(GLTF::Accessor::Type type, GLTF::Constants::WebGL componentType,
-           unsigned char* data, int count, GLTF::BufferView* bufferView);
+           unsigned char* data, size_t count, GLTF::BufferView* bufferView);
 
   Accessor(GLTF::Accessor::Type type, GLTF::Constants::WebGL componentType,
-           int byteOffset, int count, GLTF::BufferView* bufferView);
+           size_t byteOffset, size_t count, GLTF::BufferView* bufferView);
+
+  /**
+   * Creates an accessor on a new bufferView that takes ownership of `data`,
+   * moved in without copying it. The count follows from its size.
+   */
+  template <typename T>
+  Accessor(GLTF::Accessor::Type type, GLTF::Constants::WebGL componentType,
+           std::vector<T>&& data, GLTF::Constants::WebGL target)
+      : Accessor(type, componentType) {
+    size_t byteLength = data.size() * sizeof(T);
+    this->count =
+        byteLength / (getNumberOfComponents() * getComponentByteLength());
+    this->bufferView = new GLTF::BufferView(
+        0, byteLength, GLTF::Buffer::adopt(std::move(data)));
+    this->bufferView->target = target;
+  }
 
   explicit Accessor(GLTF::Accessor* accessor);
 
@@ -38,8 +65,17 @@ class Accessor : public GLTF::Object {
 
   bool computeMinMax();
   int getByteStride();
-  bool getComponentAtIndex(int index, float* component);
-  bool writeComponentAtIndex(int index, float* component);
+  bool getComponentAtIndex(size_t index, float* component);
+  bool writeComponentAtIndex(size_t index, float* component);
+  /** Reads every element into `count * getNumberOfComponents()` floats. */
+  bool getComponents(float* components);
+  /** Writes `count * getNumberOfComponents()` floats to every element. */
+  bool writeComponents(float* components);
+  /**
+   * Copies every element to `accessor`, which must have the same type,
+   * component type and count.
+   */
+  bool copyComponents(GLTF::Accessor* accessor);
   int getComponentByteLength();
   int getNumberOfComponents();
   bool equals(GLTF::Accessor* accessor);
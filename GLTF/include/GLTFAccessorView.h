@@ -0,0 +1,201 @@
+// Copyright 2020 The Khronos® Group Inc.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "GLTFAccessor.h"
+
+namespace GLTF {
+/**
+ * A typed view of the elements of an accessor, each `N` components of type
+ * `T`, `byteStride` bytes apart. Views are cheap to copy and do not own the
+ * data they point to.
+ *
+ * The component type of an accessor is only known at runtime, so views are
+ * usually created with `visitAccessor`, which dispatches once per accessor
+ * instead of once per component.
+ */
+template <typename T, int N>
+class AccessorView {
+ public:
+  /** Iterates over the elements of a view, yielding a pointer to each. */
+  class Iterator {
+   public:
+    Iterator(unsigned char* element, size_t byteStride)
+        : _element(element), _byteStride(byteStride) {}
+
+    T* operator*() const { return reinterpret_cast<T*>(_element); }
+    Iterator& operator++() {
+      _element += _byteStride;
+      return *this;
+    }
+    bool operator==(const Iterator& other) const {
+      return _element == other._element;
+    }
+    bool operator!=(const Iterator& other) const {
+      return _element != other._element;
+    }
+
+   private:
+    unsigned char* _element;
+    size_t _byteStride;
+  };
+
+  AccessorView(unsigned char* data, size_t count, size_t byteStride)
+      : _data(data), _count(count), _byteStride(byteStride) {}
+
+  /**
+   * Views the elements of an accessor, which must have a bufferView and
+   * match `T` and `N`.
+   */
+  explicit AccessorView(GLTF::Accessor* accessor)
+      : AccessorView(accessor->bufferView->buffer->data +
+                         accessor->bufferView->byteOffset +
+                         accessor->byteOffset,
+                     accessor->count, accessor->getByteStride()) {}
+
+  /** The number of elements. */
+  size_t size() const { return _count; }
+  size_t byteStride() const { return _byteStride; }
+
+  /** The `N` components of the element at `index`. */
+  T* operator[](size_t index) const {
+    return reinterpret_cast<T*>(_data + index * _byteStride);
+  }
+
+  /** Whether the elements are tightly packed, so `data` is a span. */
+  bool isContiguous() const { return _byteStride == N * sizeof(T); }
+
+  /**
+   * The components of every element, `size() * N` values if the view is
+   * contiguous.
+   */
+  T* data() const { return reinterpret_cast<T*>(_data); }
+
+  /** A view of the elements `[begin, end)`. */
+  AccessorView<T, N> slice(size_t begin, size_t end) const {
+    return AccessorView<T, N>(_data + begin * _byteStride, end - begin,
+                              _byteStride);
+  }
+
+  Iterator begin() const { return Iterator(_data, _byteStride); }
+  Iterator end() const { return Iterator(_data + _count * _byteStride, 0); }
+
+  /** Reads the element at `index` into `N` floats. */
+  void read(size_t index, float* component) const {
+    const T* element = (*this)[index];
+    for (int k = 0; k < N; k++) {
+      component[k] = static_cast<float>(element[k]);
+    }
+  }
+
+  /** Writes `N` floats to the element at `index`. */
+  void write(size_t index, const float* component) const {
+    T* element = (*this)[index];
+    for (int k = 0; k < N; k++) {
+      element[k] = static_cast<T>(component[k]);
+    }
+  }
+
+  /** Reads every element into `size() * N` floats. */
+  void readAll(float* values) const {
+    if (std::is_same<T, float>::value && isContiguous()) {
+      std::memcpy(values, _data, _count * N * sizeof(T));
+      return;
+    }
+    for (size_t i = 0; i < _count; i++) {
+      read(i, values + i * N);
+    }
+  }
+
+  /** Writes `size() * N` floats to every element. */
+  void writeAll(const float* values) const {
+    if (std::is_same<T, float>::value && isContiguous()) {
+      std::memcpy(_data, values, _count * N * sizeof(T));
+      return;
+    }
+    for (size_t i = 0; i < _count; i++) {
+      write(i, values + i * N);
+    }
+  }
+
+  /** Copies every element to a view of the same size, type and layout. */
+  void copyTo(const AccessorView<T, N>& target) const {
+    if (isContiguous() && target.isContiguous()) {
+      std::memcpy(target._data, _data, _count * N * sizeof(T));
+      return;
+    }
+    for (size_t i = 0; i < _count; i++) {
+      std::memcpy(target[i], (*this)[i], N * sizeof(T));
+    }
+  }
+
+ private:
+  unsigned char* _data;
+  size_t _count;
+  size_t _byteStride;
+};
+
+template <typename T, typename Visitor>
+bool visitAccessorComponents(GLTF::Accessor* accessor, Visitor* visitor) {
+  switch (accessor->getNumberOfComponents()) {
+    case 1:
+      (*visitor)(AccessorView<T, 1>(accessor));
+      return true;
+    case 2:
+      (*visitor)(AccessorView<T, 2>(accessor));
+      return true;
+    case 3:
+      (*visitor)(AccessorView<T, 3>(accessor));
+      return true;
+    case 4:
+      (*visitor)(AccessorView<T, 4>(accessor));
+      return true;
+    case 9:
+      (*visitor)(AccessorView<T, 9>(accessor));
+      return true;
+    case 16:
+      (*visitor)(AccessorView<T, 16>(accessor));
+      return true;
+  }
+  return false;
+}
+
+/**
+ * Calls `visitor` with an `AccessorView<T, N>` of the accessor's elements,
+ * where `T` and `N` match its component type and number of components. The
+ * visitor needs a templated call operator for every combination.
+ *
+ * The view covers the bufferView data only, without the substitutions of a
+ * sparse accessor.
+ *
+ * @return `false` without calling `visitor` if the accessor has no
+ * bufferView, its buffer has no data or it has an unknown component type
+ */
+template <typename Visitor>
+bool visitAccessor(GLTF::Accessor* accessor, Visitor* visitor) {
+  if (accessor->bufferView == NULL || accessor->bufferView->buffer == NULL ||
+      accessor->bufferView->buffer->data == NULL) {
+    return false;
+  }
+  switch (accessor->componentType) {
+    case GLTF::Constants::WebGL::BYTE:
+      return visitAccessorComponents<int8_t>(accessor, visitor);
+    case GLTF::Constants::WebGL::UNSIGNED_BYTE:
+      return visitAccessorComponents<uint8_t>(accessor, visitor);
+    case GLTF::Constants::WebGL::SHORT:
+      return visitAccessorComponents<int16_t>(accessor, visitor);
+    case GLTF::Constants::WebGL::UNSIGNED_SHORT:
+      return visitAccessorComponents<uint16_t>(accessor, visitor);
+    case GLTF::Constants::WebGL::FLOAT:
+      return visitAccessorComponents<float>(accessor, visitor);
+    case GLTF::Constants::WebGL::UNSIGNED_INT:
+      return visitAccessorComponents<uint32_t>(accessor, visitor);
+    default:
+      return false;
+  }
+}
+}  // namespace GLTF
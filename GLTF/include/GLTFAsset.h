@@ -1,12 +1,18 @@
 // Copyright 2020 The Khronos® Group Inc.
 #pragma once
 
+#include <map>
 #include <set>
 #include <string>
 #include <vector>
 
 #include "GLTFAnimation.h"
 #include "GLTFDracoExtension.h"
+#include "GLTFInstancingExtension.h"
+#include "GLTFLodExtension.h"
+#include "GLTFMeshOptimizer.h"
+#include "GLTFMeshoptCodec.h"
+#include "GLTFMeshoptExtension.h"
 #include "GLTFObject.h"
 #include "GLTFScene.h"
 #include "draco/compression/encode.h"
@@ -61,7 +67,29 @@ class Asset : public GLTF::Object {
   void mergeAnimations(std::vector<std::vector<size_t>> groups);
   void removeUnusedSemantics();
   void removeUnusedNodes(GLTF::Options* options);
-  GLTF::Buffer* packAccessors();
+  void deduplicateMeshes(size_t* meshCountBefore, size_t* meshCountAfter,
+                         size_t* bytesSaved);
+  void deduplicateAccessors(size_t* accessorCountBefore,
+                            size_t* accessorCountAfter, size_t* bytesSaved);
+  void optimizeVertexCache(GLTF::MeshOptimizer::VertexCacheStatistics* before,
+                           GLTF::MeshOptimizer::VertexCacheStatistics* after);
+  void weldVertices(const std::map<std::string, float>& tolerances,
+                    size_t* vertexCountBefore, size_t* vertexCountAfter,
+                    size_t* removedTriangles);
+  void optimizeOverdraw(float threshold);
+  void optimizeVertexFetch(GLTF::MeshOptimizer::VertexFetchStatistics* before,
+                           GLTF::MeshOptimizer::VertexFetchStatistics* after);
+  void mergeStaticPrimitives(size_t maxVertexCount, size_t* drawCountBefore,
+                             size_t* drawCountAfter);
+  void instanceMeshes(size_t* nodeCountBefore, size_t* nodeCountAfter);
+  void generateLods(const std::vector<float>& ratios,
+                    const std::vector<float>& screenCoverage, float error);
+  void quantizeAttributes(GLTF::Options* options);
+  void sparsifyMorphTargets(float threshold);
+  GLTF::Buffer* packAccessors(GLTF::Options* options,
+                              std::vector<GLTF::Buffer*>* buffers = NULL);
+  std::vector<GLTF::Buffer*> splitBuffer(GLTF::Buffer* buffer,
+                                         size_t maxByteLength);
 
   // Functions for Draco compression extension.
   std::vector<GLTF::BufferView*> getAllCompressedBufferView();
@@ -70,6 +98,9 @@ class Asset : public GLTF::Object {
   void removeAttributeFromDracoExtension(GLTF::Primitive* primitive,
                                          const std::string& semantic);
 
+  // Functions for meshopt compression extension.
+  GLTF::Buffer* compressBufferViews(GLTF::Buffer* buffer);
+
   void requireExtension(std::string extension);
   void useExtension(std::string extension);
   virtual void writeJSON(void* writer, GLTF::Options* options);
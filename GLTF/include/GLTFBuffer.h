@@ -1,7 +1,11 @@
 // Copyright 2020 The Khronos® Group Inc.
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "GLTFObject.h"
 
@@ -9,12 +13,50 @@ namespace GLTF {
 class Buffer : public GLTF::Object {
  public:
   unsigned char* data = NULL;
-  int byteLength;
+  size_t byteLength;
   std::string uri;
+  /**
+   * Written to its own file even by binary glTF, for the parts of a buffer too
+   * large for the container; see `Asset::splitBuffer`.
+   */
+  bool external = false;
+  /**
+   * Frees `data` when it was adopted rather than allocated with `malloc`,
+   * which is used otherwise.
+   */
+  std::function<void(unsigned char*)> deleter;
 
-  Buffer(unsigned char* data, int dataLength);
+  Buffer(unsigned char* data, size_t dataLength);
+  Buffer(unsigned char* data, size_t dataLength,
+         std::function<void(unsigned char*)> deleter);
+  Buffer(const GLTF::Buffer&) = delete;
+  GLTF::Buffer& operator=(const GLTF::Buffer&) = delete;
   virtual ~Buffer();
 
+  /**
+   * Creates a buffer that takes ownership of the elements of `data` without
+   * copying them.
+   */
+  template <typename T>
+  static GLTF::Buffer* adopt(std::vector<T>&& data) {
+    std::vector<T>* owned = new std::vector<T>(std::move(data));
+    return new GLTF::Buffer(reinterpret_cast<unsigned char*>(owned->data()),
+                            owned->size() * sizeof(T),
+                            [owned](unsigned char*) { delete owned; });
+  }
+
+  /**
+   * Resizes `data` to `byteLength` bytes, keeping the bytes that fit. Adopted
+   * data is copied to a `malloc` allocation first.
+   */
+  void resize(size_t byteLength);
+
+  /**
+   * Frees `data` and sets it to `NULL`, keeping `byteLength` for buffers
+   * whose data is no longer needed in memory.
+   */
+  void freeData();
+
   virtual std::string typeName();
   virtual void writeJSON(void* writer, GLTF::Options* options);
 };
@@ -0,0 +1,77 @@
+// Copyright 2020 The Khronos® Group Inc.
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace GLTF {
+/**
+ * Lays out a binary buffer from segments of data that stay where they are,
+ * such as the packed accessor data and the images of a binary glTF, and then
+ * streams them to a file in order. The buffer is never assembled in memory;
+ * where available, all segments are handed to the system in one vectored
+ * write.
+ */
+class BufferWriter {
+ private:
+  struct Segment {
+    const unsigned char* data;
+    size_t byteLength;
+  };
+
+  std::vector<Segment> _segments;
+  size_t _byteLength = 0;
+
+ public:
+  /**
+   * Places a segment at the end of the buffer. The data is only read by
+   * `write`, so it must stay alive until then.
+   *
+   * @param alignment The segment starts at a multiple of this, after zero
+   * padding
+   * @return The byte offset of the segment in the buffer
+   */
+  size_t add(const unsigned char* data, size_t byteLength,
+             size_t alignment = 4);
+
+  /**
+   * Places the segments of another buffer at the end of this one. The byte
+   * offsets of its segments move by the current length, so their alignment
+   * holds if this buffer is aligned to at least as much.
+   */
+  void append(const GLTF::BufferWriter& buffer);
+
+  /** Zero pads the buffer to a multiple of `alignment`. */
+  void pad(size_t alignment);
+
+  /** The byte length of the buffer, including padding between segments. */
+  size_t getByteLength() const;
+
+  /**
+   * Writes the segments and the padding between them to `file`.
+   * @return `false` if a write fails
+   */
+  bool write(FILE* file) const;
+};
+
+/**
+ * The most buffer data a binary glTF container can hold, leaving 64 MiB of
+ * its 4 GiB for the header and the JSON chunk. Larger buffers are split with
+ * `Asset::splitBuffer`.
+ */
+const size_t GLB_MAX_BUFFER_BYTE_LENGTH = 0xFFFFFFFFu - (64u << 20);
+
+/**
+ * Writes a binary glTF container: the header, the JSON chunk padded with
+ * spaces, and the segments of `buffer` as the BIN chunk. Everything is
+ * described as segments and written with a single `BufferWriter::write`.
+ *
+ * @param version 1 for KHR_binary_glTF, or 2
+ * @return `false` if the container would be over the 4 GiB its 32-bit
+ * lengths can describe, or if a write fails
+ */
+bool writeGLB(FILE* file, const std::string& json,
+              const GLTF::BufferWriter& buffer, int version);
+}  // namespace GLTF
@@ -0,0 +1,22 @@
+// Copyright 2020 The Khronos® Group Inc.
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "GLTFAccessor.h"
+#include "GLTFExtension.h"
+
+namespace GLTF {
+/**
+ * The EXT_mesh_gpu_instancing extension of a node, drawing its mesh once for
+ * each element of the `TRANSLATION`, `ROTATION` and `SCALE` accessors. Each
+ * instance transform is applied before the node's own transform.
+ */
+class InstancingExtension : public GLTF::Extension {
+ public:
+  std::map<std::string, GLTF::Accessor*> attributes;
+
+  virtual void writeJSON(void* writer, GLTF::Options* options);
+};
+}  // namespace GLTF
@@ -0,0 +1,27 @@
+// Copyright 2020 The Khronos® Group Inc.
+#pragma once
+
+#include <vector>
+
+#include "GLTFExtension.h"
+
+namespace GLTF {
+class Node;
+
+/**
+ * The MSFT_lod extension of a node, listing lower detail versions of it from
+ * highest to lowest detail. The LOD nodes are not part of the scene.
+ */
+class LodExtension : public GLTF::Extension {
+ public:
+  std::vector<GLTF::Node*> lods;
+  /**
+   * The screen coverage below which each level, starting with the node
+   * itself, is no longer used. Written to the node's extras as
+   * `MSFT_screencoverage` if set.
+   */
+  std::vector<float> screenCoverage;
+
+  virtual void writeJSON(void* writer, GLTF::Options* options);
+};
+}  // namespace GLTF
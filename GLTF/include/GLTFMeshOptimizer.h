@@ -0,0 +1,184 @@
+// Copyright 2020 The Khronos® Group Inc.
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace GLTF {
+/**
+ * Index buffer optimizations for triangle list primitives.
+ */
+namespace MeshOptimizer {
+/**
+ * Post-transform vertex cache statistics for one or more triangle lists.
+ */
+class VertexCacheStatistics {
+ public:
+  size_t triangleCount = 0;
+  size_t vertexCount = 0;
+  size_t transformedVertexCount = 0;
+
+  /** Average cache miss ratio: vertex shader runs per triangle. */
+  float getACMR() const;
+  /** Average transformed vertex ratio: vertex shader runs per vertex. */
+  float getATVR() const;
+  void add(const VertexCacheStatistics& statistics);
+};
+
+/**
+ * Vertex fetch statistics for one or more vertex attribute arrays.
+ */
+class VertexFetchStatistics {
+ public:
+  size_t bytesFetched = 0;
+  size_t vertexBytes = 0;
+
+  /**
+   * Overfetch ratio: bytes read from memory per byte of referenced vertex
+   * data. 1 is optimal for a linear read through the vertices.
+   */
+  float getOverfetch() const;
+  void add(const VertexFetchStatistics& statistics);
+};
+
+/**
+ * A vertex attribute compared when welding vertices.
+ */
+class WeldAttribute {
+ public:
+  /** `numberOfComponents` values for each vertex */
+  const float* values = NULL;
+  size_t numberOfComponents = 0;
+  /** The largest difference allowed between components of welded vertices */
+  float tolerance = 0;
+};
+
+/**
+ * Part of an index list split by `splitIndices`.
+ */
+class IndexChunk {
+ public:
+  /** The original index of each vertex in the chunk */
+  std::vector<unsigned int> vertices;
+  /** Indices into `vertices` */
+  std::vector<unsigned int> indices;
+};
+
+/**
+ * Simulates a FIFO post-transform vertex cache of `cacheSize` entries over a
+ * triangle list.
+ *
+ * @param indices The triangle list indices
+ * @param vertexCount One more than the largest index
+ * @param cacheSize The number of cached vertices
+ */
+VertexCacheStatistics analyzeVertexCache(
+    const std::vector<unsigned int>& indices, size_t vertexCount,
+    size_t cacheSize);
+
+/**
+ * Reorders the triangles of a triangle list to improve post-transform vertex
+ * cache hit rates, using Tom Forsyth's linear-speed vertex cache optimisation.
+ * Triangles keep their winding, and vertices are not reordered.
+ *
+ * @param indices The triangle list indices, reordered in place
+ * @param vertexCount One more than the largest index
+ */
+void optimizeVertexCache(std::vector<unsigned int>* indices,
+                         size_t vertexCount);
+
+/**
+ * Simulates the cache lines read when fetching the vertices of an index list
+ * from one tightly packed vertex attribute array.
+ *
+ * @param indices The index list
+ * @param vertexCount The number of vertices in the attribute array
+ * @param vertexSize The byte length of one vertex in the attribute array
+ */
+VertexFetchStatistics analyzeVertexFetch(
+    const std::vector<unsigned int>& indices, size_t vertexCount,
+    size_t vertexSize);
+
+/**
+ * Renumbers vertices in the order they are first used by an index list, so
+ * that vertex fetches walk forward through memory. Vertices that are not
+ * used are moved to the end, keeping their order.
+ *
+ * @param indices The index list, rewritten in place
+ * @param vertexCount The number of vertices
+ * @return The new index of each vertex, to reorder vertex attributes with
+ */
+std::vector<unsigned int> optimizeVertexFetch(
+    std::vector<unsigned int>* indices, size_t vertexCount);
+
+/**
+ * Reorders clusters of triangles so that triangles facing outwards from the
+ * mesh center are drawn first, reducing overdraw. Triangles are only split
+ * into clusters where that increases the average cache miss ratio of a run by
+ * at most `threshold`, so this should follow `optimizeVertexCache`.
+ *
+ * @param indices The triangle list indices, reordered in place
+ * @param positions Three position components for each vertex
+ * @param threshold The allowed vertex cache degradation, e.g. `1.05`
+ */
+void optimizeOverdraw(std::vector<unsigned int>* indices,
+                      const std::vector<float>& positions, float threshold);
+
+/**
+ * Welds vertices whose positions and other attributes are all within
+ * tolerance of an earlier vertex, which becomes their representative.
+ * Candidates are found with a uniform grid spatial hash over the positions,
+ * with cells of `positionTolerance`.
+ *
+ * @param positions Three position components for each vertex
+ * @param positionTolerance The largest difference allowed between position
+ * components of welded vertices
+ * @param attributes The other attributes to compare
+ * @return The new index of each vertex. Representatives are numbered in
+ * order, so the first vertex mapped to each new index is its representative.
+ */
+std::vector<unsigned int> weldVertices(
+    const std::vector<float>& positions, float positionTolerance,
+    const std::vector<WeldAttribute>& attributes);
+
+/**
+ * Removes triangles that use the same vertex more than once.
+ *
+ * @param indices The triangle list indices, compacted in place
+ * @return The number of triangles removed
+ */
+size_t removeDegenerateTriangles(std::vector<unsigned int>* indices);
+
+/**
+ * Splits an index list into chunks that each use at most `maxVertexCount`
+ * vertices, keeping whole points, lines or triangles together and in order.
+ *
+ * @param indices The index list
+ * @param primitiveSize The number of indices per point, line or triangle
+ * @param maxVertexCount The most vertices a chunk may use
+ */
+std::vector<IndexChunk> splitIndices(const std::vector<unsigned int>& indices,
+                                     size_t primitiveSize,
+                                     size_t maxVertexCount);
+
+/**
+ * Simplifies a triangle list by collapsing edges in order of quadric error,
+ * moving one end of an edge onto the other. No vertices are created or
+ * moved, so every vertex attribute, including skin weights, stays valid.
+ * Vertices on open edges are never moved, which keeps the mesh border, UV
+ * and normal seams (where vertices are split) and the edges shared with
+ * primitives of other materials intact.
+ *
+ * @param indices The triangle list indices
+ * @param positions Three position components for each vertex
+ * @param targetIndexCount The index count to stop at
+ * @param targetError The largest distance a collapse may move the surface,
+ * relative to the extent of the mesh
+ * @return The simplified indices, which may have more than
+ * `targetIndexCount` indices if the error limit is reached first
+ */
+std::vector<unsigned int> simplify(const std::vector<unsigned int>& indices,
+                                   const std::vector<float>& positions,
+                                   size_t targetIndexCount, float targetError);
+}  // namespace MeshOptimizer
+}  // namespace GLTF
@@ -0,0 +1,70 @@
+// Copyright 2020 The Khronos® Group Inc.
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace GLTF {
+/**
+ * Encoders for the bitstreams of the EXT_meshopt_compression extension, as
+ * produced by meshoptimizer's `meshopt_encodeVertexBuffer`,
+ * `meshopt_encodeIndexBuffer` and `meshopt_encodeIndexSequence`. The matching
+ * decoders are used to verify encoded streams.
+ */
+namespace MeshoptCodec {
+/**
+ * Encodes an array of vertices for the `ATTRIBUTES` mode. Each byte of a
+ * vertex is delta coded against the same byte of the previous vertex, and
+ * the deltas are bit packed in groups of 16.
+ *
+ * @param vertices `count * byteStride` bytes of vertex data
+ * @param count The number of vertices
+ * @param byteStride The byte length of a vertex, a multiple of 4 up to 256
+ */
+std::vector<unsigned char> encodeVertexBuffer(const unsigned char* vertices,
+                                              size_t count, size_t byteStride);
+
+/**
+ * Encodes triangle list indices for the `TRIANGLES` mode, coding each
+ * triangle against recently seen edges and vertices. Triangles may be
+ * rotated, which keeps their winding.
+ *
+ * @param indices The triangle list indices
+ * @param count The number of indices, a multiple of 3
+ */
+std::vector<unsigned char> encodeIndexBuffer(const unsigned int* indices,
+                                             size_t count);
+
+/**
+ * Encodes an arbitrary index list for the `INDICES` mode, as varint deltas
+ * against one of two recent indices.
+ *
+ * @param indices The indices
+ * @param count The number of indices
+ */
+std::vector<unsigned char> encodeIndexSequence(const unsigned int* indices,
+                                               size_t count);
+
+/**
+ * Decodes a stream written by `encodeVertexBuffer`.
+ * @return `false` if the stream is malformed
+ */
+bool decodeVertexBuffer(unsigned char* vertices, size_t count,
+                        size_t byteStride,
+                        const std::vector<unsigned char>& data);
+
+/**
+ * Decodes a stream written by `encodeIndexBuffer`.
+ * @return `false` if the stream is malformed
+ */
+bool decodeIndexBuffer(unsigned int* indices, size_t count,
+                       const std::vector<unsigned char>& data);
+
+/**
+ * Decodes a stream written by `encodeIndexSequence`.
+ * @return `false` if the stream is malformed
+ */
+bool decodeIndexSequence(unsigned int* indices, size_t count,
+                         const std::vector<unsigned char>& data);
+}  // namespace MeshoptCodec
+}  // namespace GLTF
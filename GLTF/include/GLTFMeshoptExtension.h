@@ -0,0 +1,30 @@
+// Copyright 2020 The Khronos® Group Inc.
+#pragma once
+
+#include <string>
+
+#include "GLTFBuffer.h"
+#include "GLTFExtension.h"
+
+namespace GLTF {
+/**
+ * The EXT_meshopt_compression extension of a bufferView, locating its
+ * compressed data. On a buffer, `fallback` marks the buffer holding the
+ * uncompressed bufferViews as having no data.
+ */
+class MeshoptExtension : public GLTF::Extension {
+ public:
+  enum class Mode { ATTRIBUTES, TRIANGLES, INDICES };
+
+  GLTF::Buffer* buffer = NULL;
+  size_t byteOffset = 0;
+  size_t byteLength = 0;
+  int byteStride = 0;
+  size_t count = 0;
+  Mode mode = Mode::ATTRIBUTES;
+  bool fallback = false;
+
+  static std::string getModeName(Mode mode);
+  virtual void writeJSON(void* writer, GLTF::Options* options);
+};
+}  // namespace GLTF
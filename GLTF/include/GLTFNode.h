@@ -19,6 +19,7 @@ class Node : public GLTF::Object {
 
     Type type;
 
+    virtual ~Transform();
     virtual Transform* clone() = 0;
   };
 
@@ -1,6 +1,7 @@
 // Copyright 2020 The Khronos® Group Inc.
 #pragma once
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -28,5 +29,48 @@ class Options {
   int colorQuantizationBits = 8;
   int jointQuantizationBits = 8;
   bool writeAbsoluteUris = false;
+  // Number of threads used to build mesh primitives and to pack accessor
+  // data; 1 runs serially.
+  int threads = 1;
+  // Shares one mesh between nodes using meshes with identical content.
+  bool deduplicateMeshes = false;
+  // Shares one accessor between users of accessors with identical content.
+  bool deduplicateAccessors = false;
+  // Draws static leaf nodes sharing a mesh with EXT_mesh_gpu_instancing.
+  bool instance = false;
+  // Static batching: merges primitives of static nodes sharing a material
+  // into primitives of at most `batchVertexCount` vertices.
+  bool batch = false;
+  int batchVertexCount = 65535;
+  // Vertex welding tolerances per semantic; a position tolerance of 0 turns
+  // welding off.
+  float weld = 0;
+  float weldNormal = 0.001f;
+  float weldTexcoord = 0.0001f;
+  float weldColor = 0.002f;
+  bool optimizeVertexCache = false;
+  bool optimizeOverdraw = false;
+  bool optimizeVertexFetch = false;
+  bool interleave = false;
+  // Packs accessor data into several buffers: "size" for parts of at most
+  // `bufferSplitByteLength` bytes, "mesh" or "node" for one per mesh or node.
+  // Empty packs a single buffer.
+  std::string bufferSplit;
+  size_t bufferSplitByteLength = 0;
+  // Writes min and max for every accessor, not only the ones glTF requires
+  // them for.
+  bool accessorMinMax = false;
+  // Morph target attributes with fewer than this fraction of non-zero
+  // elements are stored as sparse accessors; 0 turns this off.
+  float sparseMorphTargets = 0.5f;
+  // Stores vertex attributes with KHR_mesh_quantization, using the
+  // quantization bits above.
+  bool quantize = false;
+  bool meshoptCompression = false;
+  // Fractions of triangles kept in each MSFT_lod level; empty turns LOD
+  // generation off.
+  std::vector<float> lods;
+  std::vector<float> lodScreenCoverage;
+  float lodError = 0.01f;
 };
 }  // namespace GLTF
@@ -0,0 +1,105 @@
+// Copyright 2020 The Khronos® Group Inc.
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace GLTF {
+/**
+ * A fixed size work-stealing thread pool.
+ *
+ * Each worker owns a task deque. Tasks submitted from a worker go to the back
+ * of its own deque and are taken from there first, while idle workers steal
+ * from the front of the other deques. Threads waiting on pool tasks through
+ * `wait` or `parallelFor` run queued tasks until theirs are done, so tasks may
+ * themselves use the pool without deadlocking, and only sleep when nothing is
+ * queued.
+ */
+class ThreadPool {
+ private:
+  struct TaskQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<std::thread> _threads;
+  std::vector<std::unique_ptr<TaskQueue>> _queues;
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  // Signalled for threads in `wait` when a task is queued or completes
+  std::condition_variable _waitCondition;
+  size_t _pending = 0;
+  size_t _waiting = 0;
+  size_t _nextQueue = 0;
+  bool _stop = false;
+
+  void push(std::function<void()> task);
+  bool popTask(size_t queueIndex, std::function<void()>* task);
+  void runTask(std::function<void()>* task);
+  void run(size_t queueIndex);
+
+ public:
+  explicit ThreadPool(size_t threadCount);
+  ~ThreadPool();
+
+  /** The number of worker threads. */
+  size_t size() const;
+
+  /**
+   * Queues a task to run on the pool.
+   * @return A future for the task's result
+   */
+  template <typename F>
+  auto submit(F task) -> std::future<decltype(task())> {
+    typedef decltype(task()) Result;
+    auto packagedTask = std::make_shared<std::packaged_task<Result()>>(task);
+    std::future<Result> future = packagedTask->get_future();
+    push([packagedTask]() { (*packagedTask)(); });
+    return future;
+  }
+
+  /**
+   * Runs one queued task on the calling thread, if there is one.
+   * @return `true` if a task was run
+   */
+  bool runPendingTask();
+
+  /**
+   * Waits for a future produced by this pool, running queued tasks on the
+   * calling thread until it is ready. With nothing queued, the thread sleeps
+   * until a task is queued or completes.
+   */
+  template <typename T>
+  void wait(const std::future<T>& future) {
+    auto ready = [&future]() {
+      return future.wait_for(std::chrono::seconds(0)) ==
+             std::future_status::ready;
+    };
+    while (!ready()) {
+      if (runPendingTask()) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(_mutex);
+      _waiting++;
+      _waitCondition.wait(lock,
+                          [this, &ready] { return _pending > 0 || ready(); });
+      _waiting--;
+    }
+  }
+
+  /**
+   * Calls `function` once for every index in `[0, count)`, spreading the calls
+   * across the pool and the calling thread, and returns when all of them have
+   * completed.
+   */
+  void parallelFor(size_t count, const std::function<void(size_t)>& function);
+};
+}  // namespace GLTF
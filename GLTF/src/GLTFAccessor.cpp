@@ -4,34 +4,42 @@
 #include <stdlib.h>
 
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <limits>
 #include <set>
+#include <vector>
 
+#include "GLTFAccessorView.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MINMAX_SSE2
+#include <emmintrin.h>
+#endif
+
 GLTF::Accessor::Accessor(GLTF::Accessor::Type type,
                          GLTF::Constants::WebGL componentType)
     : type(type), componentType(componentType), byteOffset(0) {}
 
 GLTF::Accessor::Accessor(GLTF::Accessor::Type type,
                          GLTF::Constants::WebGL componentType,
-                         unsigned char* data, int count,
+                         unsigned char* data, size_t count,
                          GLTF::Constants::WebGL target)
     : Accessor(type, componentType) {
-  int byteLength =
+  size_t byteLength =
       count * this->getNumberOfComponents() * this->getComponentByteLength();
   unsigned char* allocatedData = (unsigned char*)malloc(byteLength);
   std::memcpy(allocatedData, data, byteLength);
   this->bufferView = new GLTF::BufferView(allocatedData, byteLength, target);
   this->count = count;
-  this->computeMinMax();
 }
 
 GLTF::Accessor::Accessor(GLTF::Accessor::Type type,
                          GLTF::Constants::WebGL componentType,
-                         unsigned char* data, int count,
+                         unsigned char* data, size_t count,
                          GLTF::BufferView* bufferView)
     : Accessor(type, componentType) {
   GLTF::Buffer* buffer = bufferView->buffer;
@@ -39,25 +47,25 @@ GLTF::Accessor::Accessor(GLTF::Accessor::Type type,
   this->byteOffset = bufferView->byteLength;
   this->count = count;
   int componentByteLength = this->getComponentByteLength();
-  int byteLength = count * this->getNumberOfComponents() * componentByteLength;
+  size_t byteLength =
+      count * this->getNumberOfComponents() * componentByteLength;
 
-  int padding = byteOffset % componentByteLength;
+  size_t padding = byteOffset % componentByteLength;
   if (padding != 0) {
     padding = componentByteLength - padding;
   }
   this->byteOffset += padding;
 
-  buffer->data = (unsigned char*)realloc(
-      buffer->data, buffer->byteLength + padding + byteLength);
-  std::memcpy(buffer->data + buffer->byteLength + padding, data, byteLength);
-  buffer->byteLength += byteLength + padding;
+  size_t bufferByteLength = buffer->byteLength;
+  buffer->resize(bufferByteLength + padding + byteLength);
+  std::memcpy(buffer->data + bufferByteLength + padding, data, byteLength);
   bufferView->byteLength += byteLength + padding;
-  this->computeMinMax();
 }
 
 GLTF::Accessor::Accessor(GLTF::Accessor::Type type,
-                         GLTF::Constants::WebGL componentType, int byteOffset,
-                         int count, GLTF::BufferView* bufferView)
+                         GLTF::Constants::WebGL componentType,
+                         size_t byteOffset, size_t count,
+                         GLTF::BufferView* bufferView)
     : Accessor(type, componentType) {
   this->byteOffset = byteOffset;
   this->count = count;
@@ -69,31 +77,217 @@ GLTF::Accessor::Accessor(GLTF::Accessor* accessor)
                &(accessor->bufferView->buffer
                      ->data[accessor->byteOffset +
                             accessor->bufferView->byteOffset]),
-               accessor->count, accessor->bufferView->target) {}
+               accessor->count, accessor->bufferView->target) {
+  this->normalized = accessor->normalized;
+}
+
+/**
+ * Finds the per component bounds of tightly packed elements with vector
+ * instructions, where available for the component type.
+ *
+ * @return The number of elements handled, which the caller finishes
+ */
+template <typename T>
+struct MinMaxKernel {
+  template <int N>
+  static size_t run(const T*, size_t, T*, T*) {
+    return 0;
+  }
+};
+
+#if defined(MINMAX_SSE2)
+struct FloatLanes {
+  typedef __m128 Vector;
+  static const int width = 4;
+  static Vector load(const float* values) { return _mm_loadu_ps(values); }
+  static void store(float* values, Vector vector) {
+    _mm_storeu_ps(values, vector);
+  }
+  static Vector min(Vector a, Vector b) { return _mm_min_ps(a, b); }
+  static Vector max(Vector a, Vector b) { return _mm_max_ps(a, b); }
+};
+
+/**
+ * SSE2 only compares signed 16-bit integers, so values are biased into the
+ * signed range while they are in registers.
+ */
+struct UInt16Lanes {
+  typedef __m128i Vector;
+  static const int width = 8;
+  static Vector bias() { return _mm_set1_epi16(-0x8000); }
+  static Vector load(const uint16_t* values) {
+    return _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(values)), bias());
+  }
+  static void store(uint16_t* values, Vector vector) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(values),
+                     _mm_xor_si128(vector, bias()));
+  }
+  static Vector min(Vector a, Vector b) { return _mm_min_epi16(a, b); }
+  static Vector max(Vector a, Vector b) { return _mm_max_epi16(a, b); }
+};
+
+/**
+ * SSE2 has no 32-bit integer min or max, so biased values are compared and
+ * selected with masks.
+ */
+struct UInt32Lanes {
+  typedef __m128i Vector;
+  static const int width = 4;
+  static Vector bias() { return _mm_set1_epi32(INT32_MIN); }
+  static Vector load(const uint32_t* values) {
+    return _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(values)), bias());
+  }
+  static void store(uint32_t* values, Vector vector) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(values),
+                     _mm_xor_si128(vector, bias()));
+  }
+  static Vector select(Vector mask, Vector a, Vector b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+  }
+  static Vector min(Vector a, Vector b) {
+    return select(_mm_cmpgt_epi32(a, b), b, a);
+  }
+  static Vector max(Vector a, Vector b) {
+    return select(_mm_cmpgt_epi32(a, b), a, b);
+  }
+};
+
+/**
+ * Reads blocks of `Lanes::width` elements as `N` vectors. Lane `l` of vector
+ * `v` always holds component `(v * width + l) % N`, so the lanes are reduced
+ * to per component bounds once at the end.
+ */
+template <typename Lanes, int N, typename T>
+size_t minMaxSIMD(const T* values, size_t count, T* low, T* high) {
+  const int width = Lanes::width;
+  size_t blockCount = count / width;
+  if (blockCount == 0) {
+    return 0;
+  }
+  typename Lanes::Vector lowVectors[N];
+  typename Lanes::Vector highVectors[N];
+  for (int v = 0; v < N; v++) {
+    lowVectors[v] = Lanes::load(values + v * width);
+    highVectors[v] = lowVectors[v];
+  }
+  for (size_t b = 1; b < blockCount; b++) {
+    const T* block = values + b * width * N;
+    for (int v = 0; v < N; v++) {
+      typename Lanes::Vector vector = Lanes::load(block + v * width);
+      lowVectors[v] = Lanes::min(vector, lowVectors[v]);
+      highVectors[v] = Lanes::max(vector, highVectors[v]);
+    }
+  }
+  T lowLanes[width];
+  T highLanes[width];
+  for (int v = 0; v < N; v++) {
+    Lanes::store(lowLanes, lowVectors[v]);
+    Lanes::store(highLanes, highVectors[v]);
+    for (int l = 0; l < width; l++) {
+      int k = (v * width + l) % N;
+      low[k] = std::min(lowLanes[l], low[k]);
+      high[k] = std::max(highLanes[l], high[k]);
+    }
+  }
+  return blockCount * width;
+}
+
+template <>
+struct MinMaxKernel<float> {
+  template <int N>
+  static size_t run(const float* values, size_t count, float* low,
+                    float* high) {
+    return minMaxSIMD<FloatLanes, N>(values, count, low, high);
+  }
+};
+
+template <>
+struct MinMaxKernel<uint16_t> {
+  template <int N>
+  static size_t run(const uint16_t* values, size_t count, uint16_t* low,
+                    uint16_t* high) {
+    return minMaxSIMD<UInt16Lanes, N>(values, count, low, high);
+  }
+};
+
+template <>
+struct MinMaxKernel<uint32_t> {
+  template <int N>
+  static size_t run(const uint32_t* values, size_t count, uint32_t* low,
+                    uint32_t* high) {
+    return minMaxSIMD<UInt32Lanes, N>(values, count, low, high);
+  }
+};
+#endif
+
+struct MinMaxVisitor {
+  float* min;
+  float* max;
+
+  template <typename T, int N>
+  void operator()(const GLTF::AccessorView<T, N>& view) {
+    T low[N];
+    T high[N];
+    const T* first = view[0];
+    for (int k = 0; k < N; k++) {
+      low[k] = first[k];
+      high[k] = first[k];
+    }
+    size_t begin = 0;
+    if (view.isContiguous()) {
+      begin = MinMaxKernel<T>::template run<N>(view.data(), view.size(), low,
+                                               high);
+    }
+    for (size_t i = begin; i < view.size(); i++) {
+      const T* element = view[i];
+      for (int k = 0; k < N; k++) {
+        low[k] = std::min(element[k], low[k]);
+        high[k] = std::max(element[k], high[k]);
+      }
+    }
+    for (int k = 0; k < N; k++) {
+      min[k] = static_cast<float>(low[k]);
+      max[k] = static_cast<float>(high[k]);
+    }
+  }
+};
 
 bool GLTF::Accessor::computeMinMax() {
   int numberOfComponents = this->getNumberOfComponents();
-  int count = this->count;
-  if (count > 0) {
+  if (this->count > 0) {
     if (max == NULL) {
       max = new float[numberOfComponents];
     }
     if (min == NULL) {
       min = new float[numberOfComponents];
     }
-    float* component = new float[numberOfComponents];
-    this->getComponentAtIndex(0, component);
+    MinMaxVisitor visitor = {min, max};
+    if (this->sparseIndices == NULL && GLTF::visitAccessor(this, &visitor)) {
+      return true;
+    }
+    std::vector<float> component(numberOfComponents);
+    bool read = this->getComponentAtIndex(0, component.data());
     for (int i = 0; i < numberOfComponents; i++) {
       min[i] = component[i];
       max[i] = component[i];
     }
-    for (int i = 1; i < this->count; i++) {
-      this->getComponentAtIndex(i, component);
+    for (size_t i = 1; read && i < this->count; i++) {
+      read = this->getComponentAtIndex(i, component.data());
       for (int j = 0; j < numberOfComponents; j++) {
         min[j] = std::min(component[j], min[j]);
         max[j] = std::max(component[j], max[j]);
       }
     }
+    if (!read) {
+      // The data is unavailable, e.g. compressed away by compressBufferViews
+      delete[] min;
+      delete[] max;
+      min = NULL;
+      max = NULL;
+      return false;
+    }
   }
   return true;
 }
@@ -105,70 +299,194 @@ int GLTF::Accessor::getByteStride() {
   return this->bufferView->byteStride;
 }
 
-bool GLTF::Accessor::getComponentAtIndex(int index, float* component) {
-  int byteOffset = this->byteOffset + this->bufferView->byteOffset;
-  int numberOfComponents = this->getNumberOfComponents();
-  byteOffset += this->getByteStride() * index;
-  unsigned char* buf = this->bufferView->buffer->data + byteOffset;
-
-  for (int i = 0; i < numberOfComponents; i++) {
-    switch (this->componentType) {
-      case GLTF::Constants::WebGL::BYTE:
-        component[i] = static_cast<float>(reinterpret_cast<char*>(buf)[i]);
-        break;
-      case GLTF::Constants::WebGL::UNSIGNED_BYTE:
-        component[i] = static_cast<float>(buf[i]);
-        break;
-      case GLTF::Constants::WebGL::SHORT:
-        component[i] = static_cast<float>(reinterpret_cast<int16_t*>(buf)[i]);
-        break;
-      case GLTF::Constants::WebGL::UNSIGNED_SHORT:
-        component[i] = static_cast<float>(reinterpret_cast<uint16_t*>(buf)[i]);
-        break;
-      case GLTF::Constants::WebGL::FLOAT:
-        component[i] = reinterpret_cast<float*>(buf)[i];
-        break;
-      case GLTF::Constants::WebGL::UNSIGNED_INT:
-        component[i] =
-            static_cast<float>(reinterpret_cast<unsigned int*>(buf)[i]);
-        break;
-      default:
-        return false;
+struct ReadVisitor {
+  size_t index;
+  float* component;
+
+  template <typename T, int N>
+  void operator()(const GLTF::AccessorView<T, N>& view) {
+    view.read(index, component);
+  }
+};
+
+struct WriteVisitor {
+  size_t index;
+  const float* component;
+
+  template <typename T, int N>
+  void operator()(const GLTF::AccessorView<T, N>& view) {
+    view.write(index, component);
+  }
+};
+
+struct ReadAllVisitor {
+  float* values;
+
+  template <typename T, int N>
+  void operator()(const GLTF::AccessorView<T, N>& view) {
+    view.readAll(values);
+  }
+};
+
+struct WriteAllVisitor {
+  const float* values;
+
+  template <typename T, int N>
+  void operator()(const GLTF::AccessorView<T, N>& view) {
+    view.writeAll(values);
+  }
+};
+
+/**
+ * Copies the elements of the visited accessor to `target`, which has the same
+ * type, component type and count.
+ */
+struct CopyVisitor {
+  GLTF::Accessor* target;
+
+  template <typename T, int N>
+  void operator()(const GLTF::AccessorView<T, N>& view) {
+    view.copyTo(GLTF::AccessorView<T, N>(target));
+  }
+};
+
+/**
+ * Compares the elements of the visited accessor with `other`, which has the
+ * same type, component type and count.
+ */
+struct EqualsVisitor {
+  GLTF::Accessor* other;
+  bool equal;
+
+  template <typename T, int N>
+  void operator()(const GLTF::AccessorView<T, N>& view) {
+    GLTF::AccessorView<T, N> otherView(other);
+    for (size_t i = 0; i < view.size() && equal; i++) {
+      const T* element = view[i];
+      const T* otherElement = otherView[i];
+      for (int k = 0; k < N; k++) {
+        if (element[k] != otherElement[k]) {
+          equal = false;
+        }
+      }
     }
   }
-  return true;
+};
+
+/**
+ * Binary searches strictly increasing sparse indices for `index`, comparing
+ * them as integers, since floats can't hold every index above 2^24.
+ * @return The position of `index`, or the number of indices if it is absent
+ */
+template <typename T>
+size_t findSparseIndex(const GLTF::AccessorView<T, 1>& sparseIndices,
+                       size_t index) {
+  size_t low = 0;
+  size_t high = sparseIndices.size();
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    size_t sparseIndex = *sparseIndices[middle];
+    if (sparseIndex == index) {
+      return middle;
+    } else if (sparseIndex < index) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return sparseIndices.size();
 }
 
-bool GLTF::Accessor::writeComponentAtIndex(int index, float* component) {
-  int byteOffset = this->byteOffset + this->bufferView->byteOffset;
+/**
+ * Finds `index` in an accessor of sparse indices.
+ * @return `false` if the indices can't be read
+ */
+bool findSparseIndex(GLTF::Accessor* sparseIndices, size_t index,
+                     size_t* position) {
+  if (sparseIndices->bufferView == NULL ||
+      sparseIndices->bufferView->buffer == NULL ||
+      sparseIndices->bufferView->buffer->data == NULL) {
+    return false;
+  }
+  switch (sparseIndices->componentType) {
+    case GLTF::Constants::WebGL::UNSIGNED_BYTE:
+      *position = findSparseIndex(
+          GLTF::AccessorView<uint8_t, 1>(sparseIndices), index);
+      return true;
+    case GLTF::Constants::WebGL::UNSIGNED_SHORT:
+      *position = findSparseIndex(
+          GLTF::AccessorView<uint16_t, 1>(sparseIndices), index);
+      return true;
+    case GLTF::Constants::WebGL::UNSIGNED_INT:
+      *position = findSparseIndex(
+          GLTF::AccessorView<uint32_t, 1>(sparseIndices), index);
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool GLTF::Accessor::getComponentAtIndex(size_t index, float* component) {
   int numberOfComponents = this->getNumberOfComponents();
-  byteOffset += this->getByteStride() * index;
-  unsigned char* buf = this->bufferView->buffer->data + byteOffset;
-
-  for (int i = 0; i < numberOfComponents; i++) {
-    switch (this->componentType) {
-      case GLTF::Constants::WebGL::BYTE:
-        buf[i] = static_cast<char>(component[i]);
-        break;
-      case GLTF::Constants::WebGL::UNSIGNED_BYTE:
-        buf[i] = static_cast<unsigned char>(component[i]);
-        break;
-      case GLTF::Constants::WebGL::SHORT:
-        reinterpret_cast<int16_t*>(buf)[i] = static_cast<int16_t>(component[i]);
-        break;
-      case GLTF::Constants::WebGL::UNSIGNED_SHORT:
-        reinterpret_cast<uint16_t*>(buf)[i] =
-            static_cast<uint16_t>(component[i]);
-        break;
-      case GLTF::Constants::WebGL::FLOAT:
-        reinterpret_cast<float*>(buf)[i] = static_cast<float>(component[i]);
-        break;
-      case GLTF::Constants::WebGL::UNSIGNED_INT:
-        reinterpret_cast<unsigned int*>(buf)[i] =
-            static_cast<unsigned int>(component[i]);
-        break;
-      default:
+  if (this->sparseIndices != NULL) {
+    size_t position;
+    if (!findSparseIndex(this->sparseIndices, index, &position)) {
+      return false;
+    }
+    if (position < this->sparseIndices->count) {
+      return this->sparseValues->getComponentAtIndex(position, component);
+    }
+  }
+  if (this->bufferView == NULL) {
+    for (int i = 0; i < numberOfComponents; i++) {
+      component[i] = 0;
+    }
+    return true;
+  }
+  ReadVisitor visitor = {index, component};
+  return GLTF::visitAccessor(this, &visitor);
+}
+
+bool GLTF::Accessor::writeComponentAtIndex(size_t index, float* component) {
+  WriteVisitor visitor = {index, component};
+  return GLTF::visitAccessor(this, &visitor);
+}
+
+bool GLTF::Accessor::getComponents(float* components) {
+  if (this->sparseIndices != NULL || this->bufferView == NULL) {
+    int numberOfComponents = this->getNumberOfComponents();
+    for (size_t i = 0; i < this->count; i++) {
+      if (!this->getComponentAtIndex(i, components + i * numberOfComponents)) {
         return false;
+      }
+    }
+    return true;
+  }
+  ReadAllVisitor visitor = {components};
+  return GLTF::visitAccessor(this, &visitor);
+}
+
+bool GLTF::Accessor::writeComponents(float* components) {
+  WriteAllVisitor visitor = {components};
+  return GLTF::visitAccessor(this, &visitor);
+}
+
+bool GLTF::Accessor::copyComponents(GLTF::Accessor* accessor) {
+  if (type != accessor->type || componentType != accessor->componentType ||
+      count != accessor->count) {
+    return false;
+  }
+  CopyVisitor visitor = {accessor};
+  if (this->sparseIndices == NULL && accessor->bufferView != NULL &&
+      GLTF::visitAccessor(this, &visitor)) {
+    return true;
+  }
+  int numberOfComponents = getNumberOfComponents();
+  std::vector<float> component(numberOfComponents);
+  for (size_t i = 0; i < count; i++) {
+    if (!this->getComponentAtIndex(i, component.data()) ||
+        !accessor->writeComponentAtIndex(i, component.data())) {
+      return false;
     }
   }
   return true;
@@ -242,12 +560,19 @@ bool GLTF::Accessor::equals(GLTF::Accessor* accessor) {
       count != accessor->count) {
     return false;
   }
+  if (this->sparseIndices == NULL && accessor->bufferView != NULL &&
+      accessor->sparseIndices == NULL) {
+    EqualsVisitor visitor = {accessor, true};
+    if (GLTF::visitAccessor(this, &visitor)) {
+      return visitor.equal;
+    }
+  }
   int numberOfComponents = getNumberOfComponents();
-  float* componentOne = new float[numberOfComponents];
-  float* componentTwo = new float[numberOfComponents];
-  for (int i = 0; i < count; i++) {
-    this->getComponentAtIndex(i, componentOne);
-    accessor->getComponentAtIndex(i, componentTwo);
+  std::vector<float> componentOne(numberOfComponents);
+  std::vector<float> componentTwo(numberOfComponents);
+  for (size_t i = 0; i < count; i++) {
+    this->getComponentAtIndex(i, componentOne.data());
+    accessor->getComponentAtIndex(i, componentTwo.data());
     for (int j = 0; j < numberOfComponents; j++) {
       if (componentOne[j] != componentTwo[j]) {
         return false;
@@ -270,7 +595,7 @@ void GLTF::Accessor::writeJSON(void* writer, GLTF::Options* options) {
       jsonWriter->Int(this->bufferView->id);
     }
     jsonWriter->Key("byteOffset");
-    jsonWriter->Int(this->byteOffset);
+    jsonWriter->Uint64(this->byteOffset);
   }
   if (options->version == "1.0") {
     int byteStride = bufferView->byteStride;
@@ -281,8 +606,12 @@ void GLTF::Accessor::writeJSON(void* writer, GLTF::Options* options) {
   }
   jsonWriter->Key("componentType");
   jsonWriter->Int(static_cast<int>(this->componentType));
+  if (this->normalized && options->version != "1.0") {
+    jsonWriter->Key("normalized");
+    jsonWriter->Bool(true);
+  }
   jsonWriter->Key("count");
-  jsonWriter->Int(this->count);
+  jsonWriter->Uint64(this->count);
   if (this->max) {
     jsonWriter->Key("max");
     jsonWriter->StartArray();
@@ -307,6 +636,30 @@ void GLTF::Accessor::writeJSON(void* writer, GLTF::Options* options) {
     }
     jsonWriter->EndArray();
   }
+  if (this->sparseIndices != NULL && this->sparseValues != NULL &&
+      options->version != "1.0") {
+    jsonWriter->Key("sparse");
+    jsonWriter->StartObject();
+    jsonWriter->Key("count");
+    jsonWriter->Uint64(this->sparseIndices->count);
+    jsonWriter->Key("indices");
+    jsonWriter->StartObject();
+    jsonWriter->Key("bufferView");
+    jsonWriter->Int(this->sparseIndices->bufferView->id);
+    jsonWriter->Key("byteOffset");
+    jsonWriter->Uint64(this->sparseIndices->byteOffset);
+    jsonWriter->Key("componentType");
+    jsonWriter->Int(static_cast<int>(this->sparseIndices->componentType));
+    jsonWriter->EndObject();
+    jsonWriter->Key("values");
+    jsonWriter->StartObject();
+    jsonWriter->Key("bufferView");
+    jsonWriter->Int(this->sparseValues->bufferView->id);
+    jsonWriter->Key("byteOffset");
+    jsonWriter->Uint64(this->sparseValues->byteOffset);
+    jsonWriter->EndObject();
+    jsonWriter->EndObject();
+  }
   jsonWriter->Key("type");
   jsonWriter->String(this->getTypeName());
 }
@@ -2,11 +2,19 @@
 #include "GLTFAsset.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <map>
 #include <memory>
 #include <set>
+#include <string>
+#include <utility>
 
+#include "GLTFAccessorView.h"
+#include "GLTFThreadPool.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
 
@@ -133,6 +141,22 @@ std::vector<GLTF::Accessor*> GLTF::Asset::getAllAccessors() {
     }
   }
 
+  for (GLTF::Node* node : getAllNodes()) {
+    auto instancingExtensionPtr =
+        node->extensions.find("EXT_mesh_gpu_instancing");
+    if (instancingExtensionPtr != node->extensions.end()) {
+      for (const auto& attribute :
+           static_cast<GLTF::InstancingExtension*>(
+               instancingExtensionPtr->second)
+               ->attributes) {
+        if (uniqueAccessors.find(attribute.second) == uniqueAccessors.end()) {
+          accessors.push_back(attribute.second);
+          uniqueAccessors.insert(attribute.second);
+        }
+      }
+    }
+  }
+
   for (GLTF::Animation* animation : animations) {
     for (GLTF::Animation::Channel* channel : animation->channels) {
       GLTF::Animation::Sampler* sampler = channel->sampler;
@@ -146,6 +170,19 @@ std::vector<GLTF::Accessor*> GLTF::Asset::getAllAccessors() {
       }
     }
   }
+
+  size_t accessorCount = accessors.size();
+  for (size_t i = 0; i < accessorCount; i++) {
+    GLTF::Accessor* accessor = accessors[i];
+    for (GLTF::Accessor* sparseAccessor :
+         {accessor->sparseIndices, accessor->sparseValues}) {
+      if (sparseAccessor != NULL &&
+          uniqueAccessors.find(sparseAccessor) == uniqueAccessors.end()) {
+        accessors.push_back(sparseAccessor);
+        uniqueAccessors.insert(sparseAccessor);
+      }
+    }
+  }
   return accessors;
 }
 
@@ -176,6 +213,13 @@ std::vector<GLTF::Node*> GLTF::Asset::getAllNodes() {
         nodeStack.push_back(jointNode);
       }
     }
+    auto lodExtensionPtr = node->extensions.find("MSFT_lod");
+    if (lodExtensionPtr != node->extensions.end()) {
+      for (GLTF::Node* lod :
+           static_cast<GLTF::LodExtension*>(lodExtensionPtr->second)->lods) {
+        nodeStack.push_back(lod);
+      }
+    }
   }
   return nodes;
 }
@@ -434,7 +478,8 @@ std::vector<GLTF::BufferView*> GLTF::Asset::getAllBufferViews() {
   std::set<GLTF::BufferView*> uniqueBufferViews;
   for (GLTF::Accessor* accessor : getAllAccessors()) {
     GLTF::BufferView* bufferView = accessor->bufferView;
-    if (uniqueBufferViews.find(bufferView) == uniqueBufferViews.end()) {
+    if (bufferView &&
+        uniqueBufferViews.find(bufferView) == uniqueBufferViews.end()) {
       bufferViews.push_back(bufferView);
       uniqueBufferViews.insert(bufferView);
     }
@@ -459,6 +504,16 @@ std::vector<GLTF::Buffer*> GLTF::Asset::getAllBuffers() {
       buffers.push_back(buffer);
       uniqueBuffers.insert(buffer);
     }
+    auto meshoptExtensionPtr =
+        bufferView->extensions.find("EXT_meshopt_compression");
+    if (meshoptExtensionPtr != bufferView->extensions.end()) {
+      buffer = static_cast<GLTF::MeshoptExtension*>(meshoptExtensionPtr->second)
+                   ->buffer;
+      if (uniqueBuffers.find(buffer) == uniqueBuffers.end()) {
+        buffers.push_back(buffer);
+        uniqueBuffers.insert(buffer);
+      }
+    }
   }
   return buffers;
 }
@@ -584,6 +639,10 @@ void GLTF::Asset::removeUncompressedBufferViews() {
       // Currently assume all attributes are compressed in Draco extension.
       for (const auto accessor : getAllPrimitiveAccessors(primitive)) {
         if (accessor->bufferView) {
+          // Bounds can no longer be computed once the data is gone
+          if (accessor->min == NULL) {
+            accessor->computeMinMax();
+          }
           delete accessor->bufferView;
           accessor->bufferView = NULL;
         }
@@ -784,39 +843,743 @@ void GLTF::Asset::removeUnusedNodes(GLTF::Options* options) {
   }
 }
 
-GLTF::BufferView* packAccessorsForTargetByteStride(
-    std::vector<GLTF::Accessor*> accessors, GLTF::Constants::WebGL target,
-    size_t byteStride) {
-  std::map<GLTF::Accessor*, size_t> byteOffsets;
-  size_t byteLength = 0;
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+/**
+ * Continues a 64-bit FNV-1a hash over `length` bytes.
+ */
+uint64_t hashBytes(uint64_t hash, const void* data, size_t length) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ bytes[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+/**
+ * Hashes the layout and element bytes of an accessor. Padding between
+ * elements is skipped, so accessors with different byte strides but the same
+ * values hash the same.
+ */
+uint64_t hashAccessor(GLTF::Accessor* accessor) {
+  uint64_t layout[4] = {static_cast<uint64_t>(accessor->type),
+                        static_cast<uint64_t>(accessor->componentType),
+                        accessor->count, accessor->normalized};
+  uint64_t hash = hashBytes(FNV_OFFSET_BASIS, layout, sizeof(layout));
+  size_t elementSize =
+      accessor->getNumberOfComponents() * accessor->getComponentByteLength();
+  size_t byteStride = accessor->getByteStride();
+  const unsigned char* data = accessor->bufferView->buffer->data +
+                              accessor->bufferView->byteOffset +
+                              accessor->byteOffset;
+  for (size_t i = 0; i < accessor->count; i++) {
+    hash = hashBytes(hash, data + i * byteStride, elementSize);
+  }
+  return hash;
+}
+
+/**
+ * Checks whether two accessors have the same layout and element bytes.
+ */
+bool accessorContentEquals(GLTF::Accessor* a, GLTF::Accessor* b) {
+  if (a == b) {
+    return true;
+  }
+  if (a == NULL || b == NULL || a->type != b->type ||
+      a->componentType != b->componentType || a->count != b->count ||
+      a->normalized != b->normalized) {
+    return false;
+  }
+  size_t elementSize = a->getNumberOfComponents() * a->getComponentByteLength();
+  size_t byteStrideA = a->getByteStride();
+  size_t byteStrideB = b->getByteStride();
+  const unsigned char* dataA = a->bufferView->buffer->data +
+                               a->bufferView->byteOffset + a->byteOffset;
+  const unsigned char* dataB = b->bufferView->buffer->data +
+                               b->bufferView->byteOffset + b->byteOffset;
+  for (size_t i = 0; i < a->count; i++) {
+    if (std::memcmp(dataA + i * byteStrideA, dataB + i * byteStrideB,
+                    elementSize) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Checks whether the attributes of two primitives or morph targets hold the
+ * same content.
+ */
+bool attributesContentEquals(
+    const std::map<std::string, GLTF::Accessor*>& a,
+    const std::map<std::string, GLTF::Accessor*>& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (auto iterA = a.begin(), iterB = b.begin(); iterA != a.end();
+       iterA++, iterB++) {
+    if (iterA->first != iterB->first ||
+        !accessorContentEquals(iterA->second, iterB->second)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Checks whether two meshes have the same weights and primitives, with the
+ * same modes, materials and accessor content.
+ */
+bool meshContentEquals(GLTF::Mesh* a, GLTF::Mesh* b) {
+  if (a->weights != b->weights ||
+      a->primitives.size() != b->primitives.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a->primitives.size(); i++) {
+    GLTF::Primitive* primitiveA = a->primitives[i];
+    GLTF::Primitive* primitiveB = b->primitives[i];
+    if (primitiveA->mode != primitiveB->mode ||
+        primitiveA->material != primitiveB->material ||
+        primitiveA->targets.size() != primitiveB->targets.size() ||
+        !accessorContentEquals(primitiveA->indices, primitiveB->indices) ||
+        !attributesContentEquals(primitiveA->attributes,
+                                 primitiveB->attributes)) {
+      return false;
+    }
+    for (size_t j = 0; j < primitiveA->targets.size(); j++) {
+      if (!attributesContentEquals(primitiveA->targets[j]->attributes,
+                                   primitiveB->targets[j]->attributes)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * Gets every accessor used by the primitives and morph targets of a mesh.
+ */
+std::vector<GLTF::Accessor*> getMeshAccessors(GLTF::Mesh* mesh) {
+  std::vector<GLTF::Accessor*> accessors;
+  for (GLTF::Primitive* primitive : mesh->primitives) {
+    if (primitive->indices != NULL) {
+      accessors.push_back(primitive->indices);
+    }
+    for (const auto& attribute : primitive->attributes) {
+      accessors.push_back(attribute.second);
+    }
+    for (GLTF::Primitive::Target* target : primitive->targets) {
+      for (const auto& attribute : target->attributes) {
+        accessors.push_back(attribute.second);
+      }
+    }
+  }
+  return accessors;
+}
+
+/**
+ * Collapses meshes with identical content into one mesh shared by every node
+ * that used them, as exporters often write the same geometry several times.
+ * Meshes are fingerprinted by hashing their weights, and the modes, materials
+ * and accessor bytes of their primitives; meshes with the same fingerprint are
+ * then compared in full. Meshes with extensions or extras, or with accessors
+ * that have no bufferView, are left alone.
+ *
+ * @param meshCountBefore Receives the number of meshes before
+ * @param meshCountAfter Receives the number of meshes after
+ * @param bytesSaved Receives the byte length of the accessors no longer used
+ */
+void GLTF::Asset::deduplicateMeshes(size_t* meshCountBefore,
+                                    size_t* meshCountAfter,
+                                    size_t* bytesSaved) {
+  std::vector<GLTF::Mesh*> meshes = getAllMeshes();
+  std::map<GLTF::Accessor*, uint64_t> accessorHashes;
+  std::map<uint64_t, std::vector<GLTF::Mesh*>> meshesByHash;
+  std::map<GLTF::Mesh*, GLTF::Mesh*> replacements;
+  for (GLTF::Mesh* mesh : meshes) {
+    bool valid = mesh->extensions.size() == 0 && mesh->extras.size() == 0;
+    for (GLTF::Primitive* primitive : mesh->primitives) {
+      valid = valid && primitive->extensions.size() == 0 &&
+              primitive->extras.size() == 0;
+    }
+    std::vector<GLTF::Accessor*> accessors = getMeshAccessors(mesh);
+    for (GLTF::Accessor* accessor : accessors) {
+      valid = valid && accessor != NULL && accessor->bufferView != NULL &&
+              accessor->bufferView->buffer != NULL;
+    }
+    if (!valid) {
+      continue;
+    }
+
+    uint64_t hash = hashBytes(FNV_OFFSET_BASIS, mesh->weights.data(),
+                              mesh->weights.size() * sizeof(float));
+    for (GLTF::Primitive* primitive : mesh->primitives) {
+      GLTF::Material* material = primitive->material;
+      hash = hashBytes(hash, &primitive->mode, sizeof(primitive->mode));
+      hash = hashBytes(hash, &material, sizeof(material));
+      for (const auto& attribute : primitive->attributes) {
+        hash = hashBytes(hash, attribute.first.data(), attribute.first.size());
+      }
+    }
+    for (GLTF::Accessor* accessor : accessors) {
+      auto hashPtr = accessorHashes.find(accessor);
+      if (hashPtr == accessorHashes.end()) {
+        hashPtr = accessorHashes
+                      .insert(std::make_pair(accessor, hashAccessor(accessor)))
+                      .first;
+      }
+      hash = hashBytes(hash, &hashPtr->second, sizeof(uint64_t));
+    }
+
+    std::vector<GLTF::Mesh*>& candidates = meshesByHash[hash];
+    for (GLTF::Mesh* candidate : candidates) {
+      if (meshContentEquals(candidate, mesh)) {
+        replacements[mesh] = candidate;
+        break;
+      }
+    }
+    if (replacements.find(mesh) == replacements.end()) {
+      candidates.push_back(mesh);
+    }
+  }
+
+  for (GLTF::Node* node : getAllNodes()) {
+    auto replacementPtr = replacements.find(node->mesh);
+    if (replacementPtr != replacements.end()) {
+      node->mesh = replacementPtr->second;
+    }
+  }
+
+  std::set<GLTF::Accessor*> usedAccessors;
+  for (GLTF::Mesh* mesh : getAllMeshes()) {
+    for (GLTF::Accessor* accessor : getMeshAccessors(mesh)) {
+      usedAccessors.insert(accessor);
+    }
+  }
+  std::set<GLTF::Accessor*> removedAccessors;
+  *bytesSaved = 0;
+  for (const auto& replacement : replacements) {
+    for (GLTF::Accessor* accessor : getMeshAccessors(replacement.first)) {
+      if (usedAccessors.find(accessor) == usedAccessors.end() &&
+          removedAccessors.insert(accessor).second) {
+        *bytesSaved += accessor->count * accessor->getNumberOfComponents() *
+                       accessor->getComponentByteLength();
+      }
+    }
+  }
+  *meshCountBefore = meshes.size();
+  *meshCountAfter = meshes.size() - replacements.size();
+}
+
+/**
+ * Collapses accessors with identical content into one accessor shared by
+ * every primitive, morph target, skin, instancing extension, animation sampler
+ * and sparse accessor that used them. Animation times, texture coordinates
+ * and inverse bind matrices are often written once per use by exporters.
+ * Accessors are fingerprinted by hashing their layout, bufferView target and
+ * element bytes; accessors with the same fingerprint are then compared in
+ * full. Sparse accessors, accessors with extensions or extras, and accessors
+ * with no bufferView are left alone.
+ *
+ * @param accessorCountBefore Receives the number of accessors before
+ * @param accessorCountAfter Receives the number of accessors after
+ * @param bytesSaved Receives the byte length of the accessors no longer used
+ */
+void GLTF::Asset::deduplicateAccessors(size_t* accessorCountBefore,
+                                       size_t* accessorCountAfter,
+                                       size_t* bytesSaved) {
+  std::vector<GLTF::Accessor*> accessors = getAllAccessors();
+  std::map<uint64_t, std::vector<GLTF::Accessor*>> accessorsByHash;
+  std::map<GLTF::Accessor*, GLTF::Accessor*> replacements;
+  *bytesSaved = 0;
   for (GLTF::Accessor* accessor : accessors) {
-    int componentByteLength = accessor->getComponentByteLength();
-    int padding = byteLength % componentByteLength;
-    if (padding != 0) {
-      byteLength += (componentByteLength - padding);
-    }
-    byteOffsets[accessor] = byteLength;
-    byteLength += componentByteLength * accessor->getNumberOfComponents() *
-                  accessor->count;
-  }
-  unsigned char* bufferData = (unsigned char*)malloc(byteLength);
-  GLTF::BufferView* bufferView =
-      new GLTF::BufferView(bufferData, byteLength, target);
+    if (accessor->sparseIndices != NULL || accessor->bufferView == NULL ||
+        accessor->bufferView->buffer == NULL ||
+        accessor->bufferView->buffer->data == NULL ||
+        accessor->extensions.size() > 0 || accessor->extras.size() > 0) {
+      continue;
+    }
+    // Index and vertex data are packed into different bufferViews, so they
+    // are never shared
+    GLTF::Constants::WebGL target = accessor->bufferView->target;
+    uint64_t hash = hashAccessor(accessor);
+    hash = hashBytes(hash, &target, sizeof(target));
+
+    std::vector<GLTF::Accessor*>& candidates = accessorsByHash[hash];
+    for (GLTF::Accessor* candidate : candidates) {
+      if (candidate->bufferView->target == target &&
+          accessorContentEquals(candidate, accessor)) {
+        replacements[accessor] = candidate;
+        *bytesSaved += accessor->count * accessor->getNumberOfComponents() *
+                       accessor->getComponentByteLength();
+        break;
+      }
+    }
+    if (replacements.find(accessor) == replacements.end()) {
+      candidates.push_back(accessor);
+    }
+  }
+
+  auto replace = [&replacements](GLTF::Accessor** accessor) {
+    auto replacementPtr = replacements.find(*accessor);
+    if (replacementPtr != replacements.end()) {
+      *accessor = replacementPtr->second;
+    }
+  };
+  for (GLTF::Skin* skin : getAllSkins()) {
+    replace(&skin->inverseBindMatrices);
+  }
+  for (GLTF::Primitive* primitive : getAllPrimitives()) {
+    replace(&primitive->indices);
+    for (auto& attribute : primitive->attributes) {
+      replace(&attribute.second);
+    }
+    for (GLTF::Primitive::Target* target : primitive->targets) {
+      for (auto& attribute : target->attributes) {
+        replace(&attribute.second);
+      }
+    }
+  }
+  for (GLTF::Node* node : getAllNodes()) {
+    auto instancingExtensionPtr =
+        node->extensions.find("EXT_mesh_gpu_instancing");
+    if (instancingExtensionPtr != node->extensions.end()) {
+      for (auto& attribute : static_cast<GLTF::InstancingExtension*>(
+                                 instancingExtensionPtr->second)
+                                 ->attributes) {
+        replace(&attribute.second);
+      }
+    }
+  }
+  for (GLTF::Animation* animation : animations) {
+    for (GLTF::Animation::Channel* channel : animation->channels) {
+      replace(&channel->sampler->input);
+      replace(&channel->sampler->output);
+    }
+  }
   for (GLTF::Accessor* accessor : accessors) {
-    size_t byteOffset = byteOffsets[accessor];
-    auto packedAccessor = std::unique_ptr<GLTF::Accessor>(
-        new GLTF::Accessor(accessor->type, accessor->componentType, byteOffset,
-                           accessor->count, bufferView));
-    int numberOfComponents = accessor->getNumberOfComponents();
-    std::vector<float> component(numberOfComponents);
-    for (int i = 0; i < accessor->count; i++) {
-      accessor->getComponentAtIndex(i, component.data());
-      packedAccessor->writeComponentAtIndex(i, component.data());
-    }
-    accessor->byteOffset = packedAccessor->byteOffset;
-    accessor->bufferView = packedAccessor->bufferView;
+    replace(&accessor->sparseIndices);
+    replace(&accessor->sparseValues);
+  }
+  *accessorCountBefore = accessors.size();
+  *accessorCountAfter = accessors.size() - replacements.size();
+}
+
+/**
+ * Reads the values of an index accessor.
+ * @return `false` if the accessor does not hold unsigned integer indices
+ */
+bool readIndices(GLTF::Accessor* accessor, std::vector<unsigned int>* indices) {
+  if (accessor->bufferView == NULL) {
+    return false;
+  }
+  unsigned char* data = accessor->bufferView->buffer->data +
+                        accessor->bufferView->byteOffset + accessor->byteOffset;
+  indices->resize(accessor->count);
+  for (size_t i = 0; i < accessor->count; i++) {
+    switch (accessor->componentType) {
+      case GLTF::Constants::WebGL::UNSIGNED_BYTE:
+        (*indices)[i] = data[i];
+        break;
+      case GLTF::Constants::WebGL::UNSIGNED_SHORT:
+        (*indices)[i] = reinterpret_cast<uint16_t*>(data)[i];
+        break;
+      case GLTF::Constants::WebGL::UNSIGNED_INT:
+        (*indices)[i] = reinterpret_cast<uint32_t*>(data)[i];
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Overwrites the values of an index accessor read with `readIndices`, and
+ * updates its bounds.
+ */
+void writeIndices(GLTF::Accessor* accessor,
+                  const std::vector<unsigned int>& indices) {
+  unsigned char* data = accessor->bufferView->buffer->data +
+                        accessor->bufferView->byteOffset + accessor->byteOffset;
+  for (size_t i = 0; i < accessor->count; i++) {
+    switch (accessor->componentType) {
+      case GLTF::Constants::WebGL::UNSIGNED_BYTE:
+        data[i] = static_cast<unsigned char>(indices[i]);
+        break;
+      case GLTF::Constants::WebGL::UNSIGNED_SHORT:
+        reinterpret_cast<uint16_t*>(data)[i] =
+            static_cast<uint16_t>(indices[i]);
+        break;
+      default:
+        reinterpret_cast<uint32_t*>(data)[i] = indices[i];
+        break;
+    }
+  }
+  if (accessor->min != NULL) {
+    accessor->computeMinMax();
+  }
+}
+
+/**
+ * Reorders the triangles of every indexed TRIANGLES primitive to improve
+ * post-transform vertex cache hit rates when rendering. Primitives using the
+ * Draco extension are skipped, since the encoder chooses its own order.
+ *
+ * @param before Receives the vertex cache statistics of the original indices
+ * @param after Receives the vertex cache statistics of the optimized indices
+ */
+void GLTF::Asset::optimizeVertexCache(
+    GLTF::MeshOptimizer::VertexCacheStatistics* before,
+    GLTF::MeshOptimizer::VertexCacheStatistics* after) {
+  // Statistics are reported for a FIFO cache of this many vertices
+  const size_t statisticsCacheSize = 32;
+  std::set<GLTF::Accessor*> optimizedIndices;
+  std::vector<unsigned int> indices;
+  for (GLTF::Primitive* primitive : getAllPrimitives()) {
+    GLTF::Accessor* indicesAccessor = primitive->indices;
+    if (primitive->mode != GLTF::Primitive::Mode::TRIANGLES ||
+        indicesAccessor == NULL ||
+        primitive->extensions.find("KHR_draco_mesh_compression") !=
+            primitive->extensions.end() ||
+        optimizedIndices.find(indicesAccessor) != optimizedIndices.end()) {
+      continue;
+    }
+    if (!readIndices(indicesAccessor, &indices)) {
+      continue;
+    }
+    optimizedIndices.insert(indicesAccessor);
+    size_t vertexCount = 0;
+    for (unsigned int index : indices) {
+      vertexCount = std::max(vertexCount, static_cast<size_t>(index) + 1);
+    }
+    before->add(GLTF::MeshOptimizer::analyzeVertexCache(indices, vertexCount,
+                                                        statisticsCacheSize));
+    GLTF::MeshOptimizer::optimizeVertexCache(&indices, vertexCount);
+    after->add(GLTF::MeshOptimizer::analyzeVertexCache(indices, vertexCount,
+                                                       statisticsCacheSize));
+    writeIndices(indicesAccessor, indices);
+  }
+}
+
+/**
+ * Reorders clusters of triangles in every indexed TRIANGLES primitive so that
+ * outward facing triangles are drawn first, using the POSITION attribute.
+ * Run this after `optimizeVertexCache`, since it keeps runs of triangles that
+ * use the vertex cache well together.
+ *
+ * @param threshold The allowed vertex cache degradation, e.g. `1.05`
+ */
+void GLTF::Asset::optimizeOverdraw(float threshold) {
+  std::set<GLTF::Accessor*> optimizedIndices;
+  std::vector<unsigned int> indices;
+  std::vector<float> positions;
+  for (GLTF::Primitive* primitive : getAllPrimitives()) {
+    GLTF::Accessor* indicesAccessor = primitive->indices;
+    auto positionPtr = primitive->attributes.find("POSITION");
+    if (primitive->mode != GLTF::Primitive::Mode::TRIANGLES ||
+        indicesAccessor == NULL || positionPtr == primitive->attributes.end() ||
+        primitive->extensions.find("KHR_draco_mesh_compression") !=
+            primitive->extensions.end() ||
+        optimizedIndices.find(indicesAccessor) != optimizedIndices.end()) {
+      continue;
+    }
+    GLTF::Accessor* positionAccessor = positionPtr->second;
+    if (positionAccessor == NULL || positionAccessor->bufferView == NULL ||
+        positionAccessor->getNumberOfComponents() != 3 ||
+        !readIndices(indicesAccessor, &indices)) {
+      continue;
+    }
+    bool valid = true;
+    for (unsigned int index : indices) {
+      valid = valid && index < positionAccessor->count;
+    }
+    if (!valid) {
+      continue;
+    }
+    optimizedIndices.insert(indicesAccessor);
+    positions.resize(positionAccessor->count * 3);
+    positionAccessor->getComponents(positions.data());
+    GLTF::MeshOptimizer::optimizeOverdraw(&indices, positions, threshold);
+    writeIndices(indicesAccessor, indices);
+  }
+}
+
+/**
+ * Moves the elements of a vertex attribute accessor to their new indices.
+ */
+void remapAccessor(GLTF::Accessor* accessor,
+                   const std::vector<unsigned int>& remap) {
+  size_t elementSize =
+      accessor->getNumberOfComponents() * accessor->getComponentByteLength();
+  size_t byteStride = accessor->getByteStride();
+  unsigned char* data = accessor->bufferView->buffer->data +
+                        accessor->bufferView->byteOffset + accessor->byteOffset;
+  std::vector<unsigned char> elements(accessor->count * elementSize);
+  for (size_t i = 0; i < accessor->count; i++) {
+    std::memcpy(&elements[remap[i] * elementSize], data + i * byteStride,
+                elementSize);
+  }
+  for (size_t i = 0; i < accessor->count; i++) {
+    std::memcpy(data + i * byteStride, &elements[i * elementSize],
+                elementSize);
+  }
+}
+
+/**
+ * The vertex attributes used with one indices accessor.
+ */
+struct IndexedVertices {
+  GLTF::Accessor* indices = NULL;
+  GLTF::Accessor* position = NULL;
+  bool triangles = true;
+  size_t vertexCount = 0;
+  /** Every attribute and morph target attribute, with its semantic */
+  std::vector<std::pair<std::string, GLTF::Accessor*>> attributes;
+};
+
+/**
+ * Groups the vertex attributes of indexed primitives by their indices, so that
+ * vertices can be renumbered for every primitive using them. Groups are left
+ * out if they use Draco compression, if their attributes are also used with
+ * other indices or without indices, or if their attributes differ in length.
+ */
+std::vector<IndexedVertices> getIndexedVertices(GLTF::Asset* asset) {
+  std::vector<GLTF::Accessor*> indicesAccessors;
+  std::map<GLTF::Accessor*, IndexedVertices> groups;
+  std::map<GLTF::Accessor*, GLTF::Accessor*> attributeIndices;
+  std::set<GLTF::Accessor*> skippedIndices;
+  for (GLTF::Primitive* primitive : asset->getAllPrimitives()) {
+    GLTF::Accessor* indicesAccessor = primitive->indices;
+    if (groups.find(indicesAccessor) == groups.end()) {
+      indicesAccessors.push_back(indicesAccessor);
+    }
+    IndexedVertices& group = groups[indicesAccessor];
+    group.indices = indicesAccessor;
+    group.triangles =
+        group.triangles && primitive->mode == GLTF::Primitive::Mode::TRIANGLES;
+    // Attributes of non-indexed primitives are registered so that they are
+    // not renumbered for some other primitive
+    if (indicesAccessor == NULL ||
+        primitive->extensions.find("KHR_draco_mesh_compression") !=
+            primitive->extensions.end()) {
+      skippedIndices.insert(indicesAccessor);
+    }
+    std::vector<std::pair<std::string, GLTF::Accessor*>> attributes(
+        primitive->attributes.begin(), primitive->attributes.end());
+    for (GLTF::Primitive::Target* target : primitive->targets) {
+      attributes.insert(attributes.end(), target->attributes.begin(),
+                        target->attributes.end());
+    }
+    for (const auto& attribute : attributes) {
+      GLTF::Accessor* accessor = attribute.second;
+      auto indicesPtr = attributeIndices.find(accessor);
+      if (indicesPtr == attributeIndices.end()) {
+        attributeIndices[accessor] = indicesAccessor;
+        group.attributes.push_back(attribute);
+      } else if (indicesPtr->second != indicesAccessor) {
+        skippedIndices.insert(indicesAccessor);
+        skippedIndices.insert(indicesPtr->second);
+      }
+    }
+    auto positionPtr = primitive->attributes.find("POSITION");
+    if (positionPtr != primitive->attributes.end()) {
+      group.position = positionPtr->second;
+    }
+  }
+
+  std::vector<IndexedVertices> indexedVertices;
+  for (GLTF::Accessor* indicesAccessor : indicesAccessors) {
+    IndexedVertices& group = groups[indicesAccessor];
+    if (skippedIndices.find(indicesAccessor) != skippedIndices.end() ||
+        indicesAccessor->bufferView == NULL || group.attributes.size() == 0 ||
+        group.attributes[0].second == NULL) {
+      continue;
+    }
+    bool valid = true;
+    group.vertexCount = group.attributes[0].second->count;
+    for (const auto& attribute : group.attributes) {
+      GLTF::Accessor* accessor = attribute.second;
+      valid = valid && accessor != NULL && accessor->bufferView != NULL &&
+              accessor->count == group.vertexCount;
+    }
+    if (valid) {
+      indexedVertices.push_back(group);
+    }
+  }
+  return indexedVertices;
+}
+
+/**
+ * Reads the indices of a group of vertices.
+ * @return `false` if they cannot be read or are out of range
+ */
+bool readVertexIndices(const IndexedVertices& group,
+                       std::vector<unsigned int>* indices) {
+  if (!readIndices(group.indices, indices)) {
+    return false;
+  }
+  for (unsigned int index : *indices) {
+    if (index >= group.vertexCount) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Reorders the vertices of every indexed primitive into the order they are
+ * first used by its indices, so that vertex fetches read memory linearly.
+ * Every attribute is remapped, including skinning attributes and morph
+ * targets. Attributes shared between primitives with different indices, and
+ * Draco primitives, are left alone.
+ *
+ * @param before Receives the vertex fetch statistics of the original order
+ * @param after Receives the vertex fetch statistics of the optimized order
+ */
+void GLTF::Asset::optimizeVertexFetch(
+    GLTF::MeshOptimizer::VertexFetchStatistics* before,
+    GLTF::MeshOptimizer::VertexFetchStatistics* after) {
+  std::vector<unsigned int> indices;
+  for (const IndexedVertices& group : getIndexedVertices(this)) {
+    if (!readVertexIndices(group, &indices)) {
+      continue;
+    }
+    for (const auto& attribute : group.attributes) {
+      GLTF::Accessor* accessor = attribute.second;
+      before->add(GLTF::MeshOptimizer::analyzeVertexFetch(
+          indices, group.vertexCount,
+          accessor->getNumberOfComponents() *
+              accessor->getComponentByteLength()));
+    }
+    std::vector<unsigned int> remap =
+        GLTF::MeshOptimizer::optimizeVertexFetch(&indices, group.vertexCount);
+    for (const auto& attribute : group.attributes) {
+      GLTF::Accessor* accessor = attribute.second;
+      remapAccessor(accessor, remap);
+      after->add(GLTF::MeshOptimizer::analyzeVertexFetch(
+          indices, group.vertexCount,
+          accessor->getNumberOfComponents() *
+              accessor->getComponentByteLength()));
+    }
+    writeIndices(group.indices, indices);
+  }
+}
+
+/**
+ * Gets the semantic of an attribute without its set index, e.g. `TEXCOORD`
+ * for `TEXCOORD_1`.
+ */
+std::string getBaseSemantic(const std::string& semantic) {
+  size_t separator = semantic.rfind('_');
+  if (separator == std::string::npos || separator + 1 == semantic.size() ||
+      semantic.find_first_not_of("0123456789", separator + 1) !=
+          std::string::npos) {
+    return semantic;
+  }
+  return semantic.substr(0, separator);
+}
+
+/**
+ * Reads every element of an accessor as floats.
+ */
+std::vector<float> readElements(GLTF::Accessor* accessor) {
+  int numberOfComponents = accessor->getNumberOfComponents();
+  std::vector<float> values(accessor->count * numberOfComponents);
+  accessor->getComponents(values.data());
+  return values;
+}
+
+/**
+ * Keeps only the first element of an accessor mapped to each new index by a
+ * weld, in order.
+ */
+void compactAccessor(GLTF::Accessor* accessor,
+                     const std::vector<unsigned int>& remap) {
+  size_t elementSize =
+      accessor->getNumberOfComponents() * accessor->getComponentByteLength();
+  size_t byteStride = accessor->getByteStride();
+  unsigned char* data = accessor->bufferView->buffer->data +
+                        accessor->bufferView->byteOffset + accessor->byteOffset;
+  unsigned int count = 0;
+  for (size_t i = 0; i < accessor->count; i++) {
+    if (remap[i] == count) {
+      if (count != static_cast<unsigned int>(i)) {
+        std::memcpy(data + count * byteStride, data + i * byteStride,
+                    elementSize);
+      }
+      count++;
+    }
+  }
+  accessor->count = count;
+  if (accessor->min != NULL) {
+    accessor->computeMinMax();
+  }
+}
+
+/**
+ * Welds vertices of every indexed primitive that are within tolerance of each
+ * other, then removes the degenerate triangles this creates. Positions are
+ * matched with a spatial hash, and every other attribute, including morph
+ * targets, must also match. Tolerances are looked up by semantic without its
+ * set index, e.g. `TEXCOORD`; attributes without a tolerance must be equal.
+ *
+ * @param tolerances The largest component difference allowed per semantic
+ * @param vertexCountBefore Receives the number of vertices before welding
+ * @param vertexCountAfter Receives the number of vertices after welding
+ * @param removedTriangles Receives the number of degenerate triangles removed
+ */
+void GLTF::Asset::weldVertices(const std::map<std::string, float>& tolerances,
+                               size_t* vertexCountBefore,
+                               size_t* vertexCountAfter,
+                               size_t* removedTriangles) {
+  std::vector<unsigned int> indices;
+  for (const IndexedVertices& group : getIndexedVertices(this)) {
+    if (group.position == NULL ||
+        group.position->getNumberOfComponents() != 3 ||
+        !readVertexIndices(group, &indices)) {
+      continue;
+    }
+    std::vector<std::vector<float>> values;
+    std::vector<GLTF::MeshOptimizer::WeldAttribute> attributes;
+    float positionTolerance = 0;
+    for (const auto& attribute : group.attributes) {
+      auto tolerancePtr = tolerances.find(getBaseSemantic(attribute.first));
+      float tolerance =
+          tolerancePtr == tolerances.end() ? 0 : tolerancePtr->second;
+      if (attribute.second == group.position) {
+        positionTolerance = tolerance;
+        continue;
+      }
+      values.push_back(readElements(attribute.second));
+      GLTF::MeshOptimizer::WeldAttribute weldAttribute;
+      weldAttribute.numberOfComponents =
+          attribute.second->getNumberOfComponents();
+      weldAttribute.tolerance = tolerance;
+      attributes.push_back(weldAttribute);
+    }
+    for (size_t i = 0; i < attributes.size(); i++) {
+      attributes[i].values = values[i].data();
+    }
+    std::vector<unsigned int> remap = GLTF::MeshOptimizer::weldVertices(
+        readElements(group.position), positionTolerance, attributes);
+
+    for (const auto& attribute : group.attributes) {
+      compactAccessor(attribute.second, remap);
+    }
+    for (unsigned int& index : indices) {
+      index = remap[index];
+    }
+    if (group.triangles) {
+      *removedTriangles +=
+          GLTF::MeshOptimizer::removeDegenerateTriangles(&indices);
+    }
+    group.indices->count = indices.size();
+    writeIndices(group.indices, indices);
+    *vertexCountBefore += group.vertexCount;
+    *vertexCountAfter += group.attributes[0].second->count;
   }
-  return bufferView;
 }
 
 bool GLTF::Asset::compressPrimitives(GLTF::Options* options) {
@@ -877,128 +1640,1811 @@ bool GLTF::Asset::compressPrimitives(GLTF::Options* options) {
   return true;
 }
 
-GLTF::Buffer* GLTF::Asset::packAccessors() {
-  std::map<GLTF::Constants::WebGL, std::map<int, std::vector<GLTF::Accessor*>>>
-      accessorGroups;
-  accessorGroups[GLTF::Constants::WebGL::ARRAY_BUFFER] =
-      std::map<int, std::vector<GLTF::Accessor*>>();
-  accessorGroups[GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER] =
-      std::map<int, std::vector<GLTF::Accessor*>>();
-  accessorGroups[(GLTF::Constants::WebGL)-1] =
-      std::map<int, std::vector<GLTF::Accessor*>>();
-
-  size_t byteLength = 0;
-  for (GLTF::Accessor* accessor : getAllAccessors()) {
-    // In glTF 2.0, bufferView is not required in accessor.
-    if (accessor->bufferView == NULL) {
+/**
+ * Gets the byte length of an interleaved element, padded to 4 bytes as glTF
+ * requires for vertex attributes.
+ */
+int getInterleavedByteLength(GLTF::Accessor* accessor) {
+  int byteLength =
+      accessor->getNumberOfComponents() * accessor->getComponentByteLength();
+  return (byteLength + 3) / 4 * 4;
+}
+
+/**
+ * Groups the vertex attributes of each primitive to interleave together.
+ * Primitives sharing all of their attributes, like those of cloned meshes,
+ * share a group. Attributes are left out if they are shared with some other
+ * set of attributes or used as morph targets, if they differ in length, or
+ * if the interleaved stride would be over the glTF limit of 252 bytes.
+ */
+std::vector<std::vector<GLTF::Accessor*>> getInterleavedAccessors(
+    GLTF::Asset* asset) {
+  std::vector<std::vector<GLTF::Accessor*>> groups;
+  std::map<GLTF::Accessor*, size_t> accessorGroups;
+  std::set<size_t> skippedGroups;
+  std::set<GLTF::Accessor*> targetAccessors;
+  for (GLTF::Primitive* primitive : asset->getAllPrimitives()) {
+    for (GLTF::Primitive::Target* target : primitive->targets) {
+      for (const auto& attribute : target->attributes) {
+        targetAccessors.insert(attribute.second);
+      }
+    }
+    if (primitive->extensions.find("KHR_draco_mesh_compression") !=
+        primitive->extensions.end()) {
       continue;
     }
-    GLTF::Constants::WebGL target = accessor->bufferView->target;
-    auto targetGroup = accessorGroups[target];
-    int byteStride = accessor->getByteStride();
-    auto findByteStrideGroup = targetGroup.find(byteStride);
-    std::vector<GLTF::Accessor*> byteStrideGroup;
-    if (findByteStrideGroup == targetGroup.end()) {
-      byteStrideGroup = std::vector<GLTF::Accessor*>();
-    } else {
-      byteStrideGroup = findByteStrideGroup->second;
+    std::vector<GLTF::Accessor*> accessors;
+    for (const auto& attribute : primitive->attributes) {
+      if (attribute.second != NULL && attribute.second->bufferView != NULL) {
+        accessors.push_back(attribute.second);
+      }
     }
-    byteStrideGroup.push_back(accessor);
-    targetGroup[byteStride] = byteStrideGroup;
-    accessorGroups[target] = targetGroup;
-    byteLength += accessor->bufferView->byteLength;
-  }
-
-  // Go through primitives and look for primitives that use Draco extension.
-  // If extension is not enabled, the vector will be empty.
-  std::vector<GLTF::BufferView*> compressedBufferViews =
-      getAllCompressedBufferView();
-  // Reserve data for compressed data.
-  for (GLTF::BufferView* compressedBufferView : compressedBufferViews) {
-    byteLength += compressedBufferView->byteLength;
-  }
-
-  auto existingBufferViews = getAllBufferViews();
-  std::vector<int> byteStrides;
-  std::map<int, std::vector<GLTF::BufferView*>> bufferViews;
-  for (auto targetGroup : accessorGroups) {
-    for (auto byteStrideGroup : targetGroup.second) {
-      GLTF::Constants::WebGL target = targetGroup.first;
-      int byteStride = byteStrideGroup.first;
-      GLTF::BufferView* bufferView = packAccessorsForTargetByteStride(
-          byteStrideGroup.second, target, byteStride);
-      if (target == GLTF::Constants::WebGL::ARRAY_BUFFER) {
-        bufferView->byteStride = byteStride;
-      }
-      auto findBufferViews = bufferViews.find(byteStride);
-      std::vector<GLTF::BufferView*> bufferViewGroup;
-      if (findBufferViews == bufferViews.end()) {
-        byteStrides.push_back(byteStride);
-        bufferViewGroup = std::vector<GLTF::BufferView*>();
+    if (accessors.empty()) {
+      continue;
+    }
+    auto groupPtr = accessorGroups.find(accessors[0]);
+    if (groupPtr != accessorGroups.end() &&
+        groups[groupPtr->second] == accessors) {
+      continue;
+    }
+    size_t group = groups.size();
+    groups.push_back(accessors);
+    for (GLTF::Accessor* accessor : accessors) {
+      auto existingGroupPtr = accessorGroups.find(accessor);
+      if (existingGroupPtr != accessorGroups.end()) {
+        skippedGroups.insert(existingGroupPtr->second);
+        skippedGroups.insert(group);
       } else {
-        bufferViewGroup = findBufferViews->second;
+        accessorGroups[accessor] = group;
       }
-      bufferViewGroup.push_back(bufferView);
-      bufferViews[byteStride] = bufferViewGroup;
     }
   }
-  std::sort(byteStrides.begin(), byteStrides.end(), std::greater<int>());
-
-  // Pack these into a buffer sorted from largest byteStride to smallest
-  auto existingBuffers = getAllBuffers();
-  std::set<GLTF::BufferView*> newBufferViews;
-  unsigned char* bufferData = (unsigned char*)malloc(byteLength);
-  GLTF::Buffer* buffer = new GLTF::Buffer(bufferData, byteLength);
-  size_t byteOffset = 0;
-  for (int byteStride : byteStrides) {
-    for (GLTF::BufferView* bufferView : bufferViews[byteStride]) {
-      std::memcpy(bufferData + byteOffset, bufferView->buffer->data,
-                  bufferView->byteLength);
-      bufferView->byteOffset = byteOffset;
-      bufferView->buffer = buffer;
-      byteOffset += bufferView->byteLength;
-      newBufferViews.insert(bufferView);
-    }
-  }
-
-  // Append compressed data to buffer.
-  for (GLTF::BufferView* compressedBufferView : compressedBufferViews) {
-    std::memcpy(bufferData + byteOffset, compressedBufferView->buffer->data,
-                compressedBufferView->byteLength);
-    compressedBufferView->byteOffset = byteOffset;
-    compressedBufferView->buffer = buffer;
-    byteOffset += compressedBufferView->byteLength;
-  }
-
-  // Delete old buffers since we packed everything into one
-  for (auto& existingBuffer : existingBuffers) {
-    delete existingBuffer;
-  }
 
-  // Delete old bufferviews that are no longer used
-  for (auto& existingBufferView : existingBufferViews) {
-    if (newBufferViews.find(existingBufferView) == newBufferViews.end()) {
-      delete existingBufferView;
+  std::vector<std::vector<GLTF::Accessor*>> interleavedAccessors;
+  for (size_t group = 0; group < groups.size(); group++) {
+    const std::vector<GLTF::Accessor*>& accessors = groups[group];
+    bool valid = skippedGroups.find(group) == skippedGroups.end();
+    int byteStride = 0;
+    for (GLTF::Accessor* accessor : accessors) {
+      valid = valid && accessor->count == accessors[0]->count &&
+              targetAccessors.find(accessor) == targetAccessors.end();
+      byteStride += getInterleavedByteLength(accessor);
+    }
+    if (valid && byteStride <= 252) {
+      interleavedAccessors.push_back(accessors);
     }
   }
-
-  return buffer;
+  return interleavedAccessors;
 }
 
-void GLTF::Asset::requireExtension(std::string extension) {
-  useExtension(extension);
-  extensionsRequired.insert(extension);
+/**
+ * Packs the vertex attributes of a primitive into one interleaved
+ * `ARRAY_BUFFER` bufferView, aligning each attribute to 4 bytes.
+ */
+GLTF::BufferView* interleaveAccessors(
+    const std::vector<GLTF::Accessor*>& accessors) {
+  std::vector<int> byteOffsets;
+  int byteStride = 0;
+  for (GLTF::Accessor* accessor : accessors) {
+    byteOffsets.push_back(byteStride);
+    byteStride += getInterleavedByteLength(accessor);
+  }
+  size_t count = accessors[0]->count;
+  size_t byteLength = count * byteStride;
+  // Zero the padding between attributes
+  unsigned char* bufferData = (unsigned char*)calloc(byteLength, 1);
+  GLTF::BufferView* bufferView = new GLTF::BufferView(
+      bufferData, byteLength, GLTF::Constants::WebGL::ARRAY_BUFFER);
+  bufferView->byteStride = byteStride;
+  for (size_t i = 0; i < accessors.size(); i++) {
+    GLTF::Accessor* accessor = accessors[i];
+    auto interleavedAccessor = std::unique_ptr<GLTF::Accessor>(
+        new GLTF::Accessor(accessor->type, accessor->componentType,
+                           byteOffsets[i], count, bufferView));
+    accessor->copyComponents(interleavedAccessor.get());
+    accessor->byteOffset = interleavedAccessor->byteOffset;
+    accessor->bufferView = bufferView;
+  }
+  return bufferView;
 }
 
-void GLTF::Asset::useExtension(std::string extension) {
-  extensionsUsed.insert(extension);
+/**
+ * Creates an index accessor holding `indices`.
+ */
+GLTF::Accessor* createIndexAccessor(GLTF::Constants::WebGL componentType,
+                                    const std::vector<unsigned int>& indices) {
+  std::vector<unsigned char> data(
+      GLTF::Accessor::getComponentByteLength(componentType) * indices.size());
+  GLTF::Accessor* accessor = new GLTF::Accessor(
+      GLTF::Accessor::Type::SCALAR, componentType, std::move(data),
+      GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+  writeIndices(accessor, indices);
+  return accessor;
 }
 
-void writeAssetMetadataJSON(
-    GLTF::Asset* asset, rapidjson::Writer<rapidjson::StringBuffer>* jsonWriter,
-    GLTF::Options* options) {
-  if (asset->metadata) {
-    jsonWriter->Key("asset");
+/**
+ * Builds lower detail versions of every mesh with indexed TRIANGLES
+ * primitives by simplifying their indices, and links them to the nodes using
+ * the mesh with the MSFT_lod extension. LOD meshes share vertex attributes,
+ * morph targets and materials with the original mesh, so skinning and
+ * morphing keep working. A level is only added while it has fewer indices
+ * than the level before it.
+ *
+ * LOD nodes replace the whole node they belong to, so the mesh of a node with
+ * children is moved to a new child node first. Nodes with extensions, like
+ * GPU instancing, are skipped since LOD nodes would not keep them.
+ *
+ * @param ratios The fraction of triangles to keep in each level
+ * @param screenCoverage The screen coverage below which the original mesh and
+ * each level are no longer used, or empty to leave it to the client
+ * @param error The largest simplification error, relative to the extent of
+ * each primitive
+ */
+void GLTF::Asset::generateLods(const std::vector<float>& ratios,
+                               const std::vector<float>& screenCoverage,
+                               float error) {
+  std::map<GLTF::Mesh*, std::vector<GLTF::Mesh*>> meshLods;
+  for (GLTF::Mesh* mesh : getAllMeshes()) {
+    size_t primitiveCount = mesh->primitives.size();
+    std::vector<std::vector<unsigned int>> primitiveIndices(primitiveCount);
+    std::vector<std::vector<float>> primitivePositions(primitiveCount);
+    size_t previousIndexCount = 0;
+    for (size_t p = 0; p < primitiveCount; p++) {
+      GLTF::Primitive* primitive = mesh->primitives[p];
+      auto positionPtr = primitive->attributes.find("POSITION");
+      if (primitive->mode != GLTF::Primitive::Mode::TRIANGLES ||
+          primitive->indices == NULL ||
+          positionPtr == primitive->attributes.end() ||
+          positionPtr->second->bufferView == NULL ||
+          primitive->extensions.find("KHR_draco_mesh_compression") !=
+              primitive->extensions.end() ||
+          !readIndices(primitive->indices, &primitiveIndices[p])) {
+        primitiveIndices[p].clear();
+        continue;
+      }
+      primitivePositions[p] = readElements(positionPtr->second);
+      previousIndexCount += primitiveIndices[p].size();
+    }
+
+    for (float ratio : ratios) {
+      std::vector<std::vector<unsigned int>> lodIndices(primitiveCount);
+      size_t indexCount = 0;
+      for (size_t p = 0; p < primitiveCount; p++) {
+        const std::vector<unsigned int>& indices = primitiveIndices[p];
+        if (indices.size() == 0) {
+          continue;
+        }
+        size_t targetIndexCount =
+            static_cast<size_t>(indices.size() / 3 * ratio) * 3;
+        lodIndices[p] = GLTF::MeshOptimizer::simplify(
+            indices, primitivePositions[p], targetIndexCount, error);
+        GLTF::MeshOptimizer::optimizeVertexCache(
+            &lodIndices[p], primitivePositions[p].size() / 3);
+        indexCount += lodIndices[p].size();
+      }
+      if (indexCount == 0 || indexCount >= previousIndexCount) {
+        break;
+      }
+      previousIndexCount = indexCount;
+
+      GLTF::Mesh* lod = new GLTF::Mesh();
+      if (mesh->name.length() > 0) {
+        lod->name =
+            mesh->name + "_LOD" + std::to_string(meshLods[mesh].size() + 1);
+      }
+      lod->weights = mesh->weights;
+      for (size_t p = 0; p < primitiveCount; p++) {
+        GLTF::Primitive* primitive = mesh->primitives[p];
+        if (primitiveIndices[p].size() > 0 && lodIndices[p].size() == 0) {
+          continue;
+        }
+        GLTF::Primitive* lodPrimitive = new GLTF::Primitive();
+        primitive->clone(lodPrimitive);
+        if (primitiveIndices[p].size() > 0) {
+          lodPrimitive->indices = createIndexAccessor(
+              primitive->indices->componentType, lodIndices[p]);
+        }
+        lod->primitives.push_back(lodPrimitive);
+      }
+      meshLods[mesh].push_back(lod);
+    }
+  }
+
+  for (GLTF::Node* node : getAllNodes()) {
+    auto lodsPtr = meshLods.find(node->mesh);
+    if (node->mesh == NULL || lodsPtr == meshLods.end() ||
+        node->light != NULL || node->extensions.size() > 0) {
+      continue;
+    }
+    GLTF::Node* baseNode = node;
+    if (node->children.size() > 0) {
+      baseNode = new GLTF::Node();
+      baseNode->mesh = node->mesh;
+      baseNode->skin = node->skin;
+      node->mesh = NULL;
+      node->skin = NULL;
+      node->children.push_back(baseNode);
+    }
+    GLTF::LodExtension* lodExtension = new GLTF::LodExtension();
+    for (GLTF::Mesh* lod : lodsPtr->second) {
+      GLTF::Node* lodNode = new GLTF::Node();
+      lodNode->mesh = lod;
+      lodNode->skin = baseNode->skin;
+      if (baseNode->transform != NULL) {
+        lodNode->transform = baseNode->transform->clone();
+      }
+      lodExtension->lods.push_back(lodNode);
+    }
+    if (screenCoverage.size() > lodExtension->lods.size()) {
+      lodExtension->screenCoverage.assign(
+          screenCoverage.begin(),
+          screenCoverage.begin() + lodExtension->lods.size() + 1);
+    }
+    baseNode->extensions["MSFT_lod"] = lodExtension;
+    useExtension("MSFT_lod");
+  }
+}
+
+/**
+ * Gets the transform of a node relative to its parent as a matrix.
+ */
+void getLocalMatrix(GLTF::Node* node, float* matrix) {
+  GLTF::Node::TransformMatrix identity;
+  const float* local = identity.matrix;
+  GLTF::Node::TransformMatrix* trsMatrix = NULL;
+  if (node->transform != NULL) {
+    if (node->transform->type == GLTF::Node::Transform::MATRIX) {
+      local =
+          static_cast<GLTF::Node::TransformMatrix*>(node->transform)->matrix;
+    } else {
+      trsMatrix = static_cast<GLTF::Node::TransformTRS*>(node->transform)
+                      ->getTransformMatrix();
+      local = trsMatrix->matrix;
+    }
+  }
+  std::memcpy(matrix, local, sizeof(float) * 16);
+  delete trsMatrix;
+}
+
+/**
+ * Finds the nodes of the default scene that are static: neither they nor any
+ * of their ancestors are animated, and they are reached through only one
+ * parent, so they have a single world transform.
+ *
+ * @param keepNodes Receives the nodes that must be kept even without a mesh
+ * or children: animated nodes and the joints and skeletons of skins
+ * @return Each static node with its world transform, in traversal order
+ */
+std::vector<std::pair<GLTF::Node*, GLTF::Node::TransformMatrix>>
+getStaticNodes(GLTF::Asset* asset, std::set<GLTF::Node*>* keepNodes) {
+  for (GLTF::Skin* skin : asset->getAllSkins()) {
+    if (skin->skeleton != NULL) {
+      keepNodes->insert(skin->skeleton);
+    }
+    keepNodes->insert(skin->joints.begin(), skin->joints.end());
+  }
+  std::set<GLTF::Node*> animatedNodes;
+  for (GLTF::Animation* animation : asset->animations) {
+    for (GLTF::Animation::Channel* channel : animation->channels) {
+      if (channel->target != NULL && channel->target->node != NULL) {
+        animatedNodes.insert(channel->target->node);
+      }
+    }
+  }
+  keepNodes->insert(animatedNodes.begin(), animatedNodes.end());
+
+  std::vector<std::pair<GLTF::Node*, GLTF::Node::TransformMatrix>> nodes;
+  std::map<GLTF::Node*, int> parentCounts;
+  std::set<GLTF::Node*> dynamicNodes;
+  std::vector<std::pair<GLTF::Node*, GLTF::Node::TransformMatrix>> nodeStack;
+  for (GLTF::Node* node : asset->getDefaultScene()->nodes) {
+    nodeStack.push_back(std::make_pair(node, GLTF::Node::TransformMatrix()));
+  }
+  while (nodeStack.size() > 0) {
+    GLTF::Node* node = nodeStack.back().first;
+    GLTF::Node::TransformMatrix parentWorld = nodeStack.back().second;
+    nodeStack.pop_back();
+    parentCounts[node]++;
+    bool isStatic = animatedNodes.find(node) == animatedNodes.end() &&
+                    dynamicNodes.find(node) == dynamicNodes.end();
+    GLTF::Node::TransformMatrix world;
+    getLocalMatrix(node, world.matrix);
+    world.premultiply(&parentWorld);
+    for (GLTF::Node* child : node->children) {
+      nodeStack.push_back(std::make_pair(child, world));
+      if (!isStatic) {
+        dynamicNodes.insert(child);
+      }
+    }
+    if (isStatic) {
+      nodes.push_back(std::make_pair(node, world));
+    }
+  }
+  std::vector<std::pair<GLTF::Node*, GLTF::Node::TransformMatrix>>
+      staticNodes;
+  for (const auto& node : nodes) {
+    if (parentCounts[node.first] == 1 &&
+        dynamicNodes.find(node.first) == dynamicNodes.end()) {
+      staticNodes.push_back(node);
+    }
+  }
+  return staticNodes;
+}
+
+/**
+ * A primitive drawn by a static node, with the world transform of the node.
+ */
+struct BatchInstance {
+  GLTF::Node* node = NULL;
+  GLTF::Primitive* primitive = NULL;
+  float matrix[16];
+  size_t vertexCount = 0;
+};
+
+/**
+ * Gets the key of the primitives a primitive can be merged with: its mode and
+ * the type of each of its attributes. Only POINTS, LINES and TRIANGLES
+ * primitives with FLOAT attributes, no morph targets and no extensions can be
+ * merged.
+ *
+ * @return The key, or an empty string if the primitive cannot be merged
+ */
+std::string getBatchKey(GLTF::Primitive* primitive) {
+  auto positionPtr = primitive->attributes.find("POSITION");
+  if ((primitive->mode != GLTF::Primitive::Mode::POINTS &&
+       primitive->mode != GLTF::Primitive::Mode::LINES &&
+       primitive->mode != GLTF::Primitive::Mode::TRIANGLES) ||
+      primitive->targets.size() > 0 || primitive->extensions.size() > 0 ||
+      positionPtr == primitive->attributes.end() ||
+      positionPtr->second == NULL) {
+    return "";
+  }
+  GLTF::Accessor* indices = primitive->indices;
+  if (indices != NULL &&
+      (indices->bufferView == NULL ||
+       (indices->componentType != GLTF::Constants::WebGL::UNSIGNED_BYTE &&
+        indices->componentType != GLTF::Constants::WebGL::UNSIGNED_SHORT &&
+        indices->componentType != GLTF::Constants::WebGL::UNSIGNED_INT))) {
+    return "";
+  }
+  std::string key = std::to_string(primitive->mode);
+  for (const auto& attribute : primitive->attributes) {
+    GLTF::Accessor* accessor = attribute.second;
+    if (accessor == NULL || accessor->bufferView == NULL ||
+        accessor->componentType != GLTF::Constants::WebGL::FLOAT ||
+        accessor->count != positionPtr->second->count) {
+      return "";
+    }
+    key += " " + attribute.first + ":" + accessor->getTypeName();
+  }
+  return key;
+}
+
+/**
+ * Bakes a world transform into vertex attribute values. Positions are
+ * transformed as points, normals by the inverse transpose of the matrix and
+ * tangents as directions. A mirroring transform flips the bitangent, so the
+ * handedness of tangents is negated to keep it.
+ */
+void transformElements(const std::string& semantic, int numberOfComponents,
+                       const float* matrix, std::vector<float>* values) {
+  std::string baseSemantic = getBaseSemantic(semantic);
+  bool isPosition = baseSemantic == "POSITION";
+  bool isNormal = baseSemantic == "NORMAL";
+  bool isTangent = baseSemantic == "TANGENT";
+  if ((!isPosition && !isNormal && !isTangent) || numberOfComponents < 3) {
+    return;
+  }
+  // The inverse transpose of the upper 3x3, scaled by its determinant, has
+  // the cross products of the matrix columns as its columns
+  const float* c0 = matrix;
+  const float* c1 = matrix + 4;
+  const float* c2 = matrix + 8;
+  float normalMatrix[9] = {
+      c1[1] * c2[2] - c1[2] * c2[1], c1[2] * c2[0] - c1[0] * c2[2],
+      c1[0] * c2[1] - c1[1] * c2[0], c2[1] * c0[2] - c2[2] * c0[1],
+      c2[2] * c0[0] - c2[0] * c0[2], c2[0] * c0[1] - c2[1] * c0[0],
+      c0[1] * c1[2] - c0[2] * c1[1], c0[2] * c1[0] - c0[0] * c1[2],
+      c0[0] * c1[1] - c0[1] * c1[0]};
+  float determinant = c0[0] * normalMatrix[0] + c0[1] * normalMatrix[1] +
+                      c0[2] * normalMatrix[2];
+  for (size_t i = 0; i < values->size(); i += numberOfComponents) {
+    float* value = &(*values)[i];
+    float x = value[0];
+    float y = value[1];
+    float z = value[2];
+    if (isNormal) {
+      for (int k = 0; k < 3; k++) {
+        value[k] = normalMatrix[k] * x + normalMatrix[3 + k] * y +
+                   normalMatrix[6 + k] * z;
+        if (determinant < 0) {
+          value[k] = -value[k];
+        }
+      }
+    } else {
+      for (int k = 0; k < 3; k++) {
+        value[k] = matrix[k] * x + matrix[4 + k] * y + matrix[8 + k] * z;
+        if (isPosition) {
+          value[k] += matrix[12 + k];
+        }
+      }
+      if (isTangent && numberOfComponents > 3 && determinant < 0) {
+        value[3] = -value[3];
+      }
+    }
+    if (!isPosition) {
+      float length = sqrtf(value[0] * value[0] + value[1] * value[1] +
+                           value[2] * value[2]);
+      if (length > 0) {
+        for (int k = 0; k < 3; k++) {
+          value[k] /= length;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Merges a batch of primitive instances into one primitive, baking the world
+ * transform of each instance into its vertices. Triangles of instances with
+ * a mirroring transform are flipped to keep their winding.
+ */
+GLTF::Primitive* mergeBatch(const std::vector<BatchInstance*>& batch) {
+  GLTF::Primitive* source = batch[0]->primitive;
+  std::map<std::string, std::vector<float>> attributeValues;
+  std::vector<unsigned int> indices;
+  unsigned int vertexOffset = 0;
+  for (BatchInstance* instance : batch) {
+    GLTF::Primitive* primitive = instance->primitive;
+    for (const auto& attribute : primitive->attributes) {
+      GLTF::Accessor* accessor = attribute.second;
+      std::vector<float> values = readElements(accessor);
+      transformElements(attribute.first, accessor->getNumberOfComponents(),
+                        instance->matrix, &values);
+      std::vector<float>& mergedValues = attributeValues[attribute.first];
+      mergedValues.insert(mergedValues.end(), values.begin(), values.end());
+    }
+    std::vector<unsigned int> instanceIndices;
+    if (primitive->indices == NULL) {
+      for (size_t i = 0; i < instance->vertexCount; i++) {
+        instanceIndices.push_back(static_cast<unsigned int>(i));
+      }
+    } else {
+      readIndices(primitive->indices, &instanceIndices);
+    }
+    const float* m = instance->matrix;
+    float determinant = m[0] * (m[5] * m[10] - m[6] * m[9]) -
+                        m[4] * (m[1] * m[10] - m[2] * m[9]) +
+                        m[8] * (m[1] * m[6] - m[2] * m[5]);
+    if (determinant < 0 &&
+        primitive->mode == GLTF::Primitive::Mode::TRIANGLES) {
+      for (size_t i = 0; i + 2 < instanceIndices.size(); i += 3) {
+        std::swap(instanceIndices[i + 1], instanceIndices[i + 2]);
+      }
+    }
+    for (unsigned int index : instanceIndices) {
+      indices.push_back(index + vertexOffset);
+    }
+    vertexOffset += static_cast<unsigned int>(instance->vertexCount);
+  }
+
+  GLTF::Primitive* merged = new GLTF::Primitive();
+  merged->mode = source->mode;
+  merged->material = source->material;
+  for (const auto& attribute : source->attributes) {
+    GLTF::Accessor* accessor = attribute.second;
+    std::vector<float>& values = attributeValues[attribute.first];
+    merged->attributes[attribute.first] = new GLTF::Accessor(
+        accessor->type, GLTF::Constants::WebGL::FLOAT, std::move(values),
+        GLTF::Constants::WebGL::ARRAY_BUFFER);
+  }
+  merged->indices = createIndexAccessor(
+      vertexOffset < 65536 ? GLTF::Constants::WebGL::UNSIGNED_SHORT
+                           : GLTF::Constants::WebGL::UNSIGNED_INT,
+      indices);
+  return merged;
+}
+
+/**
+ * Removes the nodes under a node that were emptied of their mesh and have no
+ * children, along with the nodes that only held such nodes.
+ *
+ * @return `true` if the node itself should be removed
+ */
+bool pruneEmptiedNodes(GLTF::Node* node,
+                       const std::set<GLTF::Node*>& emptiedNodes,
+                       const std::set<GLTF::Node*>& keepNodes) {
+  bool removedChildren = false;
+  for (size_t i = 0; i < node->children.size(); i++) {
+    if (pruneEmptiedNodes(node->children[i], emptiedNodes, keepNodes)) {
+      node->children.erase(node->children.begin() + i);
+      i--;
+      removedChildren = true;
+    }
+  }
+  if (node->mesh != NULL || node->children.size() > 0 ||
+      keepNodes.find(node) != keepNodes.end()) {
+    return false;
+  }
+  if (emptiedNodes.find(node) != emptiedNodes.end()) {
+    return true;
+  }
+  return removedChildren && node->camera == NULL && node->light == NULL &&
+         node->skin == NULL && node->extensions.size() == 0;
+}
+
+/**
+ * Removes the nodes of a scene that were emptied of their mesh, as with
+ * `pruneEmptiedNodes` for each root node.
+ */
+void pruneEmptiedNodes(GLTF::Scene* scene,
+                       const std::set<GLTF::Node*>& emptiedNodes,
+                       const std::set<GLTF::Node*>& keepNodes) {
+  for (size_t i = 0; i < scene->nodes.size(); i++) {
+    if (pruneEmptiedNodes(scene->nodes[i], emptiedNodes, keepNodes)) {
+      scene->nodes.erase(scene->nodes.begin() + i);
+      i--;
+    }
+  }
+}
+
+/**
+ * Static batching: bakes the world transforms of primitives drawn by static
+ * nodes into their vertices, and merges primitives with the same material,
+ * mode and attributes into combined primitives of at most `maxVertexCount`
+ * vertices, drawn by a new root node. Nodes that are left without a mesh or
+ * children are removed.
+ *
+ * A node is static if neither it nor any of its ancestors is animated, and it
+ * has no skin, camera, light or extensions. Meshes with morph targets are not
+ * merged, and nor are nodes reached through more than one parent, since they
+ * have more than one world transform.
+ *
+ * @param maxVertexCount The most vertices a merged primitive may have
+ * @param drawCountBefore Receives the number of primitives drawn before
+ * @param drawCountAfter Receives the number of primitives drawn after
+ */
+void GLTF::Asset::mergeStaticPrimitives(size_t maxVertexCount,
+                                        size_t* drawCountBefore,
+                                        size_t* drawCountAfter) {
+  std::set<GLTF::Node*> keepNodes;
+  std::vector<std::pair<GLTF::Node*, GLTF::Node::TransformMatrix>>
+      staticNodes = getStaticNodes(this, &keepNodes);
+  *drawCountBefore = 0;
+  for (GLTF::Node* node : getAllNodes()) {
+    if (node->mesh != NULL) {
+      *drawCountBefore += node->mesh->primitives.size();
+    }
+  }
+
+  std::vector<std::unique_ptr<BatchInstance>> instances;
+  for (const auto& staticNode : staticNodes) {
+    GLTF::Node* node = staticNode.first;
+    if (node->mesh == NULL || node->skin != NULL || node->camera != NULL ||
+        node->light != NULL || node->extensions.size() > 0 ||
+        node->mesh->weights.size() > 0) {
+      continue;
+    }
+    for (GLTF::Primitive* primitive : node->mesh->primitives) {
+      BatchInstance* instance = new BatchInstance();
+      instance->node = node;
+      instance->primitive = primitive;
+      std::memcpy(instance->matrix, staticNode.second.matrix,
+                  sizeof(float) * 16);
+      auto positionPtr = primitive->attributes.find("POSITION");
+      if (positionPtr != primitive->attributes.end() &&
+          positionPtr->second != NULL) {
+        instance->vertexCount = positionPtr->second->count;
+      }
+      instances.push_back(std::unique_ptr<BatchInstance>(instance));
+    }
+  }
+
+  // Group the instances by material and key, in the order they were found
+  std::vector<std::pair<GLTF::Material*, std::string>> groupKeys;
+  std::map<std::pair<GLTF::Material*, std::string>,
+           std::vector<BatchInstance*>>
+      groups;
+  for (const auto& instance : instances) {
+    std::string key = getBatchKey(instance->primitive);
+    if (key.length() == 0) {
+      continue;
+    }
+    auto groupKey = std::make_pair(instance->primitive->material, key);
+    if (groups.find(groupKey) == groups.end()) {
+      groupKeys.push_back(groupKey);
+    }
+    groups[groupKey].push_back(instance.get());
+  }
+
+  GLTF::Mesh* batchMesh = new GLTF::Mesh();
+  std::map<GLTF::Node*, std::set<GLTF::Primitive*>> mergedPrimitives;
+  size_t mergedCount = 0;
+  for (const auto& groupKey : groupKeys) {
+    const std::vector<BatchInstance*>& group = groups[groupKey];
+    std::vector<std::vector<BatchInstance*>> batches(1);
+    size_t batchVertexCount = 0;
+    for (BatchInstance* instance : group) {
+      if (batches.back().size() > 0 &&
+          batchVertexCount + instance->vertexCount > maxVertexCount) {
+        batches.push_back(std::vector<BatchInstance*>());
+        batchVertexCount = 0;
+      }
+      batches.back().push_back(instance);
+      batchVertexCount += instance->vertexCount;
+    }
+    for (const std::vector<BatchInstance*>& batch : batches) {
+      // An instance over the vertex limit, or alone, is left as it is
+      if (batch.size() < 2) {
+        continue;
+      }
+      batchMesh->primitives.push_back(mergeBatch(batch));
+      for (BatchInstance* instance : batch) {
+        mergedPrimitives[instance->node].insert(instance->primitive);
+      }
+      mergedCount += batch.size();
+    }
+  }
+  *drawCountAfter =
+      *drawCountBefore - mergedCount + batchMesh->primitives.size();
+  if (batchMesh->primitives.size() == 0) {
+    delete batchMesh;
+    return;
+  }
+
+  // Keep the primitives of each node that were not merged
+  std::set<GLTF::Node*> emptiedNodes;
+  for (const auto& entry : mergedPrimitives) {
+    GLTF::Node* node = entry.first;
+    GLTF::Mesh* remainingMesh = new GLTF::Mesh();
+    remainingMesh->name = node->mesh->name;
+    for (GLTF::Primitive* primitive : node->mesh->primitives) {
+      if (entry.second.find(primitive) == entry.second.end()) {
+        remainingMesh->primitives.push_back(primitive);
+      }
+    }
+    if (remainingMesh->primitives.size() == 0) {
+      delete remainingMesh;
+      node->mesh = NULL;
+      emptiedNodes.insert(node);
+    } else {
+      node->mesh = remainingMesh;
+    }
+  }
+  GLTF::Scene* defaultScene = getDefaultScene();
+  pruneEmptiedNodes(defaultScene, emptiedNodes, keepNodes);
+
+  GLTF::Node* batchNode = new GLTF::Node();
+  batchNode->mesh = batchMesh;
+  defaultScene->nodes.push_back(batchNode);
+}
+
+/**
+ * Decomposes an affine matrix into translation, rotation and scale. A
+ * mirroring matrix gets a negative x scale.
+ *
+ * @return `false` if the matrix has shear or a zero scale, so it cannot be
+ * written as translation, rotation and scale
+ */
+bool decomposeMatrix(const float* matrix, GLTF::Node::TransformTRS* trs) {
+  float scale[3];
+  for (int i = 0; i < 3; i++) {
+    const float* column = matrix + i * 4;
+    scale[i] = sqrtf(column[0] * column[0] + column[1] * column[1] +
+                     column[2] * column[2]);
+    if (scale[i] == 0) {
+      return false;
+    }
+  }
+  float determinant =
+      matrix[0] * (matrix[5] * matrix[10] - matrix[6] * matrix[9]) -
+      matrix[4] * (matrix[1] * matrix[10] - matrix[2] * matrix[9]) +
+      matrix[8] * (matrix[1] * matrix[6] - matrix[2] * matrix[5]);
+  if (determinant < 0) {
+    scale[0] = -scale[0];
+  }
+  GLTF::Node::TransformMatrix rotation;
+  for (int i = 0; i < 3; i++) {
+    for (int k = 0; k < 3; k++) {
+      rotation.matrix[i * 4 + k] = matrix[i * 4 + k] / scale[i];
+    }
+  }
+  rotation.getTransformTRS(trs);
+  std::memcpy(trs->translation, matrix + 12, sizeof(float) * 3);
+  std::memcpy(trs->scale, scale, sizeof(float) * 3);
+
+  // Shear is lost in the decomposition, so check the matrix is rebuilt
+  GLTF::Node::TransformMatrix* recomposed = trs->getTransformMatrix();
+  float magnitude = 1;
+  for (int i = 0; i < 16; i++) {
+    magnitude = std::max(magnitude, std::abs(matrix[i]));
+  }
+  bool equal = true;
+  for (int i = 0; i < 16; i++) {
+    equal = equal &&
+            std::abs(recomposed->matrix[i] - matrix[i]) <= 1e-4f * magnitude;
+  }
+  delete recomposed;
+  return equal;
+}
+
+/**
+ * Replaces static leaf nodes that draw the same mesh with a single root node
+ * using the EXT_mesh_gpu_instancing extension, with the world transform of
+ * each node as the `TRANSLATION`, `ROTATION` and `SCALE` of an instance. This
+ * collapses the subtrees cloned for repeated `<instance_node>` elements.
+ * Emptied nodes are removed.
+ *
+ * Only nodes with a mesh and no children, skin, camera, light or extensions
+ * are instanced, and only if their world transform has no shear. Instanced
+ * meshes should share one `GLTF::Mesh`, e.g. with `deduplicateMeshes`.
+ *
+ * @param nodeCountBefore Receives the number of nodes before
+ * @param nodeCountAfter Receives the number of nodes after
+ */
+void GLTF::Asset::instanceMeshes(size_t* nodeCountBefore,
+                                 size_t* nodeCountAfter) {
+  *nodeCountBefore = getAllNodes().size();
+  std::set<GLTF::Node*> keepNodes;
+  std::vector<std::pair<GLTF::Node*, GLTF::Node::TransformMatrix>>
+      staticNodes = getStaticNodes(this, &keepNodes);
+
+  std::vector<GLTF::Mesh*> meshes;
+  std::map<GLTF::Mesh*, std::vector<std::pair<GLTF::Node*, float*>>>
+      meshInstances;
+  for (auto& staticNode : staticNodes) {
+    GLTF::Node* node = staticNode.first;
+    if (node->mesh == NULL || node->children.size() > 0 ||
+        node->skin != NULL || node->camera != NULL || node->light != NULL ||
+        node->extensions.size() > 0 ||
+        keepNodes.find(node) != keepNodes.end()) {
+      continue;
+    }
+    if (meshInstances.find(node->mesh) == meshInstances.end()) {
+      meshes.push_back(node->mesh);
+    }
+    meshInstances[node->mesh].push_back(
+        std::make_pair(node, staticNode.second.matrix));
+  }
+
+  std::set<GLTF::Node*> emptiedNodes;
+  std::vector<GLTF::Node*> instancingNodes;
+  for (GLTF::Mesh* mesh : meshes) {
+    std::vector<GLTF::Node*> nodes;
+    std::vector<float> translations;
+    std::vector<float> rotations;
+    std::vector<float> scales;
+    for (const auto& instance : meshInstances[mesh]) {
+      GLTF::Node::TransformTRS trs;
+      if (!decomposeMatrix(instance.second, &trs)) {
+        continue;
+      }
+      nodes.push_back(instance.first);
+      translations.insert(translations.end(), trs.translation,
+                          trs.translation + 3);
+      rotations.insert(rotations.end(), trs.rotation, trs.rotation + 4);
+      scales.insert(scales.end(), trs.scale, trs.scale + 3);
+    }
+    if (nodes.size() < 2) {
+      continue;
+    }
+
+    GLTF::InstancingExtension* instancingExtension =
+        new GLTF::InstancingExtension();
+    int count = static_cast<int>(nodes.size());
+    instancingExtension->attributes["TRANSLATION"] = new GLTF::Accessor(
+        GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+        std::move(translations), (GLTF::Constants::WebGL)-1);
+    bool identityRotation = true;
+    bool identityScale = true;
+    for (int i = 0; i < count; i++) {
+      identityRotation = identityRotation && rotations[i * 4] == 0 &&
+                         rotations[i * 4 + 1] == 0 &&
+                         rotations[i * 4 + 2] == 0 &&
+                         std::abs(rotations[i * 4 + 3]) == 1;
+      identityScale = identityScale && scales[i * 3] == 1 &&
+                      scales[i * 3 + 1] == 1 && scales[i * 3 + 2] == 1;
+    }
+    if (!identityRotation) {
+      instancingExtension->attributes["ROTATION"] = new GLTF::Accessor(
+          GLTF::Accessor::Type::VEC4, GLTF::Constants::WebGL::FLOAT,
+          std::move(rotations), (GLTF::Constants::WebGL)-1);
+    }
+    if (!identityScale) {
+      instancingExtension->attributes["SCALE"] = new GLTF::Accessor(
+          GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+          std::move(scales), (GLTF::Constants::WebGL)-1);
+    }
+
+    GLTF::Node* instancingNode = new GLTF::Node();
+    instancingNode->mesh = mesh;
+    instancingNode->extensions["EXT_mesh_gpu_instancing"] =
+        instancingExtension;
+    instancingNodes.push_back(instancingNode);
+    for (GLTF::Node* node : nodes) {
+      node->mesh = NULL;
+      emptiedNodes.insert(node);
+    }
+  }
+
+  if (instancingNodes.size() > 0) {
+    GLTF::Scene* defaultScene = getDefaultScene();
+    pruneEmptiedNodes(defaultScene, emptiedNodes, keepNodes);
+    defaultScene->nodes.insert(defaultScene->nodes.end(),
+                               instancingNodes.begin(), instancingNodes.end());
+    requireExtension("EXT_mesh_gpu_instancing");
+  }
+  *nodeCountAfter = getAllNodes().size();
+}
+
+/**
+ * Quantizes the values of a FLOAT vertex attribute in place into a normalized
+ * integer component type, using `bits` bits of precision:
+ *
+ *   normalized = (value - offset[k]) / scale
+ *
+ * Elements are padded to 4 bytes as glTF requires for vertex attributes.
+ */
+void quantizeAccessor(GLTF::Accessor* accessor,
+                      GLTF::Constants::WebGL componentType, int bits,
+                      const float* offset, float scale) {
+  int numberOfComponents = accessor->getNumberOfComponents();
+  std::vector<float> values = readElements(accessor);
+  bool isSigned = componentType == GLTF::Constants::WebGL::BYTE ||
+                  componentType == GLTF::Constants::WebGL::SHORT;
+  int storageBits =
+      GLTF::Accessor::getComponentByteLength(componentType) * 8 - isSigned;
+  bits = std::max(1, std::min(bits, storageBits + isSigned)) - isSigned;
+  float levels = static_cast<float>((1 << bits) - 1);
+  float storageLevels = static_cast<float>((1 << storageBits) - 1);
+  float minimum = isSigned ? -1.0f : 0.0f;
+  for (float& value : values) {
+    size_t k = &value - values.data();
+    float normalized = (value - offset[k % numberOfComponents]) / scale;
+    normalized = std::max(minimum, std::min(1.0f, normalized));
+    value =
+        std::round(std::round(normalized * levels) / levels * storageLevels);
+  }
+
+  accessor->componentType = componentType;
+  accessor->normalized = true;
+  accessor->bufferView->byteStride = getInterleavedByteLength(accessor);
+  accessor->bufferView->byteLength =
+      static_cast<size_t>(accessor->bufferView->byteStride) * accessor->count;
+  accessor->writeComponents(values.data());
+  if (accessor->min != NULL) {
+    accessor->computeMinMax();
+  }
+}
+
+/**
+ * Checks that every component of an accessor is within [minimum, maximum].
+ */
+bool isWithinRange(GLTF::Accessor* accessor, float minimum, float maximum) {
+  for (float value : readElements(accessor)) {
+    if (!(value >= minimum && value <= maximum)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Stores vertex attributes in smaller component types using the
+ * KHR_mesh_quantization extension. POSITION becomes a normalized SHORT
+ * relative to the bounds of its mesh, and a child node is added under each
+ * node using the mesh to move it back into place. NORMAL and TANGENT become
+ * normalized BYTE, and TEXCOORD and COLOR within [0, 1] become normalized
+ * UNSIGNED_SHORT and UNSIGNED_BYTE.
+ *
+ * Positions of skinned, morphed or GPU instanced meshes stay FLOAT, since a
+ * node transform cannot dequantize them, as do attributes compressed with
+ * Draco or sharing a bufferView with other accessors.
+ *
+ * @param options Provides the quantization bits for each attribute
+ */
+void GLTF::Asset::quantizeAttributes(GLTF::Options* options) {
+  if (options->version == "1.0") {
+    return;
+  }
+  std::vector<GLTF::Node*> nodes = getAllNodes();
+  std::vector<GLTF::Mesh*> meshes = getAllMeshes();
+  std::set<GLTF::Mesh*> deformedMeshes;
+  for (GLTF::Node* node : nodes) {
+    if (node->skin != NULL ||
+        node->extensions.find("EXT_mesh_gpu_instancing") !=
+            node->extensions.end()) {
+      deformedMeshes.insert(node->mesh);
+    }
+  }
+
+  // Meshes sharing position accessors, like cloned meshes, are dequantized
+  // with the same transform, so they are grouped together
+  std::vector<size_t> meshGroups(meshes.size());
+  std::map<GLTF::Accessor*, size_t> positionMeshes;
+  std::function<size_t(size_t)> findGroup = [&](size_t mesh) {
+    while (meshGroups[mesh] != mesh) {
+      mesh = meshGroups[mesh] = meshGroups[meshGroups[mesh]];
+    }
+    return mesh;
+  };
+  std::map<GLTF::BufferView*, int> bufferViewAccessorCounts;
+  for (GLTF::Accessor* accessor : getAllAccessors()) {
+    bufferViewAccessorCounts[accessor->bufferView]++;
+  }
+  for (size_t i = 0; i < meshes.size(); i++) {
+    meshGroups[i] = i;
+    for (GLTF::Primitive* primitive : meshes[i]->primitives) {
+      if (primitive->targets.size() > 0) {
+        deformedMeshes.insert(meshes[i]);
+      }
+      auto positionPtr = primitive->attributes.find("POSITION");
+      if (positionPtr == primitive->attributes.end()) {
+        continue;
+      }
+      auto meshPtr = positionMeshes.find(positionPtr->second);
+      if (meshPtr == positionMeshes.end()) {
+        positionMeshes[positionPtr->second] = i;
+      } else {
+        meshGroups[findGroup(i)] = findGroup(meshPtr->second);
+      }
+    }
+  }
+
+  std::map<size_t, std::vector<GLTF::Accessor*>> groupPositions;
+  std::set<size_t> skippedGroups;
+  for (size_t i = 0; i < meshes.size(); i++) {
+    size_t group = findGroup(i);
+    if (deformedMeshes.find(meshes[i]) != deformedMeshes.end()) {
+      skippedGroups.insert(group);
+    }
+    for (GLTF::Primitive* primitive : meshes[i]->primitives) {
+      auto positionPtr = primitive->attributes.find("POSITION");
+      if (positionPtr == primitive->attributes.end()) {
+        continue;
+      }
+      GLTF::Accessor* position = positionPtr->second;
+      if (primitive->extensions.find("KHR_draco_mesh_compression") !=
+              primitive->extensions.end() ||
+          position->bufferView == NULL ||
+          position->componentType != GLTF::Constants::WebGL::FLOAT ||
+          position->getNumberOfComponents() != 3 ||
+          bufferViewAccessorCounts[position->bufferView] > 1) {
+        skippedGroups.insert(group);
+      }
+      std::vector<GLTF::Accessor*>& positions = groupPositions[group];
+      if (std::find(positions.begin(), positions.end(), position) ==
+          positions.end()) {
+        positions.push_back(position);
+      }
+    }
+  }
+
+  bool quantized = false;
+  std::map<GLTF::Mesh*, GLTF::Node::TransformTRS> dequantizations;
+  for (const auto& groupEntry : groupPositions) {
+    if (skippedGroups.find(groupEntry.first) != skippedGroups.end()) {
+      continue;
+    }
+    float minimum[3];
+    float maximum[3];
+    bool empty = true;
+    for (GLTF::Accessor* position : groupEntry.second) {
+      position->computeMinMax();
+      for (size_t k = 0; k < 3 && position->count > 0; k++) {
+        minimum[k] = empty ? position->min[k]
+                           : std::min(minimum[k], position->min[k]);
+        maximum[k] = empty ? position->max[k]
+                           : std::max(maximum[k], position->max[k]);
+      }
+      empty = empty && position->count == 0;
+    }
+    if (empty) {
+      continue;
+    }
+    GLTF::Node::TransformTRS dequantization;
+    float scale = 0;
+    for (size_t k = 0; k < 3; k++) {
+      dequantization.translation[k] = (minimum[k] + maximum[k]) / 2;
+      dequantization.rotation[k] = 0;
+      scale = std::max(scale, (maximum[k] - minimum[k]) / 2);
+    }
+    dequantization.rotation[3] = 1;
+    // A uniform scale keeps normals correct
+    scale = scale > 0 ? scale : 1;
+    for (size_t k = 0; k < 3; k++) {
+      dequantization.scale[k] = scale;
+    }
+    for (GLTF::Accessor* position : groupEntry.second) {
+      quantizeAccessor(position, GLTF::Constants::WebGL::SHORT,
+                       options->positionQuantizationBits,
+                       dequantization.translation, scale);
+    }
+    for (size_t i = 0; i < meshes.size(); i++) {
+      if (findGroup(i) == groupEntry.first) {
+        dequantizations[meshes[i]] = dequantization;
+      }
+    }
+    quantized = true;
+  }
+  for (GLTF::Node* node : nodes) {
+    auto dequantizationPtr = dequantizations.find(node->mesh);
+    if (node->mesh != NULL && dequantizationPtr != dequantizations.end()) {
+      GLTF::Node* meshNode = new GLTF::Node();
+      meshNode->transform = dequantizationPtr->second.clone();
+      meshNode->mesh = node->mesh;
+      node->mesh = NULL;
+      node->children.push_back(meshNode);
+    }
+  }
+
+  const float zero[4] = {0, 0, 0, 0};
+  std::set<GLTF::Accessor*> quantizedAccessors;
+  for (GLTF::Primitive* primitive : getAllPrimitives()) {
+    if (primitive->extensions.find("KHR_draco_mesh_compression") !=
+        primitive->extensions.end()) {
+      continue;
+    }
+    for (const auto& attribute : primitive->attributes) {
+      GLTF::Accessor* accessor = attribute.second;
+      if (accessor == NULL || accessor->bufferView == NULL ||
+          accessor->componentType != GLTF::Constants::WebGL::FLOAT ||
+          bufferViewAccessorCounts[accessor->bufferView] > 1 ||
+          quantizedAccessors.find(accessor) != quantizedAccessors.end()) {
+        continue;
+      }
+      std::string semantic = getBaseSemantic(attribute.first);
+      if (semantic == "NORMAL" || semantic == "TANGENT") {
+        quantizeAccessor(accessor, GLTF::Constants::WebGL::BYTE,
+                         options->normalQuantizationBits, zero, 1);
+      } else if (semantic == "TEXCOORD" && isWithinRange(accessor, 0, 1)) {
+        quantizeAccessor(accessor, GLTF::Constants::WebGL::UNSIGNED_SHORT,
+                         options->texcoordQuantizationBits, zero, 1);
+      } else if (semantic == "COLOR" && isWithinRange(accessor, 0, 1)) {
+        quantizeAccessor(accessor, GLTF::Constants::WebGL::UNSIGNED_BYTE,
+                         options->colorQuantizationBits, zero, 1);
+      } else {
+        continue;
+      }
+      quantizedAccessors.insert(accessor);
+      quantized = true;
+    }
+  }
+  if (quantized) {
+    requireExtension("KHR_mesh_quantization");
+  }
+}
+
+/**
+ * Stores the morph target attributes in which fewer than `threshold` of the
+ * elements are not zero as sparse accessors, holding only the indices and
+ * values of those elements. Targets without any non-zero elements get no
+ * data at all, since accessors without a bufferView are zero. Attributes
+ * compressed with Draco or shared with primitive attributes are left alone.
+ *
+ * @param threshold The largest fraction of non-zero elements to store sparse
+ */
+void GLTF::Asset::sparsifyMorphTargets(float threshold) {
+  std::set<GLTF::Accessor*> attributeAccessors;
+  std::vector<GLTF::Accessor*> targetAccessors;
+  for (GLTF::Primitive* primitive : getAllPrimitives()) {
+    for (const auto& attribute : primitive->attributes) {
+      attributeAccessors.insert(attribute.second);
+    }
+    for (GLTF::Primitive::Target* target : primitive->targets) {
+      for (const auto& attribute : target->attributes) {
+        targetAccessors.push_back(attribute.second);
+      }
+    }
+  }
+
+  std::set<GLTF::Accessor*> sparseAccessors;
+  for (GLTF::Accessor* accessor : targetAccessors) {
+    if (accessor == NULL || accessor->bufferView == NULL ||
+        accessor->sparseIndices != NULL || accessor->count == 0 ||
+        attributeAccessors.find(accessor) != attributeAccessors.end() ||
+        !sparseAccessors.insert(accessor).second) {
+      continue;
+    }
+    size_t elementSize =
+        accessor->getNumberOfComponents() * accessor->getComponentByteLength();
+    size_t byteStride = accessor->getByteStride();
+    const unsigned char* data = accessor->bufferView->buffer->data +
+                                accessor->bufferView->byteOffset +
+                                accessor->byteOffset;
+    std::vector<unsigned int> indices;
+    std::vector<unsigned char> values;
+    for (size_t i = 0; i < accessor->count; i++) {
+      const unsigned char* element = data + i * byteStride;
+      bool isZero = true;
+      for (size_t k = 0; k < elementSize && isZero; k++) {
+        isZero = element[k] == 0;
+      }
+      if (!isZero) {
+        indices.push_back(i);
+        values.insert(values.end(), element, element + elementSize);
+      }
+    }
+    if (indices.size() >= threshold * accessor->count) {
+      continue;
+    }
+
+    accessor->bufferView = NULL;
+    accessor->byteOffset = 0;
+    if (indices.size() == 0) {
+      continue;
+    }
+    accessor->sparseIndices = createIndexAccessor(
+        accessor->count <= 65536 ? GLTF::Constants::WebGL::UNSIGNED_SHORT
+                                 : GLTF::Constants::WebGL::UNSIGNED_INT,
+        indices);
+    accessor->sparseIndices->bufferView->target = (GLTF::Constants::WebGL)-1;
+    accessor->sparseValues =
+        new GLTF::Accessor(accessor->type, accessor->componentType,
+                           std::move(values), (GLTF::Constants::WebGL)-1);
+  }
+}
+
+/**
+ * Copies elements `[begin, end)` of the visited accessor to `target`, laid
+ * out at `byteStride`. Matching layouts are copied with a single memcpy.
+ */
+struct PackVisitor {
+  unsigned char* target;
+  size_t byteStride;
+  size_t begin;
+  size_t end;
+
+  template <typename T, int N>
+  void operator()(const GLTF::AccessorView<T, N>& view) {
+    view.slice(begin, end)
+        .copyTo(GLTF::AccessorView<T, N>(target + begin * byteStride,
+                                         end - begin, byteStride));
+  }
+};
+
+/**
+ * A range of data copied into the packed buffer: either elements of an
+ * accessor, or the bytes of a bufferView when `accessor` is `NULL`. Both are
+ * read from `source`.
+ */
+struct PackTask {
+  GLTF::Accessor* accessor;
+  GLTF::Buffer* source;
+  unsigned char* target;
+  size_t byteStride;
+  size_t begin;
+  size_t end;
+};
+
+/** The bytes copied by each pack task, so large copies are spread out. */
+const size_t PACK_TASK_BYTE_LENGTH = 1 << 22;
+
+void addPackTasks(GLTF::Accessor* accessor, GLTF::Buffer* source,
+                  unsigned char* target, size_t byteStride, size_t count,
+                  std::vector<PackTask>* tasks) {
+  size_t taskCount =
+      std::max(static_cast<size_t>(1), PACK_TASK_BYTE_LENGTH / byteStride);
+  for (size_t begin = 0; begin < count; begin += taskCount) {
+    size_t end = std::min(count, begin + taskCount);
+    PackTask task = {accessor, source, target, byteStride, begin, end};
+    tasks->push_back(task);
+  }
+}
+
+/**
+ * An accessor placed in a packed bufferView.
+ */
+struct PackedAccessor {
+  GLTF::Accessor* accessor;
+  GLTF::BufferView* bufferView;
+  size_t byteOffset;
+};
+
+/**
+ * Assigns the accessors and Draco bufferViews used by each mesh, or by each
+ * node, to a part numbered from 1 for the `mesh` and `node` buffer splits.
+ * Data shared between meshes or nodes goes with the first to use it, and data
+ * used by none, like animations, is left for part 0.
+ */
+void getBufferPartitions(
+    GLTF::Asset* asset, const std::string& bufferSplit,
+    std::map<GLTF::Accessor*, int>* accessorPartitions,
+    std::map<GLTF::BufferView*, int>* bufferViewPartitions) {
+  auto addAccessor = [accessorPartitions](GLTF::Accessor* accessor,
+                                          int partition) {
+    for (GLTF::Accessor* partAccessor :
+         {accessor, accessor->sparseIndices, accessor->sparseValues}) {
+      if (partAccessor != NULL) {
+        accessorPartitions->insert(std::make_pair(partAccessor, partition));
+      }
+    }
+  };
+  auto addMesh = [asset, bufferViewPartitions, &addAccessor](
+                     GLTF::Mesh* mesh, int partition) {
+    for (GLTF::Primitive* primitive : mesh->primitives) {
+      for (GLTF::Accessor* accessor :
+           asset->getAllPrimitiveAccessors(primitive)) {
+        addAccessor(accessor, partition);
+      }
+      if (primitive->indices != NULL) {
+        addAccessor(primitive->indices, partition);
+      }
+      auto dracoExtensionPtr =
+          primitive->extensions.find("KHR_draco_mesh_compression");
+      if (dracoExtensionPtr != primitive->extensions.end()) {
+        bufferViewPartitions->insert(std::make_pair(
+            ((GLTF::DracoExtension*)dracoExtensionPtr->second)->bufferView,
+            partition));
+      }
+    }
+  };
+
+  int partition = 1;
+  if (bufferSplit == "mesh") {
+    for (GLTF::Mesh* mesh : asset->getAllMeshes()) {
+      addMesh(mesh, partition++);
+    }
+  } else if (bufferSplit == "node") {
+    for (GLTF::Node* node : asset->getAllNodes()) {
+      if (node->mesh != NULL) {
+        addMesh(node->mesh, partition);
+      }
+      if (node->skin != NULL && node->skin->inverseBindMatrices != NULL) {
+        addAccessor(node->skin->inverseBindMatrices, partition);
+      }
+      auto instancingExtensionPtr =
+          node->extensions.find("EXT_mesh_gpu_instancing");
+      if (instancingExtensionPtr != node->extensions.end()) {
+        for (const auto& attribute :
+             static_cast<GLTF::InstancingExtension*>(
+                 instancingExtensionPtr->second)
+                 ->attributes) {
+          addAccessor(attribute.second, partition);
+        }
+      }
+      partition++;
+    }
+  }
+}
+
+/**
+ * Collects the accessors glTF requires `min` and `max` for: POSITION
+ * attributes, including morph target displacements, and animation sampler
+ * inputs.
+ */
+std::set<GLTF::Accessor*> getBoundedAccessors(GLTF::Asset* asset) {
+  std::set<GLTF::Accessor*> accessors;
+  for (GLTF::Primitive* primitive : asset->getAllPrimitives()) {
+    auto findPosition = primitive->attributes.find("POSITION");
+    if (findPosition != primitive->attributes.end()) {
+      accessors.insert(findPosition->second);
+    }
+    for (GLTF::Primitive::Target* target : primitive->targets) {
+      findPosition = target->attributes.find("POSITION");
+      if (findPosition != target->attributes.end()) {
+        accessors.insert(findPosition->second);
+      }
+    }
+  }
+  for (GLTF::Animation* animation : asset->animations) {
+    for (GLTF::Animation::Channel* channel : animation->channels) {
+      accessors.insert(channel->sampler->input);
+    }
+  }
+  return accessors;
+}
+
+/**
+ * Packs the data of every accessor into a buffer, with a bufferView for each
+ * target and byte stride. With the `interleave` option, the vertex attributes
+ * of each primitive get their own interleaved bufferView instead.
+ *
+ * The `bufferSplit` option packs into several buffers instead: one for each
+ * mesh or node, or parts of at most `bufferSplitByteLength` bytes. Every
+ * buffer but the first is marked `external`.
+ *
+ * The layout of the buffers is worked out first, then the data is copied
+ * straight into place, across `threads` threads if there are several. The
+ * data of the old buffers is freed as soon as it has been copied.
+ * Accessor bounds that will be written are computed beforehand, while the
+ * data can still be read.
+ *
+ * @param buffers If not `NULL`, receives every buffer, in order
+ * @return The first buffer
+ */
+GLTF::Buffer* GLTF::Asset::packAccessors(GLTF::Options* options,
+                                         std::vector<GLTF::Buffer*>* buffers) {
+  // Bounds are computed while the data is still readable, since
+  // compressBufferViews leaves packed bufferViews without data
+  std::set<GLTF::Accessor*> boundedAccessors = getBoundedAccessors(this);
+  for (GLTF::Accessor* accessor : getAllAccessors()) {
+    if (accessor->min == NULL &&
+        (options->accessorMinMax ||
+         boundedAccessors.find(accessor) != boundedAccessors.end())) {
+      accessor->computeMinMax();
+    }
+  }
+
+  std::vector<std::vector<GLTF::Accessor*>> interleavedAccessors;
+  std::set<GLTF::Accessor*> uniqueInterleavedAccessors;
+  if (options->interleave) {
+    interleavedAccessors = getInterleavedAccessors(this);
+    for (const std::vector<GLTF::Accessor*>& accessors : interleavedAccessors) {
+      uniqueInterleavedAccessors.insert(accessors.begin(), accessors.end());
+    }
+  }
+
+  std::map<GLTF::Accessor*, int> accessorPartitions;
+  std::map<GLTF::BufferView*, int> bufferViewPartitions;
+  getBufferPartitions(this, options->bufferSplit, &accessorPartitions,
+                      &bufferViewPartitions);
+  auto getPartition = [&accessorPartitions](GLTF::Accessor* accessor) {
+    auto partitionPtr = accessorPartitions.find(accessor);
+    return partitionPtr == accessorPartitions.end() ? 0 : partitionPtr->second;
+  };
+
+  auto existingBufferViews = getAllBufferViews();
+  auto existingBuffers = getAllBuffers();
+  std::map<int, std::map<GLTF::Constants::WebGL,
+                         std::map<int, std::vector<GLTF::Accessor*>>>>
+      accessorGroups;
+  for (GLTF::Accessor* accessor : getAllAccessors()) {
+    // In glTF 2.0, bufferView is not required in accessor.
+    if (accessor->bufferView == NULL ||
+        uniqueInterleavedAccessors.find(accessor) !=
+            uniqueInterleavedAccessors.end()) {
+      continue;
+    }
+    accessorGroups[getPartition(accessor)][accessor->bufferView->target]
+                  [accessor->getByteStride()]
+                      .push_back(accessor);
+  }
+
+  // Go through primitives and look for primitives that use Draco extension.
+  // If extension is not enabled, the vector will be empty.
+  std::vector<GLTF::BufferView*> compressedBufferViews =
+      getAllCompressedBufferView();
+
+  // Lay out a bufferView for each part, target and byte stride, padding
+  // accessors to their component size
+  std::map<int, std::map<int, std::vector<GLTF::BufferView*>,
+                         std::greater<int>>>
+      bufferViews;
+  std::vector<PackedAccessor> packedAccessors;
+  for (const auto& partitionGroup : accessorGroups) {
+    int partition = partitionGroup.first;
+    for (const auto& targetGroup : partitionGroup.second) {
+      GLTF::Constants::WebGL target = targetGroup.first;
+      for (const auto& byteStrideGroup : targetGroup.second) {
+        int byteStride = byteStrideGroup.first;
+        GLTF::BufferView* bufferView = new GLTF::BufferView(0, 0, NULL);
+        bufferView->target = target;
+        // Padded vertex attributes are written at the stride they are read
+        // with
+        if (target == GLTF::Constants::WebGL::ARRAY_BUFFER) {
+          bufferView->byteStride = byteStride;
+        }
+        size_t byteLength = 0;
+        for (GLTF::Accessor* accessor : byteStrideGroup.second) {
+          int componentByteLength = accessor->getComponentByteLength();
+          int padding = byteLength % componentByteLength;
+          if (padding != 0) {
+            byteLength += (componentByteLength - padding);
+          }
+          PackedAccessor packedAccessor = {accessor, bufferView, byteLength};
+          packedAccessors.push_back(packedAccessor);
+          byteLength += static_cast<size_t>(byteStride) * accessor->count;
+        }
+        bufferView->byteLength = byteLength;
+        bufferViews[partition][byteStride].push_back(bufferView);
+      }
+    }
+  }
+  std::set<GLTF::BufferView*> interleavedBufferViews;
+  for (const std::vector<GLTF::Accessor*>& accessors : interleavedAccessors) {
+    GLTF::BufferView* bufferView = interleaveAccessors(accessors);
+    bufferViews[getPartition(accessors[0])][bufferView->byteStride].push_back(
+        bufferView);
+    interleavedBufferViews.insert(bufferView);
+    existingBuffers.push_back(bufferView->buffer);
+  }
+
+  // Place these in a buffer for each part sorted from largest byteStride to
+  // smallest, followed by the compressed data. Each bufferView starts 4-byte
+  // aligned.
+  std::set<GLTF::BufferView*> newBufferViews;
+  std::map<int, std::vector<GLTF::BufferView*>> orderedBufferViews;
+  for (const auto& partitionGroup : bufferViews) {
+    for (const auto& byteStrideGroup : partitionGroup.second) {
+      for (GLTF::BufferView* bufferView : byteStrideGroup.second) {
+        orderedBufferViews[partitionGroup.first].push_back(bufferView);
+        newBufferViews.insert(bufferView);
+      }
+    }
+  }
+  for (GLTF::BufferView* bufferView : compressedBufferViews) {
+    auto partitionPtr = bufferViewPartitions.find(bufferView);
+    int partition =
+        partitionPtr == bufferViewPartitions.end() ? 0 : partitionPtr->second;
+    orderedBufferViews[partition].push_back(bufferView);
+  }
+  if (orderedBufferViews.empty()) {
+    orderedBufferViews[0];
+  }
+  std::map<GLTF::BufferView*, size_t> byteOffsets;
+  std::map<GLTF::BufferView*, GLTF::Buffer*> bufferViewBuffers;
+  std::vector<GLTF::Buffer*> packedBuffers;
+  for (const auto& partitionGroup : orderedBufferViews) {
+    size_t byteLength = 0;
+    for (GLTF::BufferView* bufferView : partitionGroup.second) {
+      byteLength = (byteLength + 3) & ~static_cast<size_t>(3);
+      byteOffsets[bufferView] = byteLength;
+      byteLength += bufferView->byteLength;
+    }
+    // Zeroes the padding; large allocations get zeroed pages from the system
+    unsigned char* bufferData = (unsigned char*)calloc(byteLength, 1);
+    GLTF::Buffer* buffer = new GLTF::Buffer(bufferData, byteLength);
+    buffer->external = packedBuffers.size() > 0;
+    packedBuffers.push_back(buffer);
+    for (GLTF::BufferView* bufferView : partitionGroup.second) {
+      bufferViewBuffers[bufferView] = buffer;
+    }
+  }
+
+  std::vector<PackTask> tasks;
+  for (const PackedAccessor& packedAccessor : packedAccessors) {
+    GLTF::Accessor* accessor = packedAccessor.accessor;
+    addPackTasks(accessor, accessor->bufferView->buffer,
+                 bufferViewBuffers[packedAccessor.bufferView]->data +
+                     byteOffsets[packedAccessor.bufferView] +
+                     packedAccessor.byteOffset,
+                 packedAccessor.bufferView->byteStride != 0
+                     ? packedAccessor.bufferView->byteStride
+                     : accessor->getNumberOfComponents() *
+                           accessor->getComponentByteLength(),
+                 accessor->count, &tasks);
+  }
+  for (const auto& bufferViewBuffer : bufferViewBuffers) {
+    GLTF::BufferView* bufferView = bufferViewBuffer.first;
+    if (newBufferViews.find(bufferView) == newBufferViews.end() ||
+        interleavedBufferViews.find(bufferView) !=
+            interleavedBufferViews.end()) {
+      addPackTasks(NULL, bufferView->buffer,
+                   bufferViewBuffer.second->data + byteOffsets[bufferView], 1,
+                   bufferView->byteLength, &tasks);
+    }
+  }
+  // The old buffers are deleted once everything is packed, but each one's
+  // data is freed as soon as its last task has read it. The packed buffers
+  // only take up memory as they are written, so the data is not held twice.
+  std::map<GLTF::Buffer*, size_t> sourceIndices;
+  for (GLTF::Buffer* existingBuffer : existingBuffers) {
+    if (existingBuffer != NULL) {
+      sourceIndices.insert(
+          std::make_pair(existingBuffer, sourceIndices.size()));
+    }
+  }
+  std::vector<std::atomic<size_t>> sourceTasks(sourceIndices.size());
+  std::vector<size_t> taskSources(tasks.size(), sourceIndices.size());
+  for (size_t i = 0; i < tasks.size(); i++) {
+    auto sourceIndexPtr = sourceIndices.find(tasks[i].source);
+    if (sourceIndexPtr != sourceIndices.end()) {
+      taskSources[i] = sourceIndexPtr->second;
+      sourceTasks[sourceIndexPtr->second]++;
+    }
+  }
+  auto runTask = [&tasks, &taskSources, &sourceTasks](size_t i) {
+    const PackTask& task = tasks[i];
+    if (task.accessor == NULL) {
+      std::memcpy(task.target + task.begin, task.source->data + task.begin,
+                  task.end - task.begin);
+    } else {
+      PackVisitor visitor = {task.target, task.byteStride, task.begin,
+                             task.end};
+      GLTF::visitAccessor(task.accessor, &visitor);
+    }
+    if (taskSources[i] < sourceTasks.size() &&
+        --sourceTasks[taskSources[i]] == 0) {
+      task.source->freeData();
+    }
+  };
+  if (options->threads > 1 && tasks.size() > 1) {
+    GLTF::ThreadPool threadPool(options->threads);
+    threadPool.parallelFor(tasks.size(), runTask);
+  } else {
+    for (size_t i = 0; i < tasks.size(); i++) {
+      runTask(i);
+    }
+  }
+
+  // Point everything at the packed buffers once the old data has been read
+  for (const PackedAccessor& packedAccessor : packedAccessors) {
+    packedAccessor.accessor->bufferView = packedAccessor.bufferView;
+    packedAccessor.accessor->byteOffset = packedAccessor.byteOffset;
+  }
+  for (const auto& bufferViewBuffer : bufferViewBuffers) {
+    bufferViewBuffer.first->buffer = bufferViewBuffer.second;
+    bufferViewBuffer.first->byteOffset = byteOffsets[bufferViewBuffer.first];
+  }
+
+  // Delete old buffers since we packed everything into new ones
+  for (auto& existingBuffer : existingBuffers) {
+    delete existingBuffer;
+  }
+
+  // Delete old bufferviews that are no longer used
+  for (auto& existingBufferView : existingBufferViews) {
+    if (newBufferViews.find(existingBufferView) == newBufferViews.end()) {
+      delete existingBufferView;
+    }
+  }
+
+  if (options->bufferSplit == "size") {
+    packedBuffers =
+        splitBuffer(packedBuffers[0], options->bufferSplitByteLength);
+  }
+  if (buffers != NULL) {
+    *buffers = packedBuffers;
+  }
+  return packedBuffers[0];
+}
+
+/**
+ * Splits a buffer into parts of at most `maxByteLength` bytes, for binary
+ * glTF, whose 32-bit lengths limit it to 4 GiB. BufferViews longer than that
+ * are first split between their accessors, then the buffer is cut between
+ * bufferViews. The parts are copied out one at a time from the end, shrinking
+ * `buffer` behind them, so only one extra part is held in memory at once.
+ *
+ * Cuts are only made at 4 byte aligned offsets, and bufferViews whose
+ * accessors overlap, like interleaved ones, are kept whole, so a part can
+ * still be longer than `maxByteLength`.
+ *
+ * @return The parts in order, starting with `buffer`. The others are new
+ * buffers marked `external`.
+ */
+std::vector<GLTF::Buffer*> GLTF::Asset::splitBuffer(GLTF::Buffer* buffer,
+                                                    size_t maxByteLength) {
+  std::map<GLTF::BufferView*, std::vector<GLTF::Accessor*>> bufferViewAccessors;
+  for (GLTF::BufferView* bufferView : getAllCompressedBufferView()) {
+    if (bufferView->buffer == buffer) {
+      bufferViewAccessors[bufferView];
+    }
+  }
+  for (GLTF::Image* image : getAllImages()) {
+    if (image->bufferView != NULL && image->bufferView->buffer == buffer) {
+      bufferViewAccessors[image->bufferView];
+    }
+  }
+  for (GLTF::Accessor* accessor : getAllAccessors()) {
+    if (accessor->bufferView != NULL &&
+        accessor->bufferView->buffer == buffer) {
+      bufferViewAccessors[accessor->bufferView].push_back(accessor);
+    }
+  }
+
+  // Split long bufferViews before an accessor that would overrun a part
+  std::vector<GLTF::BufferView*> bufferViews;
+  for (auto& bufferViewAccessor : bufferViewAccessors) {
+    GLTF::BufferView* bufferView = bufferViewAccessor.first;
+    std::vector<GLTF::Accessor*>& accessors = bufferViewAccessor.second;
+    bufferViews.push_back(bufferView);
+    if (bufferView->byteLength <= maxByteLength) {
+      continue;
+    }
+    std::sort(accessors.begin(), accessors.end(),
+              [](GLTF::Accessor* a, GLTF::Accessor* b) {
+                return a->byteOffset < b->byteOffset;
+              });
+    size_t byteOffset = bufferView->byteOffset;
+    size_t byteLength = bufferView->byteLength;
+    GLTF::BufferView* piece = bufferView;
+    size_t pieceStart = 0;
+    size_t accessorsEnd = 0;
+    for (GLTF::Accessor* accessor : accessors) {
+      size_t accessorStart = accessor->byteOffset;
+      size_t accessorEnd =
+          accessorStart +
+          static_cast<size_t>(accessor->getByteStride()) * accessor->count;
+      if (accessorEnd - pieceStart > maxByteLength &&
+          accessorStart > pieceStart && accessorStart >= accessorsEnd &&
+          (byteOffset + accessorStart) % 4 == 0) {
+        piece->byteLength = accessorStart - pieceStart;
+        piece = new GLTF::BufferView(byteOffset + accessorStart, 0, buffer);
+        piece->byteStride = bufferView->byteStride;
+        piece->target = bufferView->target;
+        bufferViews.push_back(piece);
+        pieceStart = accessorStart;
+      }
+      accessor->bufferView = piece;
+      accessor->byteOffset = accessorStart - pieceStart;
+      accessorsEnd = std::max(accessorsEnd, accessorEnd);
+    }
+    piece->byteLength = byteLength - pieceStart;
+  }
+
+  // Start a new part before a bufferView that would overrun the current one
+  std::sort(bufferViews.begin(), bufferViews.end(),
+            [](GLTF::BufferView* a, GLTF::BufferView* b) {
+              return a->byteOffset < b->byteOffset;
+            });
+  std::vector<size_t> partOffsets = {0};
+  std::vector<std::vector<GLTF::BufferView*>> partBufferViews(1);
+  for (GLTF::BufferView* bufferView : bufferViews) {
+    size_t partOffset = partOffsets.back();
+    if (bufferView->byteOffset + bufferView->byteLength - partOffset >
+            maxByteLength &&
+        bufferView->byteOffset > partOffset &&
+        bufferView->byteOffset % 4 == 0) {
+      partOffsets.push_back(bufferView->byteOffset);
+      partBufferViews.emplace_back();
+    }
+    partBufferViews.back().push_back(bufferView);
+  }
+
+  std::vector<GLTF::Buffer*> parts(partOffsets.size(), buffer);
+  for (size_t i = partOffsets.size() - 1; i > 0; i--) {
+    size_t partOffset = partOffsets[i];
+    size_t byteLength = buffer->byteLength - partOffset;
+    unsigned char* data = (unsigned char*)malloc(byteLength);
+    std::memcpy(data, buffer->data + partOffset, byteLength);
+    buffer->resize(partOffset);
+
+    GLTF::Buffer* part = new GLTF::Buffer(data, byteLength);
+    part->external = true;
+    for (GLTF::BufferView* bufferView : partBufferViews[i]) {
+      bufferView->buffer = part;
+      bufferView->byteOffset -= partOffset;
+    }
+    parts[i] = part;
+  }
+  return parts;
+}
+
+/**
+ * Compresses the bufferViews packed into a buffer with the
+ * EXT_meshopt_compression extension. Vertex attribute, animation and skin
+ * data use the ATTRIBUTES mode, triangle list indices the TRIANGLES mode and
+ * other indices the INDICES mode. BufferViews that can't be compressed, or
+ * don't get any smaller, like images, Draco data and UNSIGNED_BYTE indices,
+ * are copied as they are.
+ *
+ * @param buffer The buffer returned by `packAccessors`
+ * @return The buffer holding the compressed data. If any bufferView was
+ * compressed, `buffer` is kept without its data as the fallback buffer of the
+ * compressed bufferViews.
+ */
+GLTF::Buffer* GLTF::Asset::compressBufferViews(GLTF::Buffer* buffer) {
+  std::map<GLTF::BufferView*, int> byteStrides;
+  for (GLTF::Accessor* accessor : getAllAccessors()) {
+    if (accessor->bufferView != NULL) {
+      byteStrides[accessor->bufferView] = accessor->getByteStride();
+    }
+  }
+  std::map<GLTF::BufferView*, bool> triangleBufferViews;
+  for (GLTF::Primitive* primitive : getAllPrimitives()) {
+    GLTF::Accessor* indices = primitive->indices;
+    if (indices == NULL || indices->bufferView == NULL) {
+      continue;
+    }
+    bool triangles = primitive->mode == GLTF::Primitive::Mode::TRIANGLES &&
+                     indices->count % 3 == 0;
+    auto trianglesPtr = triangleBufferViews.find(indices->bufferView);
+    triangleBufferViews[indices->bufferView] =
+        triangles &&
+        (trianglesPtr == triangleBufferViews.end() || trianglesPtr->second);
+  }
+
+  std::vector<GLTF::BufferView*> bufferViews = getAllBufferViews();
+  std::vector<GLTF::BufferView*> compressedBufferViews =
+      getAllCompressedBufferView();
+  bufferViews.insert(bufferViews.end(), compressedBufferViews.begin(),
+                     compressedBufferViews.end());
+  std::map<GLTF::BufferView*, GLTF::MeshoptExtension*> extensions;
+  std::map<GLTF::BufferView*, std::vector<unsigned char>> encodedBufferViews;
+  for (GLTF::BufferView* bufferView : bufferViews) {
+    auto byteStridePtr = byteStrides.find(bufferView);
+    if (bufferView == NULL || bufferView->buffer != buffer ||
+        byteStridePtr == byteStrides.end()) {
+      continue;
+    }
+    int byteStride = byteStridePtr->second;
+    size_t count = bufferView->byteLength / byteStride;
+    const unsigned char* data = buffer->data + bufferView->byteOffset;
+    GLTF::MeshoptExtension::Mode mode =
+        GLTF::MeshoptExtension::Mode::ATTRIBUTES;
+    std::vector<unsigned char> encoded;
+    if (bufferView->target == GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER) {
+      if (byteStride != 2 && byteStride != 4) {
+        continue;
+      }
+      std::vector<unsigned int> indices(count);
+      for (size_t i = 0; i < count; i++) {
+        indices[i] = byteStride == 2
+                         ? reinterpret_cast<const uint16_t*>(data)[i]
+                         : reinterpret_cast<const uint32_t*>(data)[i];
+      }
+      if (triangleBufferViews[bufferView] && count % 3 == 0) {
+        mode = GLTF::MeshoptExtension::Mode::TRIANGLES;
+        encoded = GLTF::MeshoptCodec::encodeIndexBuffer(indices.data(), count);
+      } else {
+        mode = GLTF::MeshoptExtension::Mode::INDICES;
+        encoded =
+            GLTF::MeshoptCodec::encodeIndexSequence(indices.data(), count);
+      }
+    } else if (byteStride % 4 == 0 && byteStride <= 256 &&
+               bufferView->byteLength % byteStride == 0) {
+      encoded = GLTF::MeshoptCodec::encodeVertexBuffer(data, count, byteStride);
+    }
+    if (encoded.size() == 0 ||
+        encoded.size() >= static_cast<size_t>(bufferView->byteLength)) {
+      continue;
+    }
+    GLTF::MeshoptExtension* extension = new GLTF::MeshoptExtension();
+    extension->mode = mode;
+    extension->byteLength = encoded.size();
+    extension->byteStride = byteStride;
+    extension->count = count;
+    extensions[bufferView] = extension;
+    encodedBufferViews[bufferView] = encoded;
+  }
+  if (extensions.size() == 0) {
+    return buffer;
+  }
+
+  // Copy the compressed and uncompressible data into a new buffer, keeping
+  // 4-byte alignment
+  std::vector<unsigned char> bufferData;
+  GLTF::Buffer* compressedBuffer = new GLTF::Buffer(NULL, 0);
+  for (GLTF::BufferView* bufferView : bufferViews) {
+    if (bufferView == NULL || bufferView->buffer != buffer) {
+      continue;
+    }
+    bufferData.resize((bufferData.size() + 3) & ~3, 0);
+    auto extensionPtr = extensions.find(bufferView);
+    if (extensionPtr != extensions.end()) {
+      const std::vector<unsigned char>& encoded =
+          encodedBufferViews[bufferView];
+      GLTF::MeshoptExtension* extension = extensionPtr->second;
+      extension->buffer = compressedBuffer;
+      extension->byteOffset = bufferData.size();
+      bufferData.insert(bufferData.end(), encoded.begin(), encoded.end());
+      bufferView->extensions["EXT_meshopt_compression"] = extension;
+    } else {
+      const unsigned char* data = buffer->data + bufferView->byteOffset;
+      bufferView->byteOffset = bufferData.size();
+      bufferView->buffer = compressedBuffer;
+      bufferData.insert(bufferData.end(), data, data + bufferView->byteLength);
+    }
+  }
+  compressedBuffer->byteLength = bufferData.size();
+  compressedBuffer->data = (unsigned char*)malloc(bufferData.size());
+  std::memcpy(compressedBuffer->data, bufferData.data(), bufferData.size());
+
+  // Uncompressed bufferViews stay in the original buffer, which has no data
+  buffer->freeData();
+  GLTF::MeshoptExtension* fallback = new GLTF::MeshoptExtension();
+  fallback->fallback = true;
+  buffer->extensions["EXT_meshopt_compression"] = fallback;
+  requireExtension("EXT_meshopt_compression");
+  return compressedBuffer;
+}
+
+void GLTF::Asset::requireExtension(std::string extension) {
+  useExtension(extension);
+  extensionsRequired.insert(extension);
+}
+
+void GLTF::Asset::useExtension(std::string extension) {
+  extensionsUsed.insert(extension);
+}
+
+void writeAssetMetadataJSON(
+    GLTF::Asset* asset, rapidjson::Writer<rapidjson::StringBuffer>* jsonWriter,
+    GLTF::Options* options) {
+  if (asset->metadata) {
+    jsonWriter->Key("asset");
     jsonWriter->StartObject();
     asset->metadata->writeJSON(jsonWriter, options);
     jsonWriter->EndObject();
@@ -1041,6 +3487,14 @@ std::vector<GLTF::Node*> writeScenesJSON(
             nodeStack.push_back(skin->skeleton);
           }
         }
+        auto lodExtensionPtr = node->extensions.find("MSFT_lod");
+        if (lodExtensionPtr != node->extensions.end()) {
+          for (GLTF::Node* lod :
+               static_cast<GLTF::LodExtension*>(lodExtensionPtr->second)
+                   ->lods) {
+            nodeStack.push_back(lod);
+          }
+        }
       }
       if (options->version == "1.0") {
         jsonWriter->Key(scene->getStringId().c_str());
@@ -1262,6 +3716,32 @@ std::vector<GLTF::Buffer*> writeBufferViewsJSON(
     GLTF::Asset* asset, rapidjson::Writer<rapidjson::StringBuffer>* jsonWriter,
     GLTF::Options* options, std::vector<GLTF::BufferView*> bufferViews) {
   std::vector<GLTF::Buffer*> buffers;
+  std::set<GLTF::Buffer*> uniqueBuffers;
+  for (GLTF::BufferView* bufferView : bufferViews) {
+    // Compressed data comes first, so that it is the binary glTF buffer
+    auto meshoptExtensionPtr =
+        bufferView->extensions.find("EXT_meshopt_compression");
+    if (meshoptExtensionPtr != bufferView->extensions.end()) {
+      GLTF::Buffer* buffer =
+          static_cast<GLTF::MeshoptExtension*>(meshoptExtensionPtr->second)
+              ->buffer;
+      if (buffer->id < 0 && uniqueBuffers.insert(buffer).second) {
+        buffers.push_back(buffer);
+      }
+    }
+    GLTF::Buffer* buffer = bufferView->buffer;
+    if (buffer != NULL && buffer->id < 0 &&
+        uniqueBuffers.insert(buffer).second) {
+      buffers.push_back(buffer);
+    }
+  }
+  // External buffers follow the one stored in binary glTF
+  std::stable_partition(buffers.begin(), buffers.end(),
+                        [](GLTF::Buffer* buffer) { return !buffer->external; });
+  for (size_t i = 0; i < buffers.size(); i++) {
+    buffers[i]->id = i;
+  }
+
   if (bufferViews.size() > 0) {
     jsonWriter->Key("bufferViews");
     if (options->version == "1.0") {
@@ -1270,13 +3750,6 @@ std::vector<GLTF::Buffer*> writeBufferViewsJSON(
       jsonWriter->StartArray();
     }
     for (GLTF::BufferView* bufferView : bufferViews) {
-      if (bufferView->buffer) {
-        GLTF::Buffer* buffer = bufferView->buffer;
-        if (buffer->id < 0) {
-          buffer->id = buffers.size();
-          buffers.push_back(buffer);
-        }
-      }
       if (options->version == "1.0") {
         jsonWriter->Key(bufferView->getStringId().c_str());
       }
@@ -1355,6 +3828,7 @@ void GLTF::Asset::writeJSON(void* writer, GLTF::Options* options) {
   std::vector<GLTF::Node*> nodes = writeScenesJSON(this, jsonWriter, options);
 
   // Write nodes and build mesh, skin, camera, and light arrays
+  std::vector<GLTF::Accessor*> accessors;
   std::vector<GLTF::Mesh*> meshes;
   std::vector<GLTF::Skin*> skins;
   std::vector<GLTF::Camera*> cameras;
@@ -1391,6 +3865,19 @@ void GLTF::Asset::writeJSON(void* writer, GLTF::Options* options) {
         light->id = lights.size();
         lights.push_back(light);
       }
+      auto instancingExtensionPtr =
+          node->extensions.find("EXT_mesh_gpu_instancing");
+      if (instancingExtensionPtr != node->extensions.end()) {
+        for (const auto& attribute :
+             static_cast<GLTF::InstancingExtension*>(
+                 instancingExtensionPtr->second)
+                 ->attributes) {
+          if (attribute.second->id < 0) {
+            attribute.second->id = accessors.size();
+            accessors.push_back(attribute.second);
+          }
+        }
+      }
       if (options->version == "1.0") {
         jsonWriter->Key(node->getStringId().c_str());
       }
@@ -1409,7 +3896,6 @@ void GLTF::Asset::writeJSON(void* writer, GLTF::Options* options) {
   writeCamerasJSON(this, jsonWriter, options, cameras);
 
   // Write meshes and build accessor and material arrays
-  std::vector<GLTF::Accessor*> accessors;
   std::vector<GLTF::BufferView*> bufferViews;
   std::map<GLTF::Material*, GLTF::Material*> generatedMaterialsMap;
   std::vector<GLTF::Material*> materials;
@@ -1636,8 +4122,10 @@ void GLTF::Asset::writeJSON(void* writer, GLTF::Options* options) {
   }
   skins.clear();
 
-  // Write accessors and add bufferViews to the bufferView array
+  // Write accessors and add bufferViews to the bufferView array. Bounds that
+  // packAccessors has not computed are computed here, only where needed.
   if (accessors.size() > 0) {
+    std::set<GLTF::Accessor*> boundedAccessors = getBoundedAccessors(this);
     jsonWriter->Key("accessors");
     if (options->version == "1.0") {
       jsonWriter->StartObject();
@@ -1645,13 +4133,21 @@ void GLTF::Asset::writeJSON(void* writer, GLTF::Options* options) {
       jsonWriter->StartArray();
     }
     for (GLTF::Accessor* accessor : accessors) {
-      if (accessor->bufferView) {
-        GLTF::BufferView* bufferView = accessor->bufferView;
-        if (bufferView->id < 0) {
-          bufferView->id = bufferViews.size();
-          bufferViews.push_back(bufferView);
+      for (GLTF::Accessor* bufferViewAccessor :
+           {accessor, accessor->sparseIndices, accessor->sparseValues}) {
+        if (bufferViewAccessor != NULL && bufferViewAccessor->bufferView) {
+          GLTF::BufferView* bufferView = bufferViewAccessor->bufferView;
+          if (bufferView->id < 0) {
+            bufferView->id = bufferViews.size();
+            bufferViews.push_back(bufferView);
+          }
         }
       }
+      if (accessor->min == NULL &&
+          (options->accessorMinMax ||
+           boundedAccessors.find(accessor) != boundedAccessors.end())) {
+        accessor->computeMinMax();
+      }
       if (options->version == "1.0") {
         jsonWriter->Key(accessor->getStringId().c_str());
       }
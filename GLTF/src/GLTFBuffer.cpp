@@ -1,16 +1,55 @@
 // Copyright 2020 The Khronos® Group Inc.
 #include "GLTFBuffer.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
 #include "Base64.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
 
-GLTF::Buffer::Buffer(unsigned char* data, int dataLength) {
+GLTF::Buffer::Buffer(unsigned char* data, size_t dataLength) {
   this->data = data;
   this->byteLength = dataLength;
 }
 
-GLTF::Buffer::~Buffer() { free(this->data); }
+GLTF::Buffer::Buffer(unsigned char* data, size_t dataLength,
+                     std::function<void(unsigned char*)> deleter)
+    : Buffer(data, dataLength) {
+  this->deleter = std::move(deleter);
+}
+
+GLTF::Buffer::~Buffer() {
+  if (deleter) {
+    deleter(this->data);
+  } else {
+    free(this->data);
+  }
+}
+
+void GLTF::Buffer::resize(size_t byteLength) {
+  if (deleter) {
+    unsigned char* resized = (unsigned char*)malloc(byteLength);
+    std::memcpy(resized, this->data, std::min(byteLength, this->byteLength));
+    deleter(this->data);
+    deleter = nullptr;
+    this->data = resized;
+  } else {
+    this->data = (unsigned char*)realloc(this->data, byteLength);
+  }
+  this->byteLength = byteLength;
+}
+
+void GLTF::Buffer::freeData() {
+  if (deleter) {
+    deleter(this->data);
+    deleter = nullptr;
+  } else {
+    free(this->data);
+  }
+  this->data = NULL;
+}
 
 std::string GLTF::Buffer::typeName() { return "buffer"; }
 
@@ -18,10 +57,12 @@ void GLTF::Buffer::writeJSON(void* writer, GLTF::Options* options) {
   rapidjson::Writer<rapidjson::StringBuffer>* jsonWriter =
       (rapidjson::Writer<rapidjson::StringBuffer>*)writer;
   jsonWriter->Key("byteLength");
-  jsonWriter->Int(this->byteLength);
-  if (!options->binary || !options->embeddedBuffers) {
+  jsonWriter->Uint64(this->byteLength);
+  // Fallback buffers of compressed bufferViews have no data to write
+  if (this->data != NULL &&
+      (!options->binary || !options->embeddedBuffers || external)) {
     jsonWriter->Key("uri");
-    if (options->embeddedBuffers) {
+    if (options->embeddedBuffers && !external) {
       uri = "data:application/octet-stream;base64," +
             std::string(Base64::encode(this->data, this->byteLength));
     } else {
@@ -4,20 +4,20 @@
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
 
-GLTF::BufferView::BufferView(int byteOffset, int byteLength,
+GLTF::BufferView::BufferView(size_t byteOffset, size_t byteLength,
                              GLTF::Buffer* buffer) {
   this->byteOffset = byteOffset;
   this->byteLength = byteLength;
   this->buffer = buffer;
 }
 
-GLTF::BufferView::BufferView(unsigned char* data, int dataLength) {
+GLTF::BufferView::BufferView(unsigned char* data, size_t dataLength) {
   this->byteOffset = 0;
   this->byteLength = dataLength;
   this->buffer = new Buffer(data, dataLength);
 }
 
-GLTF::BufferView::BufferView(unsigned char* data, int dataLength,
+GLTF::BufferView::BufferView(unsigned char* data, size_t dataLength,
                              GLTF::Constants::WebGL target)
     : GLTF::BufferView::BufferView(data, dataLength) {
   this->target = target;
@@ -37,9 +37,9 @@ void GLTF::BufferView::writeJSON(void* writer, GLTF::Options* options) {
     }
   }
   jsonWriter->Key("byteOffset");
-  jsonWriter->Int(this->byteOffset);
+  jsonWriter->Uint64(this->byteOffset);
   jsonWriter->Key("byteLength");
-  jsonWriter->Int(this->byteLength);
+  jsonWriter->Uint64(this->byteLength);
   if (byteStride != 0 && options->version != "1.0") {
     jsonWriter->Key("byteStride");
     jsonWriter->Int(this->byteStride);
@@ -48,4 +48,5 @@ void GLTF::BufferView::writeJSON(void* writer, GLTF::Options* options) {
     jsonWriter->Key("target");
     jsonWriter->Int(static_cast<int>(this->target));
   }
+  GLTF::Object::writeJSON(writer, options);
 }
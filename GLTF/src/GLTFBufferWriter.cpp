@@ -0,0 +1,143 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "GLTFBufferWriter.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#if !defined(_WIN32)
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#endif
+
+const unsigned char ZEROES[64] = {0};
+const unsigned char SPACES[4] = {' ', ' ', ' ', ' '};
+
+const uint32_t GLB_MAGIC = 0x46546C67;
+const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+size_t GLTF::BufferWriter::add(const unsigned char* data, size_t byteLength,
+                               size_t alignment) {
+  pad(alignment);
+  size_t byteOffset = _byteLength;
+  if (byteLength > 0) {
+    Segment segment = {data, byteLength};
+    _segments.push_back(segment);
+    _byteLength += byteLength;
+  }
+  return byteOffset;
+}
+
+void GLTF::BufferWriter::append(const GLTF::BufferWriter& buffer) {
+  _segments.insert(_segments.end(), buffer._segments.begin(),
+                   buffer._segments.end());
+  _byteLength += buffer._byteLength;
+}
+
+void GLTF::BufferWriter::pad(size_t alignment) {
+  if (alignment <= 1) {
+    return;
+  }
+  size_t padding = (alignment - _byteLength % alignment) % alignment;
+  while (padding > 0) {
+    Segment segment = {ZEROES, std::min(padding, sizeof(ZEROES))};
+    _segments.push_back(segment);
+    _byteLength += segment.byteLength;
+    padding -= segment.byteLength;
+  }
+}
+
+size_t GLTF::BufferWriter::getByteLength() const { return _byteLength; }
+
+#if defined(_WIN32)
+bool GLTF::BufferWriter::write(FILE* file) const {
+  for (const Segment& segment : _segments) {
+    if (fwrite(segment.data, 1, segment.byteLength, file) !=
+        segment.byteLength) {
+      return false;
+    }
+  }
+  return true;
+}
+#else
+bool GLTF::BufferWriter::write(FILE* file) const {
+  // Anything already written through the stream has to land first
+  if (fflush(file) != 0) {
+    return false;
+  }
+  int fd = fileno(file);
+  std::vector<struct iovec> vectors(_segments.size());
+  for (size_t i = 0; i < _segments.size(); i++) {
+    vectors[i].iov_base =
+        const_cast<void*>(static_cast<const void*>(_segments[i].data));
+    vectors[i].iov_len = _segments[i].byteLength;
+  }
+  size_t index = 0;
+  while (index < vectors.size()) {
+    int count =
+        static_cast<int>(std::min(vectors.size() - index,
+                                  static_cast<size_t>(IOV_MAX)));
+    ssize_t written = writev(fd, &vectors[index], count);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    // Skip what was written, which may end partway through a segment
+    size_t remaining = static_cast<size_t>(written);
+    while (index < vectors.size() && remaining >= vectors[index].iov_len) {
+      remaining -= vectors[index].iov_len;
+      index++;
+    }
+    if (remaining > 0) {
+      vectors[index].iov_base =
+          static_cast<unsigned char*>(vectors[index].iov_base) + remaining;
+      vectors[index].iov_len -= remaining;
+    }
+  }
+  return true;
+}
+#endif
+
+bool GLTF::writeGLB(FILE* file, const std::string& json,
+                    const GLTF::BufferWriter& buffer, int version) {
+  size_t jsonPadding = (4 - (json.length() & 3)) & 3;
+  size_t binPadding = (4 - (buffer.getByteLength() & 3)) & 3;
+  uint64_t byteLength = 12 + 8 + json.length() + jsonPadding + 8 +
+                        buffer.getByteLength() + binPadding;
+  if (byteLength > UINT32_MAX) {
+    return false;
+  }
+  uint32_t jsonChunkLength = static_cast<uint32_t>(json.length() + jsonPadding);
+  uint32_t binChunkLength =
+      static_cast<uint32_t>(buffer.getByteLength() + binPadding);
+
+  // Version 1 has a JSON content header and a body without a chunk header
+  uint32_t header[3] = {GLB_MAGIC, static_cast<uint32_t>(version), 0};
+  header[2] = 12 + 8 + jsonChunkLength + binChunkLength;
+  uint32_t jsonChunkHeader[2] = {jsonChunkLength,
+                                 version == 1 ? 0 : GLB_CHUNK_JSON};
+  uint32_t binChunkHeader[2] = {binChunkLength, GLB_CHUNK_BIN};
+  if (version != 1) {
+    header[2] += 8;
+  }
+
+  GLTF::BufferWriter glb;
+  glb.add(reinterpret_cast<const unsigned char*>(header), sizeof(header));
+  glb.add(reinterpret_cast<const unsigned char*>(jsonChunkHeader),
+          sizeof(jsonChunkHeader));
+  glb.add(reinterpret_cast<const unsigned char*>(json.data()),
+          json.length());
+  glb.add(SPACES, jsonPadding, 1);
+  if (version != 1) {
+    glb.add(reinterpret_cast<const unsigned char*>(binChunkHeader),
+            sizeof(binChunkHeader));
+  }
+  glb.append(buffer);
+  glb.pad(4);
+  return glb.write(file);
+}
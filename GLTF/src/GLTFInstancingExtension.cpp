@@ -0,0 +1,18 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "GLTFInstancingExtension.h"
+
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+void GLTF::InstancingExtension::writeJSON(void* writer,
+                                          GLTF::Options* /* options */) {
+  rapidjson::Writer<rapidjson::StringBuffer>* jsonWriter =
+      (rapidjson::Writer<rapidjson::StringBuffer>*)writer;
+  jsonWriter->Key("attributes");
+  jsonWriter->StartObject();
+  for (const auto& attribute : this->attributes) {
+    jsonWriter->Key(attribute.first.c_str());
+    jsonWriter->Int(attribute.second->id);
+  }
+  jsonWriter->EndObject();
+}
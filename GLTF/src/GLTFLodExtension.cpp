@@ -0,0 +1,18 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "GLTFLodExtension.h"
+
+#include "GLTFNode.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+void GLTF::LodExtension::writeJSON(void* writer,
+                                   GLTF::Options* /* options */) {
+  rapidjson::Writer<rapidjson::StringBuffer>* jsonWriter =
+      (rapidjson::Writer<rapidjson::StringBuffer>*)writer;
+  jsonWriter->Key("ids");
+  jsonWriter->StartArray();
+  for (GLTF::Node* lod : this->lods) {
+    jsonWriter->Int(lod->id);
+  }
+  jsonWriter->EndArray();
+}
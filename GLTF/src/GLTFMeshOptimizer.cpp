@@ -0,0 +1,815 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "GLTFMeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+
+// Tuning from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+const int VERTEX_CACHE_SIZE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+// Vertex fetch statistics are simulated for a 16KB cache of 64 byte lines
+const size_t FETCH_CACHE_LINE_SIZE = 64;
+const size_t FETCH_CACHE_LINE_COUNT = 256;
+// Weld grid cells are clamped to this range, so that neighboring cells can
+// be computed without overflowing
+const double WELD_CELL_LIMIT = 4.0e18;
+
+/**
+ * A FIFO cache of `size` entries, identified by index. An entry is cached if
+ * it was added within the last `size` misses.
+ */
+class FifoCache {
+ public:
+  FifoCache(size_t entryCount, size_t size)
+      : _addedAt(entryCount, 0), _size(size), _time(size + 1) {}
+
+  /** @return `true` on a miss, which adds the entry */
+  bool access(size_t entry) {
+    if (_time - _addedAt[entry] > _size) {
+      _addedAt[entry] = _time++;
+      return true;
+    }
+    return false;
+  }
+
+  void clear() { _time += _size + 1; }
+
+ private:
+  std::vector<size_t> _addedAt;
+  size_t _size;
+  size_t _time;
+};
+
+float GLTF::MeshOptimizer::VertexCacheStatistics::getACMR() const {
+  if (triangleCount == 0) {
+    return 0;
+  }
+  return static_cast<float>(transformedVertexCount) / triangleCount;
+}
+
+float GLTF::MeshOptimizer::VertexCacheStatistics::getATVR() const {
+  if (vertexCount == 0) {
+    return 0;
+  }
+  return static_cast<float>(transformedVertexCount) / vertexCount;
+}
+
+void GLTF::MeshOptimizer::VertexCacheStatistics::add(
+    const VertexCacheStatistics& statistics) {
+  triangleCount += statistics.triangleCount;
+  vertexCount += statistics.vertexCount;
+  transformedVertexCount += statistics.transformedVertexCount;
+}
+
+float GLTF::MeshOptimizer::VertexFetchStatistics::getOverfetch() const {
+  if (vertexBytes == 0) {
+    return 0;
+  }
+  return static_cast<float>(bytesFetched) / vertexBytes;
+}
+
+void GLTF::MeshOptimizer::VertexFetchStatistics::add(
+    const VertexFetchStatistics& statistics) {
+  bytesFetched += statistics.bytesFetched;
+  vertexBytes += statistics.vertexBytes;
+}
+
+GLTF::MeshOptimizer::VertexCacheStatistics
+GLTF::MeshOptimizer::analyzeVertexCache(
+    const std::vector<unsigned int>& indices, size_t vertexCount,
+    size_t cacheSize) {
+  VertexCacheStatistics statistics;
+  statistics.triangleCount = indices.size() / 3;
+  FifoCache cache(vertexCount, cacheSize);
+  std::vector<bool> referenced(vertexCount, false);
+  for (unsigned int index : indices) {
+    if (cache.access(index)) {
+      statistics.transformedVertexCount++;
+    }
+    if (!referenced[index]) {
+      referenced[index] = true;
+      statistics.vertexCount++;
+    }
+  }
+  return statistics;
+}
+
+/**
+ * Scores a vertex by how much emitting one of its triangles next would help:
+ * recently used vertices score higher, as do vertices with few remaining
+ * triangles, so that they are finished off and leave the cache.
+ */
+float getVertexScore(int cachePosition, unsigned int remainingTriangles) {
+  if (remainingTriangles == 0) {
+    return -1.0f;
+  }
+  float score = 0;
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      // Used by the last triangle; a fixed score avoids favoring one of its
+      // edges over the others
+      score = LAST_TRIANGLE_SCORE;
+    } else {
+      float scale = 1.0f / (VERTEX_CACHE_SIZE - 3);
+      score = std::pow(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+    }
+  }
+  score += VALENCE_BOOST_SCALE *
+           std::pow(static_cast<float>(remainingTriangles),
+                    -VALENCE_BOOST_POWER);
+  return score;
+}
+
+void GLTF::MeshOptimizer::optimizeVertexCache(
+    std::vector<unsigned int>* indices, size_t vertexCount) {
+  std::vector<unsigned int>& triangles = *indices;
+  size_t triangleCount = triangles.size() / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // Triangles using each vertex, as slices of `adjacency`; the first
+  // `remaining[v]` entries of a slice are the triangles not yet emitted
+  std::vector<unsigned int> remaining(vertexCount, 0);
+  for (size_t i = 0; i < triangleCount * 3; i++) {
+    remaining[triangles[i]]++;
+  }
+  std::vector<size_t> offsets(vertexCount + 1, 0);
+  for (size_t v = 0; v < vertexCount; v++) {
+    offsets[v + 1] = offsets[v] + remaining[v];
+  }
+  std::vector<unsigned int> adjacency(triangleCount * 3);
+  std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t t = 0; t < triangleCount; t++) {
+    for (size_t k = 0; k < 3; k++) {
+      adjacency[fill[triangles[t * 3 + k]]++] = static_cast<unsigned int>(t);
+    }
+  }
+
+  std::vector<int> cachePositions(vertexCount, -1);
+  std::vector<float> vertexScores(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++) {
+    vertexScores[v] = getVertexScore(-1, remaining[v]);
+  }
+  std::vector<bool> emitted(triangleCount, false);
+  long bestTriangle = -1;
+  float bestScore = -1;
+  for (size_t t = 0; t < triangleCount; t++) {
+    float score = vertexScores[triangles[t * 3]] +
+                  vertexScores[triangles[t * 3 + 1]] +
+                  vertexScores[triangles[t * 3 + 2]];
+    if (score > bestScore) {
+      bestScore = score;
+      bestTriangle = t;
+    }
+  }
+
+  std::vector<unsigned int> output;
+  output.reserve(triangleCount * 3);
+  unsigned int cache[VERTEX_CACHE_SIZE + 3];
+  int cacheCount = 0;
+  size_t nextTriangle = 0;
+  while (bestTriangle >= 0) {
+    const unsigned int* triangle = &triangles[bestTriangle * 3];
+    emitted[bestTriangle] = true;
+    for (size_t k = 0; k < 3; k++) {
+      unsigned int v = triangle[k];
+      output.push_back(v);
+      unsigned int* vertexTriangles = adjacency.data() + offsets[v];
+      for (unsigned int i = 0; i < remaining[v]; i++) {
+        if (vertexTriangles[i] == static_cast<unsigned int>(bestTriangle)) {
+          vertexTriangles[i] = vertexTriangles[remaining[v] - 1];
+          break;
+        }
+      }
+      remaining[v]--;
+    }
+
+    // Move the triangle's vertices to the front of the LRU cache
+    unsigned int newCache[VERTEX_CACHE_SIZE + 3];
+    int newCacheCount = 0;
+    for (size_t k = 0; k < 3; k++) {
+      bool duplicate = false;
+      for (int i = 0; i < newCacheCount; i++) {
+        duplicate = duplicate || newCache[i] == triangle[k];
+      }
+      if (!duplicate) {
+        newCache[newCacheCount++] = triangle[k];
+      }
+    }
+    for (int i = 0; i < cacheCount; i++) {
+      unsigned int v = cache[i];
+      if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+        newCache[newCacheCount++] = v;
+      }
+    }
+
+    // Rescore the cached vertices, including those just pushed out of the
+    // cache, and their remaining triangles
+    for (int i = 0; i < newCacheCount; i++) {
+      unsigned int v = newCache[i];
+      cachePositions[v] = i < VERTEX_CACHE_SIZE ? i : -1;
+      vertexScores[v] = getVertexScore(cachePositions[v], remaining[v]);
+    }
+    bestTriangle = -1;
+    bestScore = -1;
+    for (int i = 0; i < newCacheCount; i++) {
+      unsigned int v = newCache[i];
+      const unsigned int* vertexTriangles = adjacency.data() + offsets[v];
+      for (unsigned int j = 0; j < remaining[v]; j++) {
+        unsigned int t = vertexTriangles[j];
+        float score = vertexScores[triangles[t * 3]] +
+                      vertexScores[triangles[t * 3 + 1]] +
+                      vertexScores[triangles[t * 3 + 2]];
+        if (score > bestScore) {
+          bestScore = score;
+          bestTriangle = t;
+        }
+      }
+    }
+    cacheCount = newCacheCount < VERTEX_CACHE_SIZE ? newCacheCount
+                                                   : VERTEX_CACHE_SIZE;
+    for (int i = 0; i < cacheCount; i++) {
+      cache[i] = newCache[i];
+    }
+
+    if (bestTriangle < 0) {
+      // Nothing in the cache has triangles left, continue in input order
+      while (nextTriangle < triangleCount && emitted[nextTriangle]) {
+        nextTriangle++;
+      }
+      if (nextTriangle < triangleCount) {
+        bestTriangle = nextTriangle;
+      }
+    }
+  }
+  for (size_t i = 0; i < output.size(); i++) {
+    triangles[i] = output[i];
+  }
+}
+
+GLTF::MeshOptimizer::VertexFetchStatistics
+GLTF::MeshOptimizer::analyzeVertexFetch(
+    const std::vector<unsigned int>& indices, size_t vertexCount,
+    size_t vertexSize) {
+  VertexFetchStatistics statistics;
+  size_t lineCount =
+      (vertexCount * vertexSize + FETCH_CACHE_LINE_SIZE - 1) /
+      FETCH_CACHE_LINE_SIZE;
+  FifoCache cache(lineCount, FETCH_CACHE_LINE_COUNT);
+  std::vector<bool> referenced(vertexCount, false);
+  for (unsigned int index : indices) {
+    if (!referenced[index]) {
+      referenced[index] = true;
+      statistics.vertexBytes += vertexSize;
+    }
+    size_t firstLine = index * vertexSize / FETCH_CACHE_LINE_SIZE;
+    size_t lastLine = ((index + 1) * vertexSize - 1) / FETCH_CACHE_LINE_SIZE;
+    for (size_t line = firstLine; line <= lastLine; line++) {
+      if (cache.access(line)) {
+        statistics.bytesFetched += FETCH_CACHE_LINE_SIZE;
+      }
+    }
+  }
+  return statistics;
+}
+
+std::vector<unsigned int> GLTF::MeshOptimizer::optimizeVertexFetch(
+    std::vector<unsigned int>* indices, size_t vertexCount) {
+  const unsigned int unassigned = static_cast<unsigned int>(-1);
+  std::vector<unsigned int> remap(vertexCount, unassigned);
+  unsigned int nextVertex = 0;
+  for (unsigned int& index : *indices) {
+    if (remap[index] == unassigned) {
+      remap[index] = nextVertex++;
+    }
+    index = remap[index];
+  }
+  for (size_t v = 0; v < vertexCount; v++) {
+    if (remap[v] == unassigned) {
+      remap[v] = nextVertex++;
+    }
+  }
+  return remap;
+}
+
+/**
+ * Splits a triangle list into runs of triangles, returning the index of the
+ * first triangle of each run. Hard boundaries are placed where all three
+ * vertices of a triangle miss the vertex cache, so moving the runs around
+ * costs little. Each run is then split again wherever the cache miss ratio
+ * since the start of the split falls to `threshold` times that of the run.
+ */
+std::vector<size_t> getOverdrawClusters(
+    const std::vector<unsigned int>& indices, size_t vertexCount,
+    float threshold) {
+  size_t triangleCount = indices.size() / 3;
+  FifoCache cache(vertexCount, VERTEX_CACHE_SIZE);
+  std::vector<unsigned int> misses(triangleCount);
+  std::vector<size_t> hardClusters;
+  for (size_t t = 0; t < triangleCount; t++) {
+    misses[t] = 0;
+    for (size_t k = 0; k < 3; k++) {
+      misses[t] += cache.access(indices[t * 3 + k]) ? 1 : 0;
+    }
+    if (t == 0 || misses[t] == 3) {
+      hardClusters.push_back(t);
+    }
+  }
+  hardClusters.push_back(triangleCount);
+
+  std::vector<size_t> clusters;
+  for (size_t c = 0; c + 1 < hardClusters.size(); c++) {
+    size_t start = hardClusters[c];
+    size_t end = hardClusters[c + 1];
+    size_t clusterMisses = 0;
+    for (size_t t = start; t < end; t++) {
+      clusterMisses += misses[t];
+    }
+    float clusterThreshold =
+        threshold * static_cast<float>(clusterMisses) / (end - start);
+
+    clusters.push_back(start);
+    cache.clear();
+    size_t runStart = start;
+    size_t runMisses = 0;
+    for (size_t t = start; t < end; t++) {
+      for (size_t k = 0; k < 3; k++) {
+        runMisses += cache.access(indices[t * 3 + k]) ? 1 : 0;
+      }
+      float runRatio = static_cast<float>(runMisses) / (t + 1 - runStart);
+      if (runRatio <= clusterThreshold && t + 1 < end) {
+        clusters.push_back(t + 1);
+        cache.clear();
+        runStart = t + 1;
+        runMisses = 0;
+      }
+    }
+  }
+  return clusters;
+}
+
+void GLTF::MeshOptimizer::optimizeOverdraw(std::vector<unsigned int>* indices,
+                                           const std::vector<float>& positions,
+                                           float threshold) {
+  std::vector<unsigned int>& triangles = *indices;
+  size_t triangleCount = triangles.size() / 3;
+  size_t vertexCount = positions.size() / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+
+  float meshCenter[3] = {0, 0, 0};
+  for (size_t v = 0; v < vertexCount; v++) {
+    for (size_t k = 0; k < 3; k++) {
+      meshCenter[k] += positions[v * 3 + k] / vertexCount;
+    }
+  }
+
+  // Sort clusters by how much their area weighted center faces away from
+  // the mesh center, outermost first
+  std::vector<size_t> clusters =
+      getOverdrawClusters(triangles, vertexCount, threshold);
+  clusters.push_back(triangleCount);
+  std::vector<std::pair<float, size_t>> sortKeys;
+  for (size_t c = 0; c + 1 < clusters.size(); c++) {
+    float center[3] = {0, 0, 0};
+    float normal[3] = {0, 0, 0};
+    float area = 0;
+    for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+      const float* p0 = &positions[triangles[t * 3] * 3];
+      const float* p1 = &positions[triangles[t * 3 + 1] * 3];
+      const float* p2 = &positions[triangles[t * 3 + 2] * 3];
+      float edge1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+      float edge2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+      float cross[3] = {edge1[1] * edge2[2] - edge1[2] * edge2[1],
+                        edge1[2] * edge2[0] - edge1[0] * edge2[2],
+                        edge1[0] * edge2[1] - edge1[1] * edge2[0]};
+      float triangleArea = std::sqrt(cross[0] * cross[0] +
+                                     cross[1] * cross[1] + cross[2] * cross[2]);
+      for (size_t k = 0; k < 3; k++) {
+        center[k] += (p0[k] + p1[k] + p2[k]) / 3 * triangleArea;
+        normal[k] += cross[k];
+      }
+      area += triangleArea;
+    }
+    float normalLength =
+        std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] +
+                  normal[2] * normal[2]);
+    float key = 0;
+    if (area > 0 && normalLength > 0) {
+      for (size_t k = 0; k < 3; k++) {
+        key += (center[k] / area - meshCenter[k]) * normal[k] / normalLength;
+      }
+    }
+    sortKeys.push_back(std::make_pair(-key, c));
+  }
+  std::stable_sort(sortKeys.begin(), sortKeys.end(),
+                   [](const std::pair<float, size_t>& a,
+                      const std::pair<float, size_t>& b) {
+                     return a.first < b.first;
+                   });
+
+  std::vector<unsigned int> output;
+  output.reserve(triangleCount * 3);
+  for (const std::pair<float, size_t>& sortKey : sortKeys) {
+    size_t c = sortKey.second;
+    output.insert(output.end(), triangles.begin() + clusters[c] * 3,
+                  triangles.begin() + clusters[c + 1] * 3);
+  }
+  triangles.swap(output);
+}
+
+/**
+ * Hashes a spatial hash grid cell.
+ */
+uint64_t getCellKey(int64_t x, int64_t y, int64_t z) {
+  uint64_t key = static_cast<uint64_t>(x) * 73856093;
+  key ^= static_cast<uint64_t>(y) * 19349663;
+  key ^= static_cast<uint64_t>(z) * 83492791;
+  return key;
+}
+
+bool isWithinTolerance(const float* a, const float* b,
+                       size_t numberOfComponents, float tolerance) {
+  for (size_t k = 0; k < numberOfComponents; k++) {
+    if (!(std::fabs(a[k] - b[k]) <= tolerance)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<unsigned int> GLTF::MeshOptimizer::weldVertices(
+    const std::vector<float>& positions, float positionTolerance,
+    const std::vector<WeldAttribute>& attributes) {
+  size_t vertexCount = positions.size() / 3;
+  // With no tolerance cells only need to separate distinct positions
+  float cellSize = positionTolerance > 0 ? positionTolerance : 1.0f;
+  std::unordered_map<uint64_t, std::vector<unsigned int>> cells;
+  std::vector<unsigned int> remap(vertexCount);
+  unsigned int nextVertex = 0;
+  for (size_t v = 0; v < vertexCount; v++) {
+    const float* position = &positions[v * 3];
+    // Non-finite positions are never within tolerance of another vertex
+    if (!std::isfinite(position[0]) || !std::isfinite(position[1]) ||
+        !std::isfinite(position[2])) {
+      remap[v] = nextVertex++;
+      continue;
+    }
+    int64_t cell[3];
+    for (size_t k = 0; k < 3; k++) {
+      double quotient = std::floor(static_cast<double>(position[k]) / cellSize);
+      cell[k] = static_cast<int64_t>(
+          std::max(-WELD_CELL_LIMIT, std::min(WELD_CELL_LIMIT, quotient)));
+    }
+
+    // Any vertex within tolerance is in this cell or a neighboring one
+    long welded = -1;
+    for (int64_t x = cell[0] - 1; x <= cell[0] + 1 && welded < 0; x++) {
+      for (int64_t y = cell[1] - 1; y <= cell[1] + 1 && welded < 0; y++) {
+        for (int64_t z = cell[2] - 1; z <= cell[2] + 1 && welded < 0; z++) {
+          auto cellPtr = cells.find(getCellKey(x, y, z));
+          if (cellPtr == cells.end()) {
+            continue;
+          }
+          for (unsigned int candidate : cellPtr->second) {
+            bool match = isWithinTolerance(position, &positions[candidate * 3],
+                                           3, positionTolerance);
+            for (const WeldAttribute& attribute : attributes) {
+              size_t n = attribute.numberOfComponents;
+              match = match && isWithinTolerance(
+                                   attribute.values + v * n,
+                                   attribute.values + candidate * n, n,
+                                   attribute.tolerance);
+            }
+            if (match) {
+              welded = remap[candidate];
+              break;
+            }
+          }
+        }
+      }
+    }
+    if (welded >= 0) {
+      remap[v] = static_cast<unsigned int>(welded);
+    } else {
+      remap[v] = nextVertex++;
+      cells[getCellKey(cell[0], cell[1], cell[2])].push_back(
+          static_cast<unsigned int>(v));
+    }
+  }
+  return remap;
+}
+
+size_t GLTF::MeshOptimizer::removeDegenerateTriangles(
+    std::vector<unsigned int>* indices) {
+  std::vector<unsigned int>& triangles = *indices;
+  size_t triangleCount = triangles.size() / 3;
+  size_t kept = 0;
+  for (size_t t = 0; t < triangleCount; t++) {
+    unsigned int a = triangles[t * 3];
+    unsigned int b = triangles[t * 3 + 1];
+    unsigned int c = triangles[t * 3 + 2];
+    if (a != b && b != c && c != a) {
+      triangles[kept * 3] = a;
+      triangles[kept * 3 + 1] = b;
+      triangles[kept * 3 + 2] = c;
+      kept++;
+    }
+  }
+  triangles.resize(kept * 3);
+  return triangleCount - kept;
+}
+
+std::vector<GLTF::MeshOptimizer::IndexChunk> GLTF::MeshOptimizer::splitIndices(
+    const std::vector<unsigned int>& indices, size_t primitiveSize,
+    size_t maxVertexCount) {
+  std::vector<IndexChunk> chunks;
+  if (indices.empty() || primitiveSize == 0 || maxVertexCount < primitiveSize) {
+    return chunks;
+  }
+  size_t vertexCount =
+      static_cast<size_t>(*std::max_element(indices.begin(), indices.end())) +
+      1;
+  // The chunk each vertex was last added to, and its index there
+  std::vector<size_t> vertexChunks(vertexCount, static_cast<size_t>(-1));
+  std::vector<unsigned int> chunkIndices(vertexCount);
+  chunks.emplace_back();
+  for (size_t i = 0; i + primitiveSize <= indices.size(); i += primitiveSize) {
+    size_t newVertexCount = 0;
+    for (size_t k = 0; k < primitiveSize; k++) {
+      unsigned int index = indices[i + k];
+      bool repeated = false;
+      for (size_t l = 0; l < k; l++) {
+        repeated = repeated || indices[i + l] == index;
+      }
+      if (!repeated && vertexChunks[index] != chunks.size() - 1) {
+        newVertexCount++;
+      }
+    }
+    if (chunks.back().vertices.size() + newVertexCount > maxVertexCount) {
+      chunks.emplace_back();
+    }
+    IndexChunk& chunk = chunks.back();
+    for (size_t k = 0; k < primitiveSize; k++) {
+      unsigned int index = indices[i + k];
+      if (vertexChunks[index] != chunks.size() - 1) {
+        vertexChunks[index] = chunks.size() - 1;
+        chunkIndices[index] = static_cast<unsigned int>(chunk.vertices.size());
+        chunk.vertices.push_back(index);
+      }
+      chunk.indices.push_back(chunkIndices[index]);
+    }
+  }
+  return chunks;
+}
+
+/**
+ * A quadric measuring the sum of squared distances to a set of planes, each
+ * weighted by the area of the triangle it came from.
+ */
+class Quadric {
+ public:
+  double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+  double b0 = 0, b1 = 0, b2 = 0, c = 0;
+  double weight = 0;
+
+  void addPlane(const double* normal, double distance, double planeWeight) {
+    a00 += planeWeight * normal[0] * normal[0];
+    a01 += planeWeight * normal[0] * normal[1];
+    a02 += planeWeight * normal[0] * normal[2];
+    a11 += planeWeight * normal[1] * normal[1];
+    a12 += planeWeight * normal[1] * normal[2];
+    a22 += planeWeight * normal[2] * normal[2];
+    b0 += planeWeight * normal[0] * distance;
+    b1 += planeWeight * normal[1] * distance;
+    b2 += planeWeight * normal[2] * distance;
+    c += planeWeight * distance * distance;
+    weight += planeWeight;
+  }
+
+  void add(const Quadric& quadric) {
+    a00 += quadric.a00;
+    a01 += quadric.a01;
+    a02 += quadric.a02;
+    a11 += quadric.a11;
+    a12 += quadric.a12;
+    a22 += quadric.a22;
+    b0 += quadric.b0;
+    b1 += quadric.b1;
+    b2 += quadric.b2;
+    c += quadric.c;
+    weight += quadric.weight;
+  }
+
+  /** Gets the weighted mean squared distance of a point to the planes. */
+  double getError(const float* point) const {
+    double x = point[0], y = point[1], z = point[2];
+    double error = a00 * x * x + a11 * y * y + a22 * z * z +
+                   2 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                   2 * (b0 * x + b1 * y + b2 * z) + c;
+    return weight > 0 ? std::fabs(error) / weight : 0;
+  }
+};
+
+/**
+ * Gets the normal of a triangle, scaled by twice its area.
+ */
+void getTriangleNormal(const float* p0, const float* p1, const float* p2,
+                       double* normal) {
+  double u[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+  double v[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+  normal[0] = u[1] * v[2] - u[2] * v[1];
+  normal[1] = u[2] * v[0] - u[0] * v[2];
+  normal[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+/**
+ * An edge collapse moving vertex `from` onto vertex `to`.
+ */
+class Collapse {
+ public:
+  unsigned int from;
+  unsigned int to;
+  double error;
+};
+
+std::vector<unsigned int> GLTF::MeshOptimizer::simplify(
+    const std::vector<unsigned int>& indices,
+    const std::vector<float>& positions, size_t targetIndexCount,
+    float targetError) {
+  std::vector<unsigned int> triangles = indices;
+  size_t vertexCount = positions.size() / 3;
+  float extent = 0;
+  if (vertexCount > 0) {
+    for (size_t k = 0; k < 3; k++) {
+      float minimum = positions[k];
+      float maximum = positions[k];
+      for (size_t v = 1; v < vertexCount; v++) {
+        minimum = std::min(minimum, positions[v * 3 + k]);
+        maximum = std::max(maximum, positions[v * 3 + k]);
+      }
+      extent = std::max(extent, maximum - minimum);
+    }
+  }
+  double errorLimit = static_cast<double>(targetError) * extent;
+  errorLimit *= errorLimit;
+
+  std::vector<Quadric> quadrics(vertexCount);
+  for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+    const float* p0 = &positions[triangles[i] * 3];
+    double normal[3];
+    getTriangleNormal(p0, &positions[triangles[i + 1] * 3],
+                      &positions[triangles[i + 2] * 3], normal);
+    double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] +
+                              normal[2] * normal[2]);
+    if (length == 0) {
+      continue;
+    }
+    for (double& component : normal) {
+      component /= length;
+    }
+    double distance = -(normal[0] * p0[0] + normal[1] * p0[1] +
+                        normal[2] * p0[2]);
+    for (size_t k = 0; k < 3; k++) {
+      quadrics[triangles[i + k]].addPlane(normal, distance, length / 2);
+    }
+  }
+
+  // Lock vertices on edges used by only one triangle, or by triangles that
+  // don't agree on its direction
+  std::unordered_map<uint64_t, int> edgeCounts;
+  for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+    for (size_t k = 0; k < 3; k++) {
+      uint64_t a = triangles[i + k];
+      uint64_t b = triangles[i + (k + 1) % 3];
+      edgeCounts[(a << 32) | b]++;
+    }
+  }
+  std::vector<bool> locked(vertexCount, false);
+  for (const auto& edgeCount : edgeCounts) {
+    uint64_t a = edgeCount.first >> 32;
+    uint64_t b = edgeCount.first & 0xffffffff;
+    auto oppositePtr = edgeCounts.find((b << 32) | a);
+    if (edgeCount.second != 1 || oppositePtr == edgeCounts.end() ||
+        oppositePtr->second != 1) {
+      locked[a] = true;
+      locked[b] = true;
+    }
+  }
+
+  std::vector<unsigned int> remap(vertexCount);
+  std::vector<bool> changed(vertexCount);
+  std::vector<std::vector<size_t>> vertexTriangles(vertexCount);
+  while (triangles.size() > targetIndexCount) {
+    for (std::vector<size_t>& adjacent : vertexTriangles) {
+      adjacent.clear();
+    }
+    std::vector<Collapse> collapses;
+    for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+      for (size_t k = 0; k < 3; k++) {
+        unsigned int a = triangles[i + k];
+        unsigned int b = triangles[i + (k + 1) % 3];
+        vertexTriangles[a].push_back(i);
+        // Each interior edge is seen once in each direction
+        if (a > b) {
+          continue;
+        }
+        Quadric quadric = quadrics[a];
+        quadric.add(quadrics[b]);
+        double errorAB = locked[a] ? -1 : quadric.getError(&positions[b * 3]);
+        double errorBA = locked[b] ? -1 : quadric.getError(&positions[a * 3]);
+        if (errorAB >= 0 && (errorBA < 0 || errorAB <= errorBA)) {
+          collapses.push_back({a, b, errorAB});
+        } else if (errorBA >= 0) {
+          collapses.push_back({b, a, errorBA});
+        }
+      }
+    }
+    std::stable_sort(collapses.begin(), collapses.end(),
+                     [](const Collapse& x, const Collapse& y) {
+                       return x.error < y.error;
+                     });
+
+    for (size_t v = 0; v < vertexCount; v++) {
+      remap[v] = static_cast<unsigned int>(v);
+    }
+    std::fill(changed.begin(), changed.end(), false);
+    size_t removedIndexCount = 0;
+    size_t collapseCount = 0;
+    for (const Collapse& collapse : collapses) {
+      if (collapse.error > errorLimit ||
+          triangles.size() - removedIndexCount <= targetIndexCount) {
+        break;
+      }
+      if (changed[collapse.from] || changed[collapse.to]) {
+        continue;
+      }
+      // Reject collapses that would flip a triangle around the moved vertex
+      bool flips = false;
+      size_t removedTriangles = 0;
+      for (size_t t : vertexTriangles[collapse.from]) {
+        unsigned int* triangle = &triangles[t];
+        if (triangle[0] == collapse.to || triangle[1] == collapse.to ||
+            triangle[2] == collapse.to) {
+          removedTriangles++;
+          continue;
+        }
+        const float* p[3];
+        for (size_t k = 0; k < 3; k++) {
+          p[k] = &positions[triangle[k] * 3];
+        }
+        double before[3];
+        getTriangleNormal(p[0], p[1], p[2], before);
+        for (size_t k = 0; k < 3; k++) {
+          if (triangle[k] == collapse.from) {
+            p[k] = &positions[collapse.to * 3];
+          }
+        }
+        double after[3];
+        getTriangleNormal(p[0], p[1], p[2], after);
+        if (before[0] * after[0] + before[1] * after[1] +
+                before[2] * after[2] <=
+            0) {
+          flips = true;
+          break;
+        }
+      }
+      if (flips) {
+        continue;
+      }
+      remap[collapse.from] = collapse.to;
+      quadrics[collapse.to].add(quadrics[collapse.from]);
+      // Keep the neighbourhood fixed for the rest of this pass, so that the
+      // flip checks above stay valid
+      for (size_t t : vertexTriangles[collapse.from]) {
+        for (size_t k = 0; k < 3; k++) {
+          changed[triangles[t + k]] = true;
+        }
+      }
+      for (size_t t : vertexTriangles[collapse.to]) {
+        for (size_t k = 0; k < 3; k++) {
+          changed[triangles[t + k]] = true;
+        }
+      }
+      removedIndexCount += removedTriangles * 3;
+      collapseCount++;
+    }
+    if (collapseCount == 0) {
+      break;
+    }
+    for (unsigned int& index : triangles) {
+      index = remap[index];
+    }
+    removeDegenerateTriangles(&triangles);
+  }
+  return triangles;
+}
@@ -0,0 +1,600 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "GLTFMeshoptCodec.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+const unsigned char VERTEX_HEADER = 0xa0;
+const unsigned char INDEX_HEADER = 0xe1;
+const unsigned char SEQUENCE_HEADER = 0xd1;
+
+const size_t BYTE_GROUP_SIZE = 16;
+const size_t VERTEX_BLOCK_BYTES = 8192;
+const size_t VERTEX_BLOCK_MAX_SIZE = 256;
+const size_t TAIL_SIZE = 32;
+
+/**
+ * Index encoding version 1 codes a third vertex one before or after the last
+ * free index with 13 and 14, so only 13 vertex FIFO entries can be referenced.
+ */
+const int FIFO_REFERENCE_MAX = 13;
+
+/**
+ * Pairs of vertex FIFO references for the second and third vertex of a new
+ * triangle, which are coded in the triangle's code byte when listed here.
+ * The table is written at the end of the stream for the decoder.
+ */
+const unsigned char CODE_AUX_TABLE[16] = {0x00, 0x76, 0x87, 0x56, 0x67, 0x78,
+                                          0xa9, 0x86, 0x65, 0x89, 0x68, 0x98,
+                                          0x01, 0x69, 0x00, 0x00};
+
+const unsigned int TRIANGLE_ROTATIONS[3][3] = {{0, 1, 2}, {1, 2, 0}, {2, 0, 1}};
+
+size_t getVertexBlockSize(size_t byteStride) {
+  size_t blockSize = (VERTEX_BLOCK_BYTES / byteStride) & ~(BYTE_GROUP_SIZE - 1);
+  return std::min(blockSize, VERTEX_BLOCK_MAX_SIZE);
+}
+
+unsigned char zigzag(unsigned char value) {
+  return static_cast<unsigned char>((static_cast<signed char>(value) >> 7) ^
+                                    (value << 1));
+}
+
+unsigned char unzigzag(unsigned char value) {
+  return static_cast<unsigned char>(-(value & 1) ^ (value >> 1));
+}
+
+/**
+ * Gets the encoded length of a group of 16 bytes packed into `bits` bits
+ * each, where 0 bits means every byte is zero. Bytes that don't fit are
+ * written in full after the packed bits.
+ */
+size_t measureByteGroup(const unsigned char* group, int bits) {
+  if (bits == 0) {
+    for (size_t i = 0; i < BYTE_GROUP_SIZE; i++) {
+      if (group[i] != 0) {
+        return SIZE_MAX;
+      }
+    }
+    return 0;
+  }
+  if (bits == 8) {
+    return BYTE_GROUP_SIZE;
+  }
+  size_t length = BYTE_GROUP_SIZE * bits / 8;
+  unsigned int sentinel = (1 << bits) - 1;
+  for (size_t i = 0; i < BYTE_GROUP_SIZE; i++) {
+    length += group[i] >= sentinel;
+  }
+  return length;
+}
+
+void encodeByteGroup(const unsigned char* group, int bits,
+                     std::vector<unsigned char>* data) {
+  if (bits == 0) {
+    return;
+  }
+  if (bits == 8) {
+    data->insert(data->end(), group, group + BYTE_GROUP_SIZE);
+    return;
+  }
+  size_t valuesPerByte = 8 / bits;
+  unsigned char sentinel = static_cast<unsigned char>((1 << bits) - 1);
+  for (size_t i = 0; i < BYTE_GROUP_SIZE; i += valuesPerByte) {
+    unsigned char byte = 0;
+    for (size_t k = 0; k < valuesPerByte; k++) {
+      byte = static_cast<unsigned char>(byte << bits);
+      byte |= std::min(group[i + k], sentinel);
+    }
+    data->push_back(byte);
+  }
+  for (size_t i = 0; i < BYTE_GROUP_SIZE; i++) {
+    if (group[i] >= sentinel) {
+      data->push_back(group[i]);
+    }
+  }
+}
+
+/**
+ * Writes a header of 2 bits per group, selecting 0, 2, 4 or 8 bits, followed
+ * by the groups packed with the shortest encoding.
+ */
+void encodeBytes(const unsigned char* bytes, size_t count,
+                 std::vector<unsigned char>* data) {
+  const int groupBits[4] = {0, 2, 4, 8};
+  size_t groupCount = count / BYTE_GROUP_SIZE;
+  size_t headerOffset = data->size();
+  data->resize(headerOffset + (groupCount + 3) / 4, 0);
+  for (size_t g = 0; g < groupCount; g++) {
+    const unsigned char* group = bytes + g * BYTE_GROUP_SIZE;
+    int best = 3;
+    size_t bestLength = measureByteGroup(group, groupBits[best]);
+    for (int i = 0; i < 3; i++) {
+      size_t length = measureByteGroup(group, groupBits[i]);
+      if (length < bestLength) {
+        best = i;
+        bestLength = length;
+      }
+    }
+    (*data)[headerOffset + g / 4] |=
+        static_cast<unsigned char>(best << ((g % 4) * 2));
+    encodeByteGroup(group, groupBits[best], data);
+  }
+}
+
+bool decodeBytes(const std::vector<unsigned char>& data, size_t* offset,
+                 unsigned char* bytes, size_t count) {
+  size_t groupCount = count / BYTE_GROUP_SIZE;
+  size_t header = *offset;
+  *offset += (groupCount + 3) / 4;
+  for (size_t g = 0; g < groupCount; g++) {
+    if (*offset > data.size()) {
+      return false;
+    }
+    int bitsLog2 = (data[header + g / 4] >> ((g % 4) * 2)) & 3;
+    unsigned char* group = bytes + g * BYTE_GROUP_SIZE;
+    if (bitsLog2 == 0) {
+      std::memset(group, 0, BYTE_GROUP_SIZE);
+      continue;
+    }
+    int bits = 1 << bitsLog2;
+    if (bits == 8) {
+      if (*offset + BYTE_GROUP_SIZE > data.size()) {
+        return false;
+      }
+      std::memcpy(group, &data[*offset], BYTE_GROUP_SIZE);
+      *offset += BYTE_GROUP_SIZE;
+      continue;
+    }
+    size_t valuesPerByte = 8 / bits;
+    unsigned char sentinel = static_cast<unsigned char>((1 << bits) - 1);
+    size_t extra = *offset + BYTE_GROUP_SIZE / valuesPerByte;
+    for (size_t i = 0; i < BYTE_GROUP_SIZE; i++) {
+      size_t byte = *offset + i / valuesPerByte;
+      int shift =
+          static_cast<int>(valuesPerByte - 1 - i % valuesPerByte) * bits;
+      if (byte >= data.size()) {
+        return false;
+      }
+      unsigned char value = (data[byte] >> shift) & sentinel;
+      if (value == sentinel) {
+        if (extra >= data.size()) {
+          return false;
+        }
+        value = data[extra++];
+      }
+      group[i] = value;
+    }
+    *offset = extra;
+  }
+  return *offset <= data.size();
+}
+
+void encodeVarint(unsigned int value, std::vector<unsigned char>* data) {
+  do {
+    data->push_back(static_cast<unsigned char>((value & 127) |
+                                               (value > 127 ? 128 : 0)));
+    value >>= 7;
+  } while (value != 0);
+}
+
+bool decodeVarint(const std::vector<unsigned char>& data, size_t* offset,
+                  unsigned int* value) {
+  *value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (*offset >= data.size()) {
+      return false;
+    }
+    unsigned char byte = data[(*offset)++];
+    *value |= static_cast<unsigned int>(byte & 127) << shift;
+    if (byte < 128) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/** Codes an index as a zigzag varint delta from the last free index. */
+void encodeIndex(unsigned int index, unsigned int last,
+                 std::vector<unsigned char>* data) {
+  unsigned int delta = index - last;
+  encodeVarint((delta << 1) ^ (0u - (delta >> 31)), data);
+}
+
+bool decodeIndex(const std::vector<unsigned char>& data, size_t* offset,
+                 unsigned int* last) {
+  unsigned int value;
+  if (!decodeVarint(data, offset, &value)) {
+    return false;
+  }
+  *last += (value >> 1) ^ (0u - (value & 1));
+  return true;
+}
+
+/**
+ * The 16 most recent edges and vertices of the triangles coded so far.
+ */
+class TriangleFifos {
+ public:
+  unsigned int edges[16][2];
+  unsigned int vertices[16];
+  size_t edgeOffset = 0;
+  size_t vertexOffset = 0;
+
+  TriangleFifos() {
+    std::memset(edges, -1, sizeof(edges));
+    clearVertices();
+  }
+
+  void clearVertices() { std::memset(vertices, -1, sizeof(vertices)); }
+
+  /**
+   * Finds an edge of triangle abc, most recent first.
+   * @return The FIFO position of the edge times 4, plus the rotation that
+   * makes it the triangle's first edge, or -1
+   */
+  int findEdge(unsigned int a, unsigned int b, unsigned int c) const {
+    for (int i = 0; i < 16; i++) {
+      const unsigned int* edge = edges[(edgeOffset - 1 - i) & 15];
+      if (edge[0] == a && edge[1] == b) {
+        return i << 2;
+      } else if (edge[0] == b && edge[1] == c) {
+        return (i << 2) | 1;
+      } else if (edge[0] == c && edge[1] == a) {
+        return (i << 2) | 2;
+      }
+    }
+    return -1;
+  }
+
+  /** @return The FIFO position of a vertex, most recent first, or -1 */
+  int findVertex(unsigned int vertex) const {
+    for (int i = 0; i < 16; i++) {
+      if (vertices[(vertexOffset - 1 - i) & 15] == vertex) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  void pushEdge(unsigned int a, unsigned int b) {
+    edges[edgeOffset][0] = a;
+    edges[edgeOffset][1] = b;
+    edgeOffset = (edgeOffset + 1) & 15;
+  }
+
+  void pushVertex(unsigned int vertex) {
+    vertices[vertexOffset] = vertex;
+    vertexOffset = (vertexOffset + 1) & 15;
+  }
+};
+
+int findCodeAux(unsigned char codeAux) {
+  for (int i = 0; i < 16; i++) {
+    if (CODE_AUX_TABLE[i] == codeAux) {
+      return i;
+    }
+  }
+  return -1;
+}
+std::vector<unsigned char> GLTF::MeshoptCodec::encodeVertexBuffer(
+    const unsigned char* vertices, size_t count, size_t byteStride) {
+  std::vector<unsigned char> data;
+  data.push_back(VERTEX_HEADER);
+  std::vector<unsigned char> firstVertex(byteStride, 0);
+  if (count > 0) {
+    std::memcpy(firstVertex.data(), vertices, byteStride);
+  }
+  std::vector<unsigned char> lastVertex = firstVertex;
+  size_t blockSize = getVertexBlockSize(byteStride);
+  std::vector<unsigned char> deltas(blockSize);
+  for (size_t begin = 0; begin < count; begin += blockSize) {
+    size_t blockCount = std::min(blockSize, count - begin);
+    size_t alignedCount =
+        (blockCount + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1);
+    const unsigned char* block = vertices + begin * byteStride;
+    for (size_t k = 0; k < byteStride; k++) {
+      unsigned char previous = lastVertex[k];
+      for (size_t i = 0; i < blockCount; i++) {
+        unsigned char value = block[i * byteStride + k];
+        deltas[i] = zigzag(static_cast<unsigned char>(value - previous));
+        previous = value;
+      }
+      std::fill(deltas.begin() + blockCount, deltas.begin() + alignedCount, 0);
+      encodeBytes(deltas.data(), alignedCount, &data);
+    }
+    std::memcpy(lastVertex.data(), block + (blockCount - 1) * byteStride,
+                byteStride);
+  }
+  // The first vertex is the baseline of the first block; the tail is padded
+  // so that decoders can read ahead without bounds checks
+  if (byteStride < TAIL_SIZE) {
+    data.resize(data.size() + TAIL_SIZE - byteStride, 0);
+  }
+  data.insert(data.end(), firstVertex.begin(), firstVertex.end());
+  return data;
+}
+
+std::vector<unsigned char> GLTF::MeshoptCodec::encodeIndexBuffer(
+    const unsigned int* indices, size_t count) {
+  std::vector<unsigned char> codes;
+  std::vector<unsigned char> data;
+  codes.reserve(count / 3 + 1);
+  codes.push_back(INDEX_HEADER);
+  TriangleFifos fifos;
+  unsigned int next = 0;
+  unsigned int last = 0;
+
+  for (size_t i = 0; i + 2 < count; i += 3) {
+    const unsigned int* triangle = indices + i;
+    int edge = fifos.findEdge(triangle[0], triangle[1], triangle[2]);
+    if (edge >= 0 && (edge >> 2) < 15) {
+      // The triangle shares a recent edge, so only its third vertex is coded
+      const unsigned int* rotation = TRIANGLE_ROTATIONS[edge & 3];
+      unsigned int a = triangle[rotation[0]];
+      unsigned int b = triangle[rotation[1]];
+      unsigned int c = triangle[rotation[2]];
+      int fifoC = fifos.findVertex(c);
+      int codeC = 15;
+      if (fifoC >= 1 && fifoC < FIFO_REFERENCE_MAX) {
+        codeC = fifoC;
+      } else if (c == next) {
+        codeC = 0;
+        next++;
+      } else if (c + 1 == last) {
+        codeC = 13;
+        last = c;
+      } else if (c == last + 1) {
+        codeC = 14;
+        last = c;
+      }
+      codes.push_back(static_cast<unsigned char>(((edge >> 2) << 4) | codeC));
+      if (codeC == 15) {
+        encodeIndex(c, last, &data);
+        last = c;
+      }
+      if (codeC == 0 || codeC >= FIFO_REFERENCE_MAX) {
+        fifos.pushVertex(c);
+      }
+      fifos.pushEdge(c, b);
+      fifos.pushEdge(a, c);
+      continue;
+    }
+
+    // Rotate the next new vertex, if any, to the front
+    int rotationIndex =
+        triangle[1] == next ? 1 : (triangle[2] == next ? 2 : 0);
+    const unsigned int* rotation = TRIANGLE_ROTATIONS[rotationIndex];
+    unsigned int a = triangle[rotation[0]];
+    unsigned int b = triangle[rotation[1]];
+    unsigned int c = triangle[rotation[2]];
+    // Restarting the numbering at 0, 1, 2 is coded as a reset
+    bool reset = a == 0 && b == 1 && c == 2 && next > 0;
+    if (reset) {
+      next = 0;
+      fifos.clearVertices();
+    }
+    int fifoB = fifos.findVertex(b);
+    int fifoC = fifos.findVertex(c);
+    int codeA = 15;
+    if (a == next) {
+      codeA = 0;
+      next++;
+    }
+    int codeB = 15;
+    if (fifoB >= 0 && fifoB < 14) {
+      codeB = fifoB + 1;
+    } else if (b == next) {
+      codeB = 0;
+      next++;
+    }
+    int codeC = 15;
+    if (fifoC >= 0 && fifoC < 14) {
+      codeC = fifoC + 1;
+    } else if (c == next) {
+      codeC = 0;
+      next++;
+    }
+    unsigned char codeAux = static_cast<unsigned char>((codeB << 4) | codeC);
+    int codeAuxIndex = findCodeAux(codeAux);
+    if (codeA == 0 && codeAuxIndex >= 0 && codeAuxIndex < 14 && !reset) {
+      codes.push_back(static_cast<unsigned char>(0xf0 | codeAuxIndex));
+    } else {
+      codes.push_back(static_cast<unsigned char>(0xf0 | 14 | codeA));
+      data.push_back(codeAux);
+    }
+    for (const auto& vertex :
+         {std::make_pair(a, codeA), std::make_pair(b, codeB),
+          std::make_pair(c, codeC)}) {
+      if (vertex.second == 15) {
+        encodeIndex(vertex.first, last, &data);
+        last = vertex.first;
+      }
+    }
+    for (const auto& vertex :
+         {std::make_pair(a, codeA), std::make_pair(b, codeB),
+          std::make_pair(c, codeC)}) {
+      if (vertex.second == 0 || vertex.second == 15) {
+        fifos.pushVertex(vertex.first);
+      }
+    }
+    fifos.pushEdge(b, a);
+    fifos.pushEdge(c, b);
+    fifos.pushEdge(a, c);
+  }
+
+  // The table also pads the stream, so that decoders can read a triangle's
+  // worst case of 16 bytes without bounds checks
+  codes.insert(codes.end(), data.begin(), data.end());
+  codes.insert(codes.end(), CODE_AUX_TABLE, CODE_AUX_TABLE + 16);
+  return codes;
+}
+
+std::vector<unsigned char> GLTF::MeshoptCodec::encodeIndexSequence(
+    const unsigned int* indices, size_t count) {
+  std::vector<unsigned char> data;
+  data.push_back(SEQUENCE_HEADER);
+  unsigned int last[2] = {0, 0};
+  unsigned int current = 0;
+  for (size_t i = 0; i < count; i++) {
+    unsigned int index = indices[i];
+    // Switch baselines when the delta is too large for a single byte, which
+    // suits lists alternating between two ranges of indices
+    int delta = static_cast<int>(index - last[current]);
+    if ((delta < 0 ? -delta : delta) >= 30) {
+      current ^= 1;
+    }
+    unsigned int difference = index - last[current];
+    unsigned int value = (difference << 1) ^ (0u - (difference >> 31));
+    encodeVarint((value << 1) | current, &data);
+    last[current] = index;
+  }
+  data.insert(data.end(), 4, 0);
+  return data;
+}
+
+bool GLTF::MeshoptCodec::decodeVertexBuffer(
+    unsigned char* vertices, size_t count, size_t byteStride,
+    const std::vector<unsigned char>& data) {
+  size_t tailSize = std::max(byteStride, TAIL_SIZE);
+  if (data.size() < 1 + tailSize || data[0] != VERTEX_HEADER) {
+    return false;
+  }
+  std::vector<unsigned char> lastVertex(data.end() - byteStride, data.end());
+  size_t blockSize = getVertexBlockSize(byteStride);
+  std::vector<unsigned char> deltas(blockSize);
+  size_t offset = 1;
+  for (size_t begin = 0; begin < count; begin += blockSize) {
+    size_t blockCount = std::min(blockSize, count - begin);
+    size_t alignedCount =
+        (blockCount + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1);
+    unsigned char* block = vertices + begin * byteStride;
+    for (size_t k = 0; k < byteStride; k++) {
+      if (!decodeBytes(data, &offset, deltas.data(), alignedCount)) {
+        return false;
+      }
+      unsigned char value = lastVertex[k];
+      for (size_t i = 0; i < blockCount; i++) {
+        value = static_cast<unsigned char>(value + unzigzag(deltas[i]));
+        block[i * byteStride + k] = value;
+      }
+      lastVertex[k] = value;
+    }
+  }
+  return offset + tailSize == data.size();
+}
+
+bool GLTF::MeshoptCodec::decodeIndexBuffer(
+    unsigned int* indices, size_t count,
+    const std::vector<unsigned char>& data) {
+  if (count % 3 != 0 || data.size() < 1 + count / 3 + 16 ||
+      data[0] != INDEX_HEADER) {
+    return false;
+  }
+  const unsigned char* codeAuxTable = &data[data.size() - 16];
+  size_t code = 1;
+  size_t offset = 1 + count / 3;
+  TriangleFifos fifos;
+  unsigned int next = 0;
+  unsigned int last = 0;
+
+  for (size_t i = 0; i < count; i += 3) {
+    unsigned char triangleCode = data[code++];
+    unsigned int a, b, c;
+    if (triangleCode < 0xf0) {
+      const unsigned int* edge =
+          fifos.edges[(fifos.edgeOffset - 1 - (triangleCode >> 4)) & 15];
+      a = edge[0];
+      b = edge[1];
+      int codeC = triangleCode & 15;
+      if (codeC == 0) {
+        c = next++;
+      } else if (codeC < FIFO_REFERENCE_MAX) {
+        c = fifos.vertices[(fifos.vertexOffset - 1 - codeC) & 15];
+      } else if (codeC == 13) {
+        c = --last;
+      } else if (codeC == 14) {
+        c = ++last;
+      } else if (!decodeIndex(data, &offset, &last)) {
+        return false;
+      } else {
+        c = last;
+      }
+      if (codeC == 0 || codeC >= FIFO_REFERENCE_MAX) {
+        fifos.pushVertex(c);
+      }
+      fifos.pushEdge(c, b);
+      fifos.pushEdge(a, c);
+    } else {
+      int codeA = 0;
+      unsigned char codeAux;
+      if (triangleCode < 0xfe) {
+        codeAux = codeAuxTable[triangleCode & 15];
+      } else {
+        codeA = triangleCode == 0xfe ? 0 : 15;
+        if (offset >= data.size()) {
+          return false;
+        }
+        codeAux = data[offset++];
+        if (codeA == 0 && codeAux == 0) {
+          next = 0;
+          fifos.clearVertices();
+        }
+      }
+      int codeB = codeAux >> 4;
+      int codeC = codeAux & 15;
+      unsigned int* vertices[3] = {&a, &b, &c};
+      int vertexCodes[3] = {codeA, codeB, codeC};
+      for (int k = 0; k < 3; k++) {
+        int vertexCode = vertexCodes[k];
+        if (vertexCode == 0) {
+          *vertices[k] = next++;
+        } else if (vertexCode < 15) {
+          *vertices[k] = fifos.vertices[(fifos.vertexOffset - vertexCode) & 15];
+        }
+      }
+      for (int k = 0; k < 3; k++) {
+        if (vertexCodes[k] == 15) {
+          if (!decodeIndex(data, &offset, &last)) {
+            return false;
+          }
+          *vertices[k] = last;
+        }
+      }
+      for (int k = 0; k < 3; k++) {
+        if (vertexCodes[k] == 0 || vertexCodes[k] == 15) {
+          fifos.pushVertex(*vertices[k]);
+        }
+      }
+      fifos.pushEdge(b, a);
+      fifos.pushEdge(c, b);
+      fifos.pushEdge(a, c);
+    }
+    indices[i] = a;
+    indices[i + 1] = b;
+    indices[i + 2] = c;
+  }
+  return offset + 16 == data.size();
+}
+
+bool GLTF::MeshoptCodec::decodeIndexSequence(
+    unsigned int* indices, size_t count,
+    const std::vector<unsigned char>& data) {
+  if (data.size() < 1 + count + 4 || data[0] != SEQUENCE_HEADER) {
+    return false;
+  }
+  unsigned int last[2] = {0, 0};
+  size_t offset = 1;
+  for (size_t i = 0; i < count; i++) {
+    unsigned int value;
+    if (!decodeVarint(data, &offset, &value)) {
+      return false;
+    }
+    unsigned int current = value & 1;
+    value >>= 1;
+    last[current] += (value >> 1) ^ (0u - (value & 1));
+    indices[i] = last[current];
+  }
+  return offset + 4 == data.size();
+}
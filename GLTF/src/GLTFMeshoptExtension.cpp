@@ -0,0 +1,39 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "GLTFMeshoptExtension.h"
+
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+std::string GLTF::MeshoptExtension::getModeName(Mode mode) {
+  switch (mode) {
+    case Mode::TRIANGLES:
+      return "TRIANGLES";
+    case Mode::INDICES:
+      return "INDICES";
+    default:
+      return "ATTRIBUTES";
+  }
+}
+
+void GLTF::MeshoptExtension::writeJSON(void* writer,
+                                        GLTF::Options* /* options */) {
+  rapidjson::Writer<rapidjson::StringBuffer>* jsonWriter =
+      (rapidjson::Writer<rapidjson::StringBuffer>*)writer;
+  if (this->fallback) {
+    jsonWriter->Key("fallback");
+    jsonWriter->Bool(true);
+    return;
+  }
+  jsonWriter->Key("buffer");
+  jsonWriter->Int(this->buffer->id);
+  jsonWriter->Key("byteOffset");
+  jsonWriter->Uint64(this->byteOffset);
+  jsonWriter->Key("byteLength");
+  jsonWriter->Uint64(this->byteLength);
+  jsonWriter->Key("byteStride");
+  jsonWriter->Int(this->byteStride);
+  jsonWriter->Key("count");
+  jsonWriter->Uint64(this->count);
+  jsonWriter->Key("mode");
+  jsonWriter->String(getModeName(this->mode).c_str());
+}
@@ -3,9 +3,12 @@
 
 #include <cmath>
 
+#include "GLTFLodExtension.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
 
+GLTF::Node::Transform::~Transform() {}
+
 GLTF::Node::TransformMatrix::TransformMatrix() {
   this->type = GLTF::Node::Transform::MATRIX;
   this->matrix[0] = 1;
@@ -385,5 +388,21 @@ void GLTF::Node::writeJSON(void* writer, GLTF::Options* options) {
       jsonWriter->Int(camera->id);
     }
   }
+  auto lodExtensionPtr = extensions.find("MSFT_lod");
+  if (lodExtensionPtr != extensions.end() && extras.size() == 0) {
+    GLTF::LodExtension* lodExtension =
+        static_cast<GLTF::LodExtension*>(lodExtensionPtr->second);
+    if (lodExtension->screenCoverage.size() > 0) {
+      jsonWriter->Key("extras");
+      jsonWriter->StartObject();
+      jsonWriter->Key("MSFT_screencoverage");
+      jsonWriter->StartArray();
+      for (float coverage : lodExtension->screenCoverage) {
+        jsonWriter->Double(coverage);
+      }
+      jsonWriter->EndArray();
+      jsonWriter->EndObject();
+    }
+  }
   GLTF::Object::writeJSON(writer, options);
 }
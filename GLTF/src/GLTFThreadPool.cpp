@@ -0,0 +1,145 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "GLTFThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+thread_local GLTF::ThreadPool* currentThreadPool = NULL;
+thread_local size_t currentQueueIndex = 0;
+
+GLTF::ThreadPool::ThreadPool(size_t threadCount) {
+  if (threadCount < 1) {
+    threadCount = 1;
+  }
+  for (size_t i = 0; i < threadCount; i++) {
+    _queues.emplace_back(new TaskQueue());
+  }
+  for (size_t i = 0; i < threadCount; i++) {
+    _threads.emplace_back(&GLTF::ThreadPool::run, this, i);
+  }
+}
+
+GLTF::ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _condition.notify_all();
+  for (std::thread& thread : _threads) {
+    thread.join();
+  }
+}
+
+size_t GLTF::ThreadPool::size() const { return _threads.size(); }
+
+void GLTF::ThreadPool::push(std::function<void()> task) {
+  size_t queueIndex;
+  bool waiting;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (currentThreadPool == this) {
+      queueIndex = currentQueueIndex;
+    } else {
+      queueIndex = _nextQueue;
+      _nextQueue = (_nextQueue + 1) % _queues.size();
+    }
+    _pending++;
+    waiting = _waiting > 0;
+  }
+  TaskQueue* queue = _queues[queueIndex].get();
+  {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    queue->tasks.push_back(std::move(task));
+  }
+  _condition.notify_one();
+  if (waiting) {
+    _waitCondition.notify_all();
+  }
+}
+
+bool GLTF::ThreadPool::popTask(size_t queueIndex,
+                               std::function<void()>* task) {
+  // Take the most recently pushed task from our own queue, then steal the
+  // oldest task from the others
+  size_t queueCount = _queues.size();
+  for (size_t i = 0; i < queueCount; i++) {
+    TaskQueue* queue = _queues[(queueIndex + i) % queueCount].get();
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!queue->tasks.empty()) {
+      if (i == 0) {
+        *task = std::move(queue->tasks.back());
+        queue->tasks.pop_back();
+      } else {
+        *task = std::move(queue->tasks.front());
+        queue->tasks.pop_front();
+      }
+      lock.unlock();
+      std::unique_lock<std::mutex> pendingLock(_mutex);
+      _pending--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void GLTF::ThreadPool::runTask(std::function<void()>* task) {
+  (*task)();
+  // The task's future is ready now; wake threads that may be waiting on it.
+  // Taking the lock orders this after a waiter's check of the future.
+  bool waiting;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    waiting = _waiting > 0;
+  }
+  if (waiting) {
+    _waitCondition.notify_all();
+  }
+}
+
+void GLTF::ThreadPool::run(size_t queueIndex) {
+  currentThreadPool = this;
+  currentQueueIndex = queueIndex;
+  while (true) {
+    std::function<void()> task;
+    if (popTask(queueIndex, &task)) {
+      runTask(&task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(_mutex);
+    _condition.wait(lock, [this] { return _stop || _pending > 0; });
+    if (_stop && _pending == 0) {
+      return;
+    }
+  }
+}
+
+bool GLTF::ThreadPool::runPendingTask() {
+  std::function<void()> task;
+  size_t queueIndex = currentThreadPool == this ? currentQueueIndex : 0;
+  if (popTask(queueIndex, &task)) {
+    runTask(&task);
+    return true;
+  }
+  return false;
+}
+
+void GLTF::ThreadPool::parallelFor(
+    size_t count, const std::function<void(size_t)>& function) {
+  std::atomic<size_t> next(0);
+  auto work = [&next, count, &function]() {
+    size_t index;
+    while ((index = next++) < count) {
+      function(index);
+    }
+  };
+  std::vector<std::future<void>> futures;
+  size_t helperCount = std::min(count, size());
+  for (size_t i = 0; i < helperCount; i++) {
+    futures.push_back(submit(work));
+  }
+  work();
+  for (std::future<void>& future : futures) {
+    wait(future);
+    future.get();
+  }
+}
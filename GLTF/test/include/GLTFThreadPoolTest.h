@@ -0,0 +1,6 @@
+// Copyright 2020 The Khronos® Group Inc.
+#pragma once
+
+#include "gtest/gtest.h"
+
+class GLTFThreadPoolTest : public ::testing::Test {};
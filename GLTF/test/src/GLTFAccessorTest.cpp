@@ -1,7 +1,16 @@
 // Copyright 2020 The Khronos® Group Inc.
 #include "GLTFAccessorTest.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "GLTFAccessor.h"
+#include "GLTFAccessorView.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
 
 TEST(GLTFAccessorTest, CreateFromData) {
   float points[12] = {1.0, 2.0, 3.0, 4.0,  5.0,  6.0,
@@ -9,6 +18,9 @@ TEST(GLTFAccessorTest, CreateFromData) {
   GLTF::Accessor* accessor = new GLTF::Accessor(
       GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
       (unsigned char*)points, 4, GLTF::Constants::WebGL::ARRAY_BUFFER);
+  // Bounds are computed on demand
+  EXPECT_TRUE(accessor->min == NULL);
+  accessor->computeMinMax();
   float* min = accessor->min;
   ASSERT_TRUE(min != NULL);
   EXPECT_EQ(min[0], 1.0);
@@ -22,7 +34,7 @@ TEST(GLTFAccessorTest, CreateFromData) {
   EXPECT_EQ(max[2], 12.0);
 
   float component[3];
-  for (int i = 0; i < accessor->count; i++) {
+  for (size_t i = 0; i < accessor->count; i++) {
     accessor->getComponentAtIndex(i, component);
     EXPECT_EQ(component[0], i * 3 + 1);
     EXPECT_EQ(component[1], i * 3 + 2);
@@ -43,6 +55,9 @@ TEST(GLTFAccessorTest, CreateOnBuffer) {
       GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
       (unsigned char*)points, 2, bufferView);
 
+  // Bounds are computed on demand
+  EXPECT_TRUE(accessor->min == NULL);
+  accessor->computeMinMax();
   float* min = accessor->min;
   ASSERT_TRUE(min != NULL);
   EXPECT_EQ(min[0], 13.0);
@@ -56,10 +71,219 @@ TEST(GLTFAccessorTest, CreateOnBuffer) {
   EXPECT_EQ(max[2], 18.0);
 
   float component[3];
-  for (int i = 0; i < accessor->count; i++) {
+  for (size_t i = 0; i < accessor->count; i++) {
     accessor->getComponentAtIndex(i, component);
     EXPECT_EQ(component[0], (i + 4) * 3 + 1);
     EXPECT_EQ(component[1], (i + 4) * 3 + 2);
     EXPECT_EQ(component[2], (i + 4) * 3 + 3);
   }
 }
+
+struct SumVisitor {
+  int numberOfComponents = 0;
+  float sum = 0;
+
+  template <typename T, int N>
+  void operator()(const GLTF::AccessorView<T, N>& view) {
+    numberOfComponents = N;
+    for (const T* element : view) {
+      for (int k = 0; k < N; k++) {
+        sum += element[k];
+      }
+    }
+  }
+};
+
+TEST(GLTFAccessorTest, AccessorView) {
+  // Two VEC2 UNSIGNED_SHORT elements with a byte stride of 8
+  uint16_t elements[8] = {1, 2, 0, 0, 3, 4, 0, 0};
+  GLTF::BufferView* bufferView = new GLTF::BufferView(
+      reinterpret_cast<unsigned char*>(elements), sizeof(elements),
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  bufferView->byteStride = 8;
+  GLTF::Accessor* accessor =
+      new GLTF::Accessor(GLTF::Accessor::Type::VEC2,
+                         GLTF::Constants::WebGL::UNSIGNED_SHORT,
+                         static_cast<size_t>(0), 2, bufferView);
+
+  GLTF::AccessorView<uint16_t, 2> view(accessor);
+  EXPECT_EQ(view.size(), 2);
+  EXPECT_FALSE(view.isContiguous());
+  EXPECT_EQ(view[1][1], 4);
+
+  SumVisitor visitor;
+  ASSERT_TRUE(GLTF::visitAccessor(accessor, &visitor));
+  EXPECT_EQ(visitor.numberOfComponents, 2);
+  EXPECT_EQ(visitor.sum, 10);
+
+  float values[4];
+  ASSERT_TRUE(accessor->getComponents(values));
+  EXPECT_EQ(values[2], 3);
+  EXPECT_EQ(values[3], 4);
+
+  accessor->computeMinMax();
+  EXPECT_EQ(accessor->min[0], 1);
+  EXPECT_EQ(accessor->max[1], 4);
+
+  // Copying to a tightly packed accessor drops the padding
+  uint16_t zeros[4] = {0, 0, 0, 0};
+  GLTF::Accessor* packed = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC2, GLTF::Constants::WebGL::UNSIGNED_SHORT,
+      reinterpret_cast<unsigned char*>(zeros), 2,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  ASSERT_TRUE(accessor->copyComponents(packed));
+  GLTF::AccessorView<uint16_t, 2> packedView(packed);
+  EXPECT_TRUE(packedView.isContiguous());
+  EXPECT_EQ(packedView.data()[2], 3);
+  EXPECT_TRUE(accessor->equals(packed));
+}
+
+TEST(GLTFAccessorTest, ComputeMinMax) {
+  // Counts that leave a remainder after the vectorized blocks
+  std::vector<float> points(37 * 3);
+  for (size_t i = 0; i < points.size(); i++) {
+    points[i] = static_cast<float>((i * 7919) % 101) - 50.0f;
+  }
+  points[100] = -75.0f;
+  points[110] = 80.0f;
+  GLTF::Accessor* pointAccessor = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(points.data()), 37,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  pointAccessor->computeMinMax();
+  for (int k = 0; k < 3; k++) {
+    float low = points[k];
+    float high = points[k];
+    for (int i = 0; i < 37; i++) {
+      low = std::min(low, points[i * 3 + k]);
+      high = std::max(high, points[i * 3 + k]);
+    }
+    EXPECT_EQ(pointAccessor->min[k], low);
+    EXPECT_EQ(pointAccessor->max[k], high);
+  }
+  EXPECT_EQ(pointAccessor->min[1], -75.0f);
+  EXPECT_EQ(pointAccessor->max[2], 80.0f);
+
+  // Values above the signed range of the component type
+  std::vector<uint16_t> shorts(45, 40000);
+  shorts[3] = 1;
+  shorts[44] = 65535;
+  GLTF::Accessor* shortAccessor = new GLTF::Accessor(
+      GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::UNSIGNED_SHORT,
+      reinterpret_cast<unsigned char*>(shorts.data()), 45,
+      GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+  shortAccessor->computeMinMax();
+  EXPECT_EQ(shortAccessor->min[0], 1);
+  EXPECT_EQ(shortAccessor->max[0], 65535);
+
+  std::vector<uint32_t> ints(2 * 11, 3000000000u);
+  ints[4] = 7;
+  ints[17] = 4000000000u;
+  GLTF::Accessor* intAccessor = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC2, GLTF::Constants::WebGL::UNSIGNED_INT,
+      reinterpret_cast<unsigned char*>(ints.data()), 11,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  intAccessor->computeMinMax();
+  EXPECT_EQ(intAccessor->min[0], 7);
+  EXPECT_EQ(intAccessor->min[1], 3000000000.0f);
+  EXPECT_EQ(intAccessor->max[0], 3000000000.0f);
+  EXPECT_EQ(intAccessor->max[1], 4000000000.0f);
+}
+
+TEST(GLTFAccessorTest, WriteJSON_64BitOffsets) {
+  // Offsets past 4 GiB are only written, so no data is needed
+  GLTF::Buffer* buffer = new GLTF::Buffer(NULL, (size_t)6 << 30);
+  GLTF::BufferView* bufferView =
+      new GLTF::BufferView((size_t)5 << 30, (size_t)1 << 30, buffer);
+  bufferView->id = 0;
+  buffer->id = 0;
+  GLTF::Accessor* accessor =
+      new GLTF::Accessor(GLTF::Accessor::Type::SCALAR,
+                         GLTF::Constants::WebGL::FLOAT,
+                         ((size_t)1 << 30) - 4, 1, bufferView);
+  GLTF::Options* options = new GLTF::Options();
+
+  std::string json;
+  for (GLTF::Object* object :
+       std::vector<GLTF::Object*>{buffer, bufferView, accessor}) {
+    rapidjson::StringBuffer s;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(s);
+    writer.StartObject();
+    object->writeJSON(&writer, options);
+    writer.EndObject();
+    json += s.GetString();
+  }
+  EXPECT_NE(json.find("\"byteLength\":6442450944"), std::string::npos);
+  EXPECT_NE(json.find("\"byteOffset\":5368709120"), std::string::npos);
+  EXPECT_NE(json.find("\"byteLength\":1073741824"), std::string::npos);
+  EXPECT_NE(json.find("\"byteOffset\":1073741820"), std::string::npos);
+}
+
+TEST(GLTFAccessorTest, CreateFromVector) {
+  std::vector<uint16_t> indices = {0, 1, 2, 2, 3, 0};
+  const uint16_t* data = indices.data();
+  GLTF::Accessor* accessor = new GLTF::Accessor(
+      GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::UNSIGNED_SHORT,
+      std::move(indices), GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+  EXPECT_EQ(accessor->count, 6);
+  EXPECT_EQ(accessor->bufferView->byteLength, 12);
+  EXPECT_EQ(accessor->bufferView->target,
+            GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+  // The data is adopted rather than copied
+  EXPECT_EQ(accessor->bufferView->buffer->data,
+            reinterpret_cast<const unsigned char*>(data));
+  float component;
+  accessor->getComponentAtIndex(3, &component);
+  EXPECT_EQ(component, 2);
+
+  // Growing adopted data copies it out first
+  accessor->bufferView->buffer->resize(16);
+  EXPECT_EQ(accessor->bufferView->buffer->byteLength, 16);
+  accessor->getComponentAtIndex(4, &component);
+  EXPECT_EQ(component, 3);
+  delete accessor->bufferView->buffer;
+}
+
+TEST(GLTFAccessorTest, CreateFromVector_FreeData) {
+  int deleted = 0;
+  unsigned char* data = new unsigned char[4]();
+  GLTF::Buffer* buffer =
+      new GLTF::Buffer(data, 4, [&deleted](unsigned char* adopted) {
+        delete[] adopted;
+        deleted++;
+      });
+  // Adopted data is released through its deleter, once
+  buffer->freeData();
+  EXPECT_EQ(deleted, 1);
+  EXPECT_TRUE(buffer->data == NULL);
+  EXPECT_EQ(buffer->byteLength, 4);
+  delete buffer;
+  EXPECT_EQ(deleted, 1);
+}
+
+TEST(GLTFAccessorTest, GetComponentAtIndex_SparseLargeIndices) {
+  // 2^24 + 1 is not representable as a float, which rounds it to 2^24
+  uint32_t indices[3] = {5, 16777217, 16777219};
+  float values[3] = {1, 2, 3};
+  GLTF::Accessor* accessor = new GLTF::Accessor(
+      GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::FLOAT);
+  accessor->count = 1 << 25;
+  accessor->sparseIndices = new GLTF::Accessor(
+      GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::UNSIGNED_INT,
+      reinterpret_cast<unsigned char*>(indices), 3,
+      (GLTF::Constants::WebGL)-1);
+  accessor->sparseValues = new GLTF::Accessor(
+      GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(values), 3,
+      (GLTF::Constants::WebGL)-1);
+
+  float value;
+  ASSERT_TRUE(accessor->getComponentAtIndex(16777216, &value));
+  EXPECT_EQ(value, 0);
+  ASSERT_TRUE(accessor->getComponentAtIndex(16777217, &value));
+  EXPECT_EQ(value, 2);
+  ASSERT_TRUE(accessor->getComponentAtIndex(16777219, &value));
+  EXPECT_EQ(value, 3);
+  ASSERT_TRUE(accessor->getComponentAtIndex(5, &value));
+  EXPECT_EQ(value, 1);
+}
@@ -1,7 +1,16 @@
 // Copyright 2020 The Khronos® Group Inc.
 #include "GLTFAssetTest.h"
 
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
 #include "GLTFAsset.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
 
 TEST(GLTFAssetTest, RemoveUnusedSemantics) {
   GLTF::Asset* asset = new GLTF::Asset();
@@ -42,3 +51,1089 @@ TEST(GLTFAssetTest, RemoveUnusedSemantics) {
   EXPECT_EQ(primitive->attributes["TEXCOORD_0"], (GLTF::Accessor*)1);
   EXPECT_EQ(material->values->ambientTexCoord, 0);
 }
+
+TEST(GLTFAssetTest, OptimizeVertexCache) {
+  GLTF::Asset* asset = new GLTF::Asset();
+  GLTF::Scene* scene = new GLTF::Scene();
+  asset->scenes.push_back(scene);
+  asset->scene = 0;
+  GLTF::Node* node = new GLTF::Node();
+  scene->nodes.push_back(node);
+  GLTF::Mesh* mesh = new GLTF::Mesh();
+  node->mesh = mesh;
+
+  // Two quads sharing an edge, with the triangles interleaved
+  uint16_t indices[] = {0, 1, 4, 2, 3, 5, 0, 4, 3, 2, 5, 1};
+  GLTF::Primitive* primitive = new GLTF::Primitive();
+  primitive->mode = GLTF::Primitive::Mode::TRIANGLES;
+  primitive->indices = new GLTF::Accessor(
+      GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::UNSIGNED_SHORT,
+      reinterpret_cast<unsigned char*>(indices), 12,
+      GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+  mesh->primitives.push_back(primitive);
+  // Primitives sharing indices are only reordered once
+  GLTF::Primitive* sharedPrimitive = new GLTF::Primitive();
+  sharedPrimitive->mode = GLTF::Primitive::Mode::TRIANGLES;
+  sharedPrimitive->indices = primitive->indices;
+  mesh->primitives.push_back(sharedPrimitive);
+
+  GLTF::MeshOptimizer::VertexCacheStatistics before;
+  GLTF::MeshOptimizer::VertexCacheStatistics after;
+  asset->optimizeVertexCache(&before, &after);
+  EXPECT_EQ(before.triangleCount, 4);
+  EXPECT_EQ(after.triangleCount, 4);
+  EXPECT_EQ(after.transformedVertexCount, 6);
+
+  std::multiset<unsigned int> original(indices, indices + 12);
+  std::multiset<unsigned int> optimized;
+  float index;
+  for (int i = 0; i < 12; i++) {
+    primitive->indices->getComponentAtIndex(i, &index);
+    optimized.insert(static_cast<unsigned int>(index));
+  }
+  EXPECT_EQ(original, optimized);
+}
+
+TEST(GLTFAssetTest, OptimizeVertexFetch) {
+  GLTF::Asset* asset = new GLTF::Asset();
+  GLTF::Scene* scene = new GLTF::Scene();
+  asset->scenes.push_back(scene);
+  asset->scene = 0;
+  GLTF::Node* node = new GLTF::Node();
+  scene->nodes.push_back(node);
+  GLTF::Mesh* mesh = new GLTF::Mesh();
+  node->mesh = mesh;
+
+  uint16_t indices[] = {3, 1, 2, 2, 1, 0};
+  float positions[] = {0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3};
+  float targetPositions[] = {0, 0, 0, -1, -1, -1, -2, -2, -2, -3, -3, -3};
+  GLTF::Primitive* primitive = new GLTF::Primitive();
+  primitive->mode = GLTF::Primitive::Mode::TRIANGLES;
+  primitive->indices = new GLTF::Accessor(
+      GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::UNSIGNED_SHORT,
+      reinterpret_cast<unsigned char*>(indices), 6,
+      GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+  primitive->attributes["POSITION"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(positions), 4,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  GLTF::Primitive::Target* target = new GLTF::Primitive::Target();
+  target->attributes["POSITION"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(targetPositions), 4,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  primitive->targets.push_back(target);
+  mesh->primitives.push_back(primitive);
+
+  GLTF::MeshOptimizer::VertexFetchStatistics before;
+  GLTF::MeshOptimizer::VertexFetchStatistics after;
+  asset->optimizeVertexFetch(&before, &after);
+  EXPECT_EQ(after.vertexBytes, 96);
+
+  // Vertices are renumbered in the order the indices first use them
+  float expectedIndices[] = {0, 1, 2, 2, 1, 3};
+  float expectedPositions[] = {3, 1, 2, 0};
+  float value[3];
+  for (int i = 0; i < 6; i++) {
+    primitive->indices->getComponentAtIndex(i, value);
+    EXPECT_EQ(value[0], expectedIndices[i]);
+  }
+  for (int i = 0; i < 4; i++) {
+    primitive->attributes["POSITION"]->getComponentAtIndex(i, value);
+    EXPECT_EQ(value[2], expectedPositions[i]);
+    target->attributes["POSITION"]->getComponentAtIndex(i, value);
+    EXPECT_EQ(value[2], -expectedPositions[i]);
+  }
+}
+
+TEST(GLTFAssetTest, WeldVertices) {
+  GLTF::Asset* asset = new GLTF::Asset();
+  GLTF::Scene* scene = new GLTF::Scene();
+  asset->scenes.push_back(scene);
+  asset->scene = 0;
+  GLTF::Node* node = new GLTF::Node();
+  scene->nodes.push_back(node);
+  GLTF::Mesh* mesh = new GLTF::Mesh();
+  node->mesh = mesh;
+
+  // A quad whose second triangle repeats its corners with float noise, and a
+  // sliver triangle that collapses once welded
+  uint16_t indices[] = {0, 1, 2, 3, 4, 5, 1, 4, 6};
+  float positions[] = {0, 0, 0,         1, 0, 0,     1, 1,     0,
+                       1.000001f, 1, 0, 0, 1, 0,     0, 0,     1e-6f,
+                       1,         1e-6f, 0};
+  float texCoords[] = {0, 0, 1, 0, 1, 1, 1, 1, 0, 1, 0, 0, 1, 0};
+  GLTF::Primitive* primitive = new GLTF::Primitive();
+  primitive->mode = GLTF::Primitive::Mode::TRIANGLES;
+  primitive->indices = new GLTF::Accessor(
+      GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::UNSIGNED_SHORT,
+      reinterpret_cast<unsigned char*>(indices), 9,
+      GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+  primitive->attributes["POSITION"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(positions), 7,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  primitive->attributes["TEXCOORD_0"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC2, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(texCoords), 7,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  mesh->primitives.push_back(primitive);
+
+  std::map<std::string, float> tolerances;
+  tolerances["POSITION"] = 1e-5f;
+  tolerances["TEXCOORD"] = 1e-4f;
+  size_t before = 0;
+  size_t after = 0;
+  size_t removedTriangles = 0;
+  // Bounds that were computed are kept up to date
+  primitive->indices->computeMinMax();
+  asset->weldVertices(tolerances, &before, &after, &removedTriangles);
+  EXPECT_EQ(before, 7);
+  EXPECT_EQ(after, 4);
+  EXPECT_EQ(removedTriangles, 1);
+  EXPECT_EQ(primitive->attributes["POSITION"]->count, 4);
+  EXPECT_EQ(primitive->attributes["TEXCOORD_0"]->count, 4);
+  EXPECT_EQ(primitive->indices->count, 6);
+
+  float expectedIndices[] = {0, 1, 2, 2, 3, 0};
+  float value[1];
+  for (int i = 0; i < 6; i++) {
+    primitive->indices->getComponentAtIndex(i, value);
+    EXPECT_EQ(value[0], expectedIndices[i]);
+  }
+  EXPECT_EQ(primitive->indices->max[0], 3);
+}
+
+TEST(GLTFAssetTest, PackAccessors_Interleave) {
+  GLTF::Asset* asset = new GLTF::Asset();
+  GLTF::Scene* scene = new GLTF::Scene();
+  asset->scenes.push_back(scene);
+  asset->scene = 0;
+  GLTF::Node* node = new GLTF::Node();
+  scene->nodes.push_back(node);
+  GLTF::Mesh* mesh = new GLTF::Mesh();
+  node->mesh = mesh;
+
+  float positions[] = {0, 0, 0, 1, 0, 0, 0, 1, 0};
+  float texCoords[] = {0, 0, 1, 0, 0, 1};
+  uint16_t joints[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+  GLTF::Primitive* primitive = new GLTF::Primitive();
+  primitive->mode = GLTF::Primitive::Mode::TRIANGLES;
+  primitive->attributes["POSITION"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(positions), 3,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  primitive->attributes["TEXCOORD_0"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC2, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(texCoords), 3,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  primitive->attributes["JOINTS_0"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC4, GLTF::Constants::WebGL::UNSIGNED_SHORT,
+      reinterpret_cast<unsigned char*>(joints), 3,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  mesh->primitives.push_back(primitive);
+  // A cloned primitive shares the interleaved bufferView
+  GLTF::Primitive* clonePrimitive = new GLTF::Primitive();
+  primitive->clone(clonePrimitive);
+  mesh->primitives.push_back(clonePrimitive);
+
+  GLTF::Options* options = new GLTF::Options();
+  options->interleave = true;
+  asset->packAccessors(options);
+
+  GLTF::Accessor* position = primitive->attributes["POSITION"];
+  GLTF::Accessor* texCoord = primitive->attributes["TEXCOORD_0"];
+  GLTF::Accessor* joint = primitive->attributes["JOINTS_0"];
+  EXPECT_EQ(position->bufferView, texCoord->bufferView);
+  EXPECT_EQ(position->bufferView, joint->bufferView);
+  EXPECT_EQ(position->bufferView->byteStride, 28);
+  EXPECT_EQ(position->bufferView->byteLength, 84);
+  // Attributes are interleaved in semantic order
+  EXPECT_EQ(joint->byteOffset, 0);
+  EXPECT_EQ(position->byteOffset, 8);
+  EXPECT_EQ(texCoord->byteOffset, 20);
+
+  float value[4];
+  position->getComponentAtIndex(1, value);
+  EXPECT_EQ(value[0], 1);
+  texCoord->getComponentAtIndex(2, value);
+  EXPECT_EQ(value[1], 1);
+  joint->getComponentAtIndex(2, value);
+  EXPECT_EQ(value[3], 11);
+}
+
+TEST(GLTFAssetTest, PackAccessors) {
+  GLTF::Asset* asset = new GLTF::Asset();
+  GLTF::Scene* scene = new GLTF::Scene();
+  asset->scenes.push_back(scene);
+  asset->scene = 0;
+  GLTF::Node* node = new GLTF::Node();
+  scene->nodes.push_back(node);
+  GLTF::Mesh* mesh = new GLTF::Mesh();
+  node->mesh = mesh;
+
+  // Large enough to be copied in several parts
+  const int vertexCount = 1 << 19;
+  std::vector<float> positions(vertexCount * 3);
+  for (size_t i = 0; i < positions.size(); i++) {
+    positions[i] = static_cast<float>(i);
+  }
+  uint16_t indices[] = {0, 1, 2};
+  GLTF::Primitive* primitive = new GLTF::Primitive();
+  primitive->mode = GLTF::Primitive::Mode::TRIANGLES;
+  primitive->attributes["POSITION"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(positions.data()), vertexCount,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  primitive->indices = new GLTF::Accessor(
+      GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::UNSIGNED_SHORT,
+      reinterpret_cast<unsigned char*>(indices), 3,
+      GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+  mesh->primitives.push_back(primitive);
+
+  GLTF::Options* options = new GLTF::Options();
+  options->threads = 4;
+  GLTF::Buffer* buffer = asset->packAccessors(options);
+
+  GLTF::Accessor* position = primitive->attributes["POSITION"];
+  EXPECT_EQ(position->bufferView->buffer, buffer);
+  EXPECT_EQ(primitive->indices->bufferView->buffer, buffer);
+  EXPECT_EQ(position->bufferView->byteStride, 12);
+  // Larger strides come first, and every bufferView is 4-byte aligned
+  EXPECT_EQ(position->bufferView->byteOffset, 0);
+  EXPECT_EQ(primitive->indices->bufferView->byteOffset % 4, 0);
+  EXPECT_EQ(buffer->byteLength,
+            primitive->indices->bufferView->byteOffset + sizeof(indices));
+  std::vector<float> packedPositions(positions.size());
+  position->getComponents(packedPositions.data());
+  EXPECT_TRUE(packedPositions == positions);
+  float value[1];
+  primitive->indices->getComponentAtIndex(2, value);
+  EXPECT_EQ(value[0], 2);
+}
+
+TEST(GLTFAssetTest, PackAccessors_BufferSplit) {
+  for (std::string bufferSplit : {"mesh", "node"}) {
+    GLTF::Asset* asset = new GLTF::Asset();
+    GLTF::Scene* scene = new GLTF::Scene();
+    asset->scenes.push_back(scene);
+    asset->scene = 0;
+
+    // Two meshes, and a third node sharing the first mesh
+    float positions[] = {0, 0, 0, 1, 0, 0, 0, 1, 0};
+    uint16_t indices[] = {0, 1, 2};
+    std::vector<GLTF::Mesh*> meshes;
+    for (int i = 0; i < 2; i++) {
+      GLTF::Mesh* mesh = new GLTF::Mesh();
+      GLTF::Primitive* primitive = new GLTF::Primitive();
+      primitive->mode = GLTF::Primitive::Mode::TRIANGLES;
+      primitive->attributes["POSITION"] = new GLTF::Accessor(
+          GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+          reinterpret_cast<unsigned char*>(positions), 3,
+          GLTF::Constants::WebGL::ARRAY_BUFFER);
+      primitive->indices = new GLTF::Accessor(
+          GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::UNSIGNED_SHORT,
+          reinterpret_cast<unsigned char*>(indices), 3,
+          GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+      mesh->primitives.push_back(primitive);
+      meshes.push_back(mesh);
+    }
+    for (GLTF::Mesh* mesh : {meshes[0], meshes[1], meshes[0]}) {
+      GLTF::Node* node = new GLTF::Node();
+      node->mesh = mesh;
+      scene->nodes.push_back(node);
+    }
+
+    GLTF::Options* options = new GLTF::Options();
+    options->bufferSplit = bufferSplit;
+    std::vector<GLTF::Buffer*> buffers;
+    GLTF::Buffer* buffer = asset->packAccessors(options, &buffers);
+
+    ASSERT_EQ(buffers.size(), 2);
+    EXPECT_EQ(buffers[0], buffer);
+    EXPECT_FALSE(buffers[0]->external);
+    EXPECT_TRUE(buffers[1]->external);
+    // Each mesh is packed into its own buffer
+    std::set<GLTF::Buffer*> meshBuffers;
+    for (GLTF::Mesh* mesh : meshes) {
+      GLTF::Primitive* primitive = mesh->primitives[0];
+      GLTF::Accessor* position = primitive->attributes["POSITION"];
+      GLTF::Buffer* meshBuffer = position->bufferView->buffer;
+      meshBuffers.insert(meshBuffer);
+      EXPECT_EQ(meshBuffer->byteLength, 36 + 6);
+      EXPECT_EQ(primitive->indices->bufferView->buffer, meshBuffer);
+      EXPECT_EQ(primitive->indices->bufferView->byteOffset, 36);
+      float value[3];
+      position->getComponentAtIndex(1, value);
+      EXPECT_EQ(value[0], 1);
+    }
+    EXPECT_EQ(meshBuffers.size(), 2);
+  }
+}
+
+TEST(GLTFAssetTest, SplitBuffer) {
+  GLTF::Asset* asset = new GLTF::Asset();
+  GLTF::Scene* scene = new GLTF::Scene();
+  asset->scenes.push_back(scene);
+  asset->scene = 0;
+  GLTF::Node* node = new GLTF::Node();
+  scene->nodes.push_back(node);
+  GLTF::Mesh* mesh = new GLTF::Mesh();
+  node->mesh = mesh;
+
+  // Four primitives whose positions pack into one 3072 byte bufferView
+  const int vertexCount = 64;
+  std::vector<float> positions(vertexCount * 3);
+  for (size_t i = 0; i < positions.size(); i++) {
+    positions[i] = static_cast<float>(i);
+  }
+  uint16_t indices[] = {0, 1, 2};
+  for (int i = 0; i < 4; i++) {
+    GLTF::Primitive* primitive = new GLTF::Primitive();
+    primitive->mode = GLTF::Primitive::Mode::TRIANGLES;
+    primitive->attributes["POSITION"] = new GLTF::Accessor(
+        GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+        reinterpret_cast<unsigned char*>(positions.data()), vertexCount,
+        GLTF::Constants::WebGL::ARRAY_BUFFER);
+    primitive->indices = new GLTF::Accessor(
+        GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::UNSIGNED_SHORT,
+        reinterpret_cast<unsigned char*>(indices), 3,
+        GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+    mesh->primitives.push_back(primitive);
+  }
+
+  GLTF::Options* options = new GLTF::Options();
+  GLTF::Buffer* buffer = asset->packAccessors(options);
+  ASSERT_EQ(mesh->primitives[0]->attributes["POSITION"]->bufferView,
+            mesh->primitives[3]->attributes["POSITION"]->bufferView);
+  std::vector<GLTF::Buffer*> buffers = asset->splitBuffer(buffer, 1024);
+
+  // Each position accessor gets its own bufferView and buffer, and the
+  // indices share the last buffer
+  ASSERT_EQ(buffers.size(), 4);
+  EXPECT_EQ(buffers[0], buffer);
+  EXPECT_FALSE(buffers[0]->external);
+  std::set<GLTF::Buffer*> uniqueBuffers;
+  for (size_t i = 0; i < buffers.size(); i++) {
+    EXPECT_LE(buffers[i]->byteLength, 1024);
+    EXPECT_EQ(buffers[i]->external, i > 0);
+    GLTF::Accessor* position = mesh->primitives[i]->attributes["POSITION"];
+    EXPECT_EQ(position->bufferView->buffer, buffers[i]);
+    EXPECT_EQ(position->bufferView->byteOffset, 0);
+    EXPECT_EQ(position->byteOffset, 0);
+    EXPECT_EQ(position->bufferView->byteStride, 12);
+    std::vector<float> splitPositions(positions.size());
+    position->getComponents(splitPositions.data());
+    EXPECT_TRUE(splitPositions == positions);
+
+    GLTF::Accessor* index = mesh->primitives[i]->indices;
+    EXPECT_EQ(index->bufferView->buffer, buffers[3]);
+    float value[1];
+    index->getComponentAtIndex(2, value);
+    EXPECT_EQ(value[0], 2);
+  }
+
+  // The buffer kept in binary glTF comes first, without a uri, and the others
+  // are numbered in the order their bufferViews are written
+  options->binary = true;
+  options->name = "split";
+  rapidjson::StringBuffer s;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(s);
+  writer.StartObject();
+  asset->writeJSON(&writer, options);
+  writer.EndObject();
+  std::string json = s.GetString();
+  EXPECT_NE(json.find("\"buffers\":[{\"byteLength\":768},"
+                      "{\"byteLength\":792,\"uri\":\"split1.bin\"}"),
+            std::string::npos);
+  EXPECT_EQ(buffer->id, 0);
+}
+
+TEST(GLTFAssetTest, QuantizeAttributes) {
+  GLTF::Asset* asset = new GLTF::Asset();
+  GLTF::Scene* scene = new GLTF::Scene();
+  asset->scenes.push_back(scene);
+  asset->scene = 0;
+  GLTF::Node* node = new GLTF::Node();
+  scene->nodes.push_back(node);
+  GLTF::Mesh* mesh = new GLTF::Mesh();
+  node->mesh = mesh;
+
+  float positions[] = {1, 2, 3, 5, 2, 3, 1, 4, 3};
+  float normals[] = {0, 0, 1, 0, 0, -1, 0, 1, 0};
+  float texCoords[] = {0, 0, 1, 0, 0, 2};
+  GLTF::Primitive* primitive = new GLTF::Primitive();
+  primitive->mode = GLTF::Primitive::Mode::TRIANGLES;
+  primitive->attributes["POSITION"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(positions), 3,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  primitive->attributes["NORMAL"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(normals), 3,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  primitive->attributes["TEXCOORD_0"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC2, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(texCoords), 3,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  mesh->primitives.push_back(primitive);
+
+  GLTF::Options* options = new GLTF::Options();
+  options->positionQuantizationBits = 16;
+  asset->quantizeAttributes(options);
+
+  EXPECT_EQ(asset->extensionsRequired.count("KHR_mesh_quantization"), 1);
+  // The mesh moves to a child node that dequantizes its positions
+  EXPECT_TRUE(node->mesh == NULL);
+  ASSERT_EQ(node->children.size(), 1);
+  GLTF::Node* meshNode = node->children[0];
+  EXPECT_EQ(meshNode->mesh, mesh);
+  GLTF::Node::TransformTRS* transform =
+      static_cast<GLTF::Node::TransformTRS*>(meshNode->transform);
+  EXPECT_EQ(transform->translation[0], 3);
+  EXPECT_EQ(transform->translation[1], 3);
+  EXPECT_EQ(transform->translation[2], 3);
+  EXPECT_EQ(transform->scale[0], 2);
+
+  GLTF::Accessor* position = primitive->attributes["POSITION"];
+  EXPECT_EQ(position->componentType, GLTF::Constants::WebGL::SHORT);
+  EXPECT_TRUE(position->normalized);
+  EXPECT_EQ(position->bufferView->byteStride, 8);
+  float value[3];
+  position->getComponentAtIndex(1, value);
+  EXPECT_EQ(value[0], 32767);
+  EXPECT_EQ(value[1], -16384);
+  EXPECT_EQ(value[2], 0);
+
+  GLTF::Accessor* normal = primitive->attributes["NORMAL"];
+  EXPECT_EQ(normal->componentType, GLTF::Constants::WebGL::BYTE);
+  EXPECT_EQ(normal->bufferView->byteStride, 4);
+  normal->getComponentAtIndex(1, value);
+  EXPECT_EQ(value[2], -127);
+
+  // Texture coordinates outside [0, 1] stay FLOAT
+  GLTF::Accessor* texCoord = primitive->attributes["TEXCOORD_0"];
+  EXPECT_EQ(texCoord->componentType, GLTF::Constants::WebGL::FLOAT);
+  EXPECT_FALSE(texCoord->normalized);
+}
+
+TEST(GLTFAssetTest, CompressBufferViews) {
+  GLTF::Asset* asset = new GLTF::Asset();
+  GLTF::Scene* scene = new GLTF::Scene();
+  asset->scenes.push_back(scene);
+  asset->scene = 0;
+  GLTF::Node* node = new GLTF::Node();
+  scene->nodes.push_back(node);
+  GLTF::Mesh* mesh = new GLTF::Mesh();
+  node->mesh = mesh;
+
+  std::vector<float> positions;
+  std::vector<uint16_t> indices;
+  for (uint16_t i = 0; i < 100; i++) {
+    positions.insert(positions.end(), {i * 1.0f, 0, 0, i * 1.0f, 1, 0});
+    if (i > 0) {
+      uint16_t a = (i - 1) * 2;
+      uint16_t b = a + 1;
+      uint16_t c = a + 2;
+      uint16_t d = a + 3;
+      indices.insert(indices.end(), {a, c, b, b, c, d});
+    }
+  }
+  GLTF::Primitive* primitive = new GLTF::Primitive();
+  primitive->mode = GLTF::Primitive::Mode::TRIANGLES;
+  primitive->attributes["POSITION"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(positions.data()), 200,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  primitive->indices = new GLTF::Accessor(
+      GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::UNSIGNED_SHORT,
+      reinterpret_cast<unsigned char*>(indices.data()), indices.size(),
+      GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+  mesh->primitives.push_back(primitive);
+
+  GLTF::Options* options = new GLTF::Options();
+  GLTF::Buffer* fallbackBuffer = asset->packAccessors(options);
+  GLTF::Buffer* buffer = asset->compressBufferViews(fallbackBuffer);
+  EXPECT_NE(buffer, fallbackBuffer);
+  EXPECT_LT(buffer->byteLength, fallbackBuffer->byteLength);
+  EXPECT_TRUE(fallbackBuffer->data == NULL);
+  EXPECT_EQ(fallbackBuffer->extensions.count("EXT_meshopt_compression"), 1);
+  EXPECT_EQ(asset->extensionsRequired.count("EXT_meshopt_compression"), 1);
+
+  GLTF::BufferView* positionBufferView =
+      primitive->attributes["POSITION"]->bufferView;
+  GLTF::MeshoptExtension* positionExtension =
+      static_cast<GLTF::MeshoptExtension*>(
+          positionBufferView->extensions["EXT_meshopt_compression"]);
+  ASSERT_TRUE(positionExtension != NULL);
+  EXPECT_EQ(positionExtension->buffer, buffer);
+  EXPECT_EQ(positionExtension->mode,
+            GLTF::MeshoptExtension::Mode::ATTRIBUTES);
+  EXPECT_EQ(positionExtension->byteStride, 12);
+  EXPECT_EQ(positionExtension->count, 200);
+  std::vector<unsigned char> data(
+      buffer->data + positionExtension->byteOffset,
+      buffer->data + positionExtension->byteOffset +
+          positionExtension->byteLength);
+  std::vector<float> decodedPositions(positions.size());
+  ASSERT_TRUE(GLTF::MeshoptCodec::decodeVertexBuffer(
+      reinterpret_cast<unsigned char*>(decodedPositions.data()), 200, 12,
+      data));
+  EXPECT_EQ(decodedPositions, positions);
+
+  GLTF::BufferView* indicesBufferView = primitive->indices->bufferView;
+  GLTF::MeshoptExtension* indicesExtension =
+      static_cast<GLTF::MeshoptExtension*>(
+          indicesBufferView->extensions["EXT_meshopt_compression"]);
+  ASSERT_TRUE(indicesExtension != NULL);
+  EXPECT_EQ(indicesExtension->mode, GLTF::MeshoptExtension::Mode::TRIANGLES);
+  EXPECT_EQ(indicesExtension->byteStride, 2);
+  EXPECT_EQ(indicesExtension->count, indices.size());
+}
+
+TEST(GLTFAssetTest, CompressBufferViews_WriteJSON) {
+  GLTF::Asset* asset = new GLTF::Asset();
+  GLTF::Scene* scene = new GLTF::Scene();
+  asset->scenes.push_back(scene);
+  asset->scene = 0;
+  GLTF::Node* node = new GLTF::Node();
+  scene->nodes.push_back(node);
+  GLTF::Mesh* mesh = new GLTF::Mesh();
+  node->mesh = mesh;
+
+  std::vector<float> positions;
+  std::vector<float> times;
+  for (int i = 0; i < 100; i++) {
+    positions.insert(positions.end(), {i * 1.0f, 0, 0, i * 1.0f, 1, 0});
+    times.push_back(i * 0.5f);
+  }
+  GLTF::Primitive* primitive = new GLTF::Primitive();
+  primitive->mode = GLTF::Primitive::Mode::POINTS;
+  primitive->attributes["POSITION"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(positions.data()), 200,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  mesh->primitives.push_back(primitive);
+
+  GLTF::Animation* animation = new GLTF::Animation();
+  GLTF::Animation::Channel* channel = new GLTF::Animation::Channel();
+  channel->sampler = new GLTF::Animation::Sampler();
+  channel->sampler->input = new GLTF::Accessor(
+      GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(times.data()), times.size(),
+      (GLTF::Constants::WebGL)-1);
+  channel->sampler->output = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(positions.data()), times.size(),
+      (GLTF::Constants::WebGL)-1);
+  channel->target = new GLTF::Animation::Channel::Target();
+  channel->target->node = node;
+  channel->target->path = GLTF::Animation::Path::TRANSLATION;
+  animation->channels.push_back(channel);
+  asset->animations.push_back(animation);
+
+  // Bounds are written although the fallback buffer no longer has data
+  GLTF::Options* options = new GLTF::Options();
+  GLTF::Buffer* fallbackBuffer = asset->packAccessors(options);
+  GLTF::Buffer* buffer = asset->compressBufferViews(fallbackBuffer);
+  ASSERT_NE(buffer, fallbackBuffer);
+  EXPECT_TRUE(fallbackBuffer->data == NULL);
+  rapidjson::StringBuffer s;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(s);
+  writer.StartObject();
+  asset->writeJSON(&writer, options);
+  writer.EndObject();
+  std::string json = s.GetString();
+  EXPECT_NE(json.find("\"max\":[99.000000,1.000000,0.000000],"
+                      "\"min\":[0.000000,0.000000,0.000000]"),
+            std::string::npos);
+  EXPECT_NE(json.find("\"max\":[49.500000],\"min\":[0.000000]"),
+            std::string::npos);
+}
+
+TEST(GLTFAssetTest, GenerateLods) {
+  GLTF::Asset* asset = new GLTF::Asset();
+  GLTF::Scene* scene = new GLTF::Scene();
+  asset->scenes.push_back(scene);
+  asset->scene = 0;
+  GLTF::Node* node = new GLTF::Node();
+  scene->nodes.push_back(node);
+  node->children.push_back(new GLTF::Node());
+  GLTF::Mesh* mesh = new GLTF::Mesh();
+  node->mesh = mesh;
+
+  // A flat 8x8 grid, whose interior simplifies without error
+  std::vector<float> positions;
+  std::vector<uint16_t> indices;
+  for (uint16_t y = 0; y <= 8; y++) {
+    for (uint16_t x = 0; x <= 8; x++) {
+      positions.insert(positions.end(), {x * 1.0f, y * 1.0f, 0});
+      if (x < 8 && y < 8) {
+        uint16_t a = y * 9 + x;
+        uint16_t b = a + 1;
+        uint16_t c = a + 9;
+        uint16_t d = c + 1;
+        indices.insert(indices.end(), {a, b, d, a, d, c});
+      }
+    }
+  }
+  GLTF::Primitive* primitive = new GLTF::Primitive();
+  primitive->mode = GLTF::Primitive::Mode::TRIANGLES;
+  primitive->attributes["POSITION"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(positions.data()), 81,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  primitive->indices = new GLTF::Accessor(
+      GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::UNSIGNED_SHORT,
+      reinterpret_cast<unsigned char*>(indices.data()), indices.size(),
+      GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+  mesh->primitives.push_back(primitive);
+
+  asset->generateLods({0.5f, 0.25f}, {0.5f, 0.2f, 0.05f}, 0.01f);
+  EXPECT_EQ(asset->extensionsUsed.count("MSFT_lod"), 1);
+
+  // The mesh moves to a new child, since the node has children
+  EXPECT_TRUE(node->mesh == NULL);
+  ASSERT_EQ(node->children.size(), 2);
+  GLTF::Node* meshNode = node->children[1];
+  EXPECT_EQ(meshNode->mesh, mesh);
+  GLTF::LodExtension* lodExtension =
+      static_cast<GLTF::LodExtension*>(meshNode->extensions["MSFT_lod"]);
+  ASSERT_TRUE(lodExtension != NULL);
+  ASSERT_EQ(lodExtension->lods.size(), 2);
+  EXPECT_EQ(lodExtension->screenCoverage.size(), 3);
+
+  size_t previousCount = indices.size();
+  for (GLTF::Node* lodNode : lodExtension->lods) {
+    ASSERT_EQ(lodNode->mesh->primitives.size(), 1);
+    GLTF::Primitive* lodPrimitive = lodNode->mesh->primitives[0];
+    EXPECT_EQ(lodPrimitive->attributes["POSITION"],
+              primitive->attributes["POSITION"]);
+    EXPECT_EQ(lodPrimitive->indices->componentType,
+              GLTF::Constants::WebGL::UNSIGNED_SHORT);
+    EXPECT_LT(lodPrimitive->indices->count, previousCount);
+    previousCount = lodPrimitive->indices->count;
+  }
+  EXPECT_LE(previousCount, indices.size() / 4);
+
+  // LOD nodes are found with the rest of the asset
+  std::vector<GLTF::Node*> nodes = asset->getAllNodes();
+  EXPECT_EQ(nodes.size(), 5);
+  EXPECT_EQ(asset->getAllMeshes().size(), 3);
+}
+
+TEST(GLTFAssetTest, MergeStaticPrimitives) {
+  GLTF::Asset* asset = new GLTF::Asset();
+  GLTF::Scene* scene = new GLTF::Scene();
+  asset->scenes.push_back(scene);
+  asset->scene = 0;
+  GLTF::Material* material = new GLTF::Material();
+
+  // One triangle, drawn by a static parent and child and an animated node
+  float positions[9] = {0, 0, 0, 1, 0, 0, 0, 1, 0};
+  float normals[9] = {0, 0, 1, 0, 0, 1, 0, 0, 1};
+  GLTF::Primitive* primitive = new GLTF::Primitive();
+  primitive->mode = GLTF::Primitive::Mode::TRIANGLES;
+  primitive->material = material;
+  primitive->attributes["POSITION"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(positions), 3,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  primitive->attributes["NORMAL"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(normals), 3,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  GLTF::Mesh* mesh = new GLTF::Mesh();
+  mesh->primitives.push_back(primitive);
+
+  GLTF::Node* parent = new GLTF::Node();
+  GLTF::Node::TransformTRS* translation = new GLTF::Node::TransformTRS();
+  float translationValues[3] = {10, 0, 0};
+  float rotation[4] = {0, 0, 0, 1};
+  float scale[3] = {1, 1, 1};
+  std::memcpy(translation->translation, translationValues, sizeof(float) * 3);
+  std::memcpy(translation->rotation, rotation, sizeof(float) * 4);
+  std::memcpy(translation->scale, scale, sizeof(float) * 3);
+  parent->transform = translation;
+  parent->mesh = mesh;
+  GLTF::Node* child = new GLTF::Node();
+  // Mirrored in x, which flips the winding of the child's triangle
+  child->transform = new GLTF::Node::TransformMatrix(
+      -1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);
+  child->mesh = mesh;
+  parent->children.push_back(child);
+  scene->nodes.push_back(parent);
+
+  GLTF::Node* animated = new GLTF::Node();
+  animated->mesh = mesh;
+  scene->nodes.push_back(animated);
+  GLTF::Animation* animation = new GLTF::Animation();
+  GLTF::Animation::Channel* channel = new GLTF::Animation::Channel();
+  channel->target = new GLTF::Animation::Channel::Target();
+  channel->target->node = animated;
+  animation->channels.push_back(channel);
+  asset->animations.push_back(animation);
+
+  size_t before = 0;
+  size_t after = 0;
+  asset->mergeStaticPrimitives(65535, &before, &after);
+  EXPECT_EQ(before, 3);
+  EXPECT_EQ(after, 2);
+
+  // The emptied parent and child are removed, the animated node is kept
+  ASSERT_EQ(scene->nodes.size(), 2);
+  EXPECT_EQ(scene->nodes[0], animated);
+  EXPECT_EQ(animated->mesh, mesh);
+  GLTF::Mesh* batchMesh = scene->nodes[1]->mesh;
+  ASSERT_TRUE(batchMesh != NULL);
+  ASSERT_EQ(batchMesh->primitives.size(), 1);
+  GLTF::Primitive* merged = batchMesh->primitives[0];
+  EXPECT_EQ(merged->material, material);
+  EXPECT_EQ(merged->mode, GLTF::Primitive::Mode::TRIANGLES);
+
+  GLTF::Accessor* position = merged->attributes["POSITION"];
+  GLTF::Accessor* normal = merged->attributes["NORMAL"];
+  ASSERT_EQ(position->count, 6);
+  float value[3];
+  // The parent's vertices are translated
+  position->getComponentAtIndex(1, value);
+  EXPECT_FLOAT_EQ(value[0], 11);
+  // The child's vertices are mirrored, then translated
+  position->getComponentAtIndex(4, value);
+  EXPECT_FLOAT_EQ(value[0], 9);
+  normal->getComponentAtIndex(4, value);
+  EXPECT_FLOAT_EQ(value[2], 1);
+
+  ASSERT_EQ(merged->indices->count, 6);
+  EXPECT_EQ(merged->indices->componentType,
+            GLTF::Constants::WebGL::UNSIGNED_SHORT);
+  float index;
+  std::vector<float> indices;
+  for (int i = 0; i < 6; i++) {
+    merged->indices->getComponentAtIndex(i, &index);
+    indices.push_back(index);
+  }
+  EXPECT_EQ(indices, std::vector<float>({0, 1, 2, 3, 5, 4}));
+}
+
+TEST(GLTFAssetTest, MergeStaticPrimitives_MirroredTangents) {
+  GLTF::Asset* asset = new GLTF::Asset();
+  GLTF::Scene* scene = new GLTF::Scene();
+  asset->scenes.push_back(scene);
+  asset->scene = 0;
+
+  // One triangle, drawn by an untransformed node and a mirrored node
+  float positions[9] = {0, 0, 0, 1, 0, 0, 0, 1, 0};
+  float normals[9] = {0, 0, 1, 0, 0, 1, 0, 0, 1};
+  float tangents[12] = {1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1};
+  GLTF::Primitive* primitive = new GLTF::Primitive();
+  primitive->mode = GLTF::Primitive::Mode::TRIANGLES;
+  primitive->material = new GLTF::Material();
+  primitive->attributes["POSITION"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(positions), 3,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  primitive->attributes["NORMAL"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(normals), 3,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  primitive->attributes["TANGENT"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC4, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(tangents), 3,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  GLTF::Mesh* mesh = new GLTF::Mesh();
+  mesh->primitives.push_back(primitive);
+
+  GLTF::Node* node = new GLTF::Node();
+  node->mesh = mesh;
+  scene->nodes.push_back(node);
+  GLTF::Node* mirrored = new GLTF::Node();
+  mirrored->transform = new GLTF::Node::TransformMatrix(
+      -1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);
+  mirrored->mesh = mesh;
+  scene->nodes.push_back(mirrored);
+
+  size_t before = 0;
+  size_t after = 0;
+  asset->mergeStaticPrimitives(65535, &before, &after);
+  EXPECT_EQ(before, 2);
+  EXPECT_EQ(after, 1);
+  ASSERT_EQ(scene->nodes.size(), 1);
+  GLTF::Primitive* merged = scene->nodes[0]->mesh->primitives[0];
+
+  GLTF::Accessor* position = merged->attributes["POSITION"];
+  GLTF::Accessor* tangent = merged->attributes["TANGENT"];
+  ASSERT_EQ(tangent->count, 6);
+  // Tangents are mirrored along with the positions, and the handedness of
+  // the mirrored tangents is negated. The second vertex of each instance
+  // tells which instance is mirrored.
+  std::vector<float> signs;
+  for (int instance = 0; instance < 2; instance++) {
+    float value[4];
+    position->getComponentAtIndex(instance * 3 + 1, value);
+    float sign = value[0];
+    signs.push_back(sign);
+    for (int i = instance * 3; i < instance * 3 + 3; i++) {
+      tangent->getComponentAtIndex(i, value);
+      EXPECT_FLOAT_EQ(value[0], sign);
+      EXPECT_FLOAT_EQ(value[3], sign);
+    }
+  }
+  std::sort(signs.begin(), signs.end());
+  EXPECT_EQ(signs, std::vector<float>({-1, 1}));
+}
+
+TEST(GLTFAssetTest, DeduplicateMeshes) {
+  GLTF::Asset* asset = new GLTF::Asset();
+  GLTF::Scene* scene = new GLTF::Scene();
+  asset->scenes.push_back(scene);
+  asset->scene = 0;
+  GLTF::Material* material = new GLTF::Material();
+
+  // Three copies of a triangle, the last with a different material
+  float positions[9] = {0, 0, 0, 1, 0, 0, 0, 1, 0};
+  uint16_t indices[3] = {0, 1, 2};
+  std::vector<GLTF::Node*> nodes;
+  for (int i = 0; i < 3; i++) {
+    GLTF::Primitive* primitive = new GLTF::Primitive();
+    primitive->mode = GLTF::Primitive::Mode::TRIANGLES;
+    primitive->material = i < 2 ? material : new GLTF::Material();
+    primitive->attributes["POSITION"] = new GLTF::Accessor(
+        GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+        reinterpret_cast<unsigned char*>(positions), 3,
+        GLTF::Constants::WebGL::ARRAY_BUFFER);
+    primitive->indices = new GLTF::Accessor(
+        GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::UNSIGNED_SHORT,
+        reinterpret_cast<unsigned char*>(indices), 3,
+        GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+    GLTF::Mesh* mesh = new GLTF::Mesh();
+    mesh->primitives.push_back(primitive);
+    GLTF::Node* node = new GLTF::Node();
+    node->mesh = mesh;
+    scene->nodes.push_back(node);
+    nodes.push_back(node);
+  }
+
+  size_t before = 0;
+  size_t after = 0;
+  size_t bytesSaved = 0;
+  asset->deduplicateMeshes(&before, &after, &bytesSaved);
+  EXPECT_EQ(before, 3);
+  EXPECT_EQ(after, 2);
+  EXPECT_EQ(bytesSaved, 9 * sizeof(float) + 3 * sizeof(uint16_t));
+  EXPECT_EQ(nodes[0]->mesh, nodes[1]->mesh);
+  EXPECT_NE(nodes[0]->mesh, nodes[2]->mesh);
+  EXPECT_EQ(asset->getAllMeshes().size(), 2);
+}
+
+TEST(GLTFAssetTest, DeduplicateAccessors) {
+  GLTF::Asset* asset = new GLTF::Asset();
+  GLTF::Scene* scene = new GLTF::Scene();
+  asset->scenes.push_back(scene);
+  asset->scene = 0;
+
+  // Two triangles with different positions and the same texture coordinates
+  float positions[2][9] = {{0, 0, 0, 1, 0, 0, 0, 1, 0},
+                           {0, 0, 1, 1, 0, 1, 0, 1, 1}};
+  float texcoords[6] = {0, 0, 1, 0, 0, 1};
+  std::vector<GLTF::Primitive*> primitives;
+  for (int i = 0; i < 2; i++) {
+    GLTF::Primitive* primitive = new GLTF::Primitive();
+    primitive->attributes["POSITION"] = new GLTF::Accessor(
+        GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+        reinterpret_cast<unsigned char*>(positions[i]), 3,
+        GLTF::Constants::WebGL::ARRAY_BUFFER);
+    primitive->attributes["TEXCOORD_0"] = new GLTF::Accessor(
+        GLTF::Accessor::Type::VEC2, GLTF::Constants::WebGL::FLOAT,
+        reinterpret_cast<unsigned char*>(texcoords), 3,
+        GLTF::Constants::WebGL::ARRAY_BUFFER);
+    GLTF::Mesh* mesh = new GLTF::Mesh();
+    mesh->primitives.push_back(primitive);
+    GLTF::Node* node = new GLTF::Node();
+    node->mesh = mesh;
+    scene->nodes.push_back(node);
+    primitives.push_back(primitive);
+  }
+  // A vertex attribute with the same bytes as the animation times below
+  float times[3] = {0, 1, 2};
+  primitives[0]->attributes["_TIME"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(times), 3,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+
+  // Two channels animating the same times with separate accessors
+  GLTF::Animation* animation = new GLTF::Animation();
+  float translations[9] = {0, 0, 0, 1, 1, 1, 2, 2, 2};
+  for (GLTF::Node* node : scene->nodes) {
+    GLTF::Animation::Channel* channel = new GLTF::Animation::Channel();
+    channel->sampler = new GLTF::Animation::Sampler();
+    channel->sampler->input = new GLTF::Accessor(
+        GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::FLOAT,
+        reinterpret_cast<unsigned char*>(times), 3,
+        (GLTF::Constants::WebGL)-1);
+    channel->sampler->output = new GLTF::Accessor(
+        GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+        reinterpret_cast<unsigned char*>(translations), 3,
+        (GLTF::Constants::WebGL)-1);
+    channel->target = new GLTF::Animation::Channel::Target();
+    channel->target->node = node;
+    channel->target->path = GLTF::Animation::Path::TRANSLATION;
+    animation->channels.push_back(channel);
+  }
+  asset->animations.push_back(animation);
+
+  size_t before = 0;
+  size_t after = 0;
+  size_t bytesSaved = 0;
+  asset->deduplicateAccessors(&before, &after, &bytesSaved);
+  EXPECT_EQ(before, 9);
+  EXPECT_EQ(after, 6);
+  EXPECT_EQ(bytesSaved, 6 * sizeof(float) + 3 * sizeof(float) +
+                            9 * sizeof(float));
+  EXPECT_EQ(primitives[0]->attributes["TEXCOORD_0"],
+            primitives[1]->attributes["TEXCOORD_0"]);
+  EXPECT_NE(primitives[0]->attributes["POSITION"],
+            primitives[1]->attributes["POSITION"]);
+  EXPECT_NE(primitives[0]->attributes["_TIME"],
+            animation->channels[0]->sampler->input);
+  EXPECT_EQ(animation->channels[0]->sampler->input,
+            animation->channels[1]->sampler->input);
+  EXPECT_EQ(animation->channels[0]->sampler->output,
+            animation->channels[1]->sampler->output);
+  EXPECT_EQ(asset->getAllAccessors().size(), 6);
+}
+
+TEST(GLTFAssetTest, InstanceMeshes) {
+  GLTF::Asset* asset = new GLTF::Asset();
+  GLTF::Scene* scene = new GLTF::Scene();
+  asset->scenes.push_back(scene);
+  asset->scene = 0;
+
+  float positions[9] = {0, 0, 0, 1, 0, 0, 0, 1, 0};
+  GLTF::Primitive* primitive = new GLTF::Primitive();
+  primitive->mode = GLTF::Primitive::Mode::TRIANGLES;
+  primitive->attributes["POSITION"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(positions), 3,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  GLTF::Mesh* mesh = new GLTF::Mesh();
+  mesh->primitives.push_back(primitive);
+
+  // A group of three translated copies of the mesh, and one sheared copy
+  GLTF::Node* group = new GLTF::Node();
+  group->transform = new GLTF::Node::TransformMatrix(
+      1, 0, 0, 0, 0, 1, 0, 5, 0, 0, 1, 0, 0, 0, 0, 1);
+  scene->nodes.push_back(group);
+  for (int i = 0; i < 3; i++) {
+    GLTF::Node* node = new GLTF::Node();
+    node->transform = new GLTF::Node::TransformMatrix(
+        1, 0, 0, i * 2.0f, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);
+    node->mesh = mesh;
+    group->children.push_back(node);
+  }
+  GLTF::Node* sheared = new GLTF::Node();
+  sheared->transform = new GLTF::Node::TransformMatrix(
+      1, 0, 0, 0, 1, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);
+  sheared->mesh = mesh;
+  scene->nodes.push_back(sheared);
+
+  size_t before = 0;
+  size_t after = 0;
+  asset->instanceMeshes(&before, &after);
+  EXPECT_EQ(before, 5);
+  EXPECT_EQ(after, 2);
+  EXPECT_EQ(asset->extensionsRequired.count("EXT_mesh_gpu_instancing"), 1);
+
+  // The emptied group is removed, and the sheared node is left alone
+  ASSERT_EQ(scene->nodes.size(), 2);
+  EXPECT_EQ(scene->nodes[0], sheared);
+  EXPECT_EQ(sheared->mesh, mesh);
+  GLTF::Node* instancingNode = scene->nodes[1];
+  EXPECT_EQ(instancingNode->mesh, mesh);
+  GLTF::InstancingExtension* instancingExtension =
+      static_cast<GLTF::InstancingExtension*>(
+          instancingNode->extensions["EXT_mesh_gpu_instancing"]);
+  ASSERT_TRUE(instancingExtension != NULL);
+
+  // Identity rotations and scales are left out
+  ASSERT_EQ(instancingExtension->attributes.size(), 1);
+  GLTF::Accessor* translation = instancingExtension->attributes["TRANSLATION"];
+  ASSERT_EQ(translation->count, 3);
+  std::set<float> x;
+  float value[3];
+  for (int i = 0; i < 3; i++) {
+    translation->getComponentAtIndex(i, value);
+    x.insert(value[0]);
+    EXPECT_FLOAT_EQ(value[1], 5);
+  }
+  EXPECT_EQ(x, std::set<float>({0, 2, 4}));
+  EXPECT_EQ(asset->getAllAccessors().size(), 2);
+}
+
+TEST(GLTFAssetTest, SparsifyMorphTargets) {
+  GLTF::Asset* asset = new GLTF::Asset();
+  GLTF::Scene* scene = new GLTF::Scene();
+  asset->scenes.push_back(scene);
+  asset->scene = 0;
+
+  float positions[12] = {0, 0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 0};
+  float sparse[12] = {0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0};
+  float zero[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  float dense[12] = {1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0};
+  GLTF::Primitive* primitive = new GLTF::Primitive();
+  primitive->mode = GLTF::Primitive::Mode::POINTS;
+  primitive->attributes["POSITION"] = new GLTF::Accessor(
+      GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+      reinterpret_cast<unsigned char*>(positions), 4,
+      GLTF::Constants::WebGL::ARRAY_BUFFER);
+  std::vector<GLTF::Accessor*> targetAccessors;
+  for (float* displacements : {sparse, zero, dense}) {
+    GLTF::Primitive::Target* target = new GLTF::Primitive::Target();
+    GLTF::Accessor* accessor = new GLTF::Accessor(
+        GLTF::Accessor::Type::VEC3, GLTF::Constants::WebGL::FLOAT,
+        reinterpret_cast<unsigned char*>(displacements), 4,
+        GLTF::Constants::WebGL::ARRAY_BUFFER);
+    target->attributes["POSITION"] = accessor;
+    primitive->targets.push_back(target);
+    targetAccessors.push_back(accessor);
+  }
+  GLTF::Mesh* mesh = new GLTF::Mesh();
+  mesh->primitives.push_back(primitive);
+  GLTF::Node* node = new GLTF::Node();
+  node->mesh = mesh;
+  scene->nodes.push_back(node);
+
+  asset->sparsifyMorphTargets(0.5f);
+
+  // One of four displacements is not zero
+  GLTF::Accessor* sparseAccessor = targetAccessors[0];
+  EXPECT_TRUE(sparseAccessor->bufferView == NULL);
+  ASSERT_TRUE(sparseAccessor->sparseIndices != NULL);
+  ASSERT_TRUE(sparseAccessor->sparseValues != NULL);
+  EXPECT_EQ(sparseAccessor->sparseIndices->count, 1);
+  EXPECT_EQ(sparseAccessor->sparseIndices->componentType,
+            GLTF::Constants::WebGL::UNSIGNED_SHORT);
+  EXPECT_EQ(sparseAccessor->sparseValues->count, 1);
+  sparseAccessor->computeMinMax();
+  ASSERT_TRUE(sparseAccessor->max != NULL);
+  EXPECT_FLOAT_EQ(sparseAccessor->max[2], 2);
+  float value[3];
+  for (int i = 0; i < 4; i++) {
+    sparseAccessor->getComponentAtIndex(i, value);
+    for (int k = 0; k < 3; k++) {
+      EXPECT_FLOAT_EQ(value[k], sparse[i * 3 + k]);
+    }
+  }
+
+  // Targets without displacements need no data
+  EXPECT_TRUE(targetAccessors[1]->bufferView == NULL);
+  EXPECT_TRUE(targetAccessors[1]->sparseIndices == NULL);
+  targetAccessors[1]->getComponentAtIndex(2, value);
+  EXPECT_FLOAT_EQ(value[2], 0);
+
+  EXPECT_TRUE(targetAccessors[2]->bufferView != NULL);
+  EXPECT_TRUE(targetAccessors[2]->sparseIndices == NULL);
+
+  // The sparse indices and values are packed with the other accessors
+  EXPECT_EQ(asset->getAllAccessors().size(), 6);
+}
@@ -0,0 +1,81 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "GLTFBufferWriterTest.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "GLTFBufferWriter.h"
+
+TEST(GLTFBufferWriterTest, Write) {
+  unsigned char first[] = {1, 2, 3, 4, 5};
+  unsigned char second[] = {6, 7};
+  unsigned char third[] = {8};
+  GLTF::BufferWriter writer;
+  EXPECT_EQ(writer.add(first, sizeof(first)), 0);
+  EXPECT_EQ(writer.add(second, sizeof(second)), 8);
+  EXPECT_EQ(writer.add(third, sizeof(third), 1), 10);
+  EXPECT_EQ(writer.getByteLength(), 11);
+
+  FILE* file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  EXPECT_TRUE(writer.write(file));
+  EXPECT_EQ(ftell(file), 11);
+  rewind(file);
+  std::vector<unsigned char> data(11);
+  EXPECT_EQ(fread(data.data(), 1, data.size(), file), data.size());
+  fclose(file);
+  std::vector<unsigned char> expected = {1, 2, 3, 4, 5, 0, 0, 0, 6, 7, 8};
+  EXPECT_TRUE(data == expected);
+}
+
+TEST(GLTFBufferWriterTest, WriteGLB) {
+  unsigned char data[] = {1, 2, 3, 4, 5};
+  GLTF::BufferWriter buffer;
+  buffer.add(data, sizeof(data));
+  std::string json = "{\"a\":1}";
+
+  FILE* file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  EXPECT_TRUE(GLTF::writeGLB(file, json, buffer, 2));
+  long byteLength = ftell(file);
+  EXPECT_EQ(byteLength, 12 + 8 + 8 + 8 + 8);
+  rewind(file);
+  std::vector<unsigned char> glb(byteLength);
+  EXPECT_EQ(fread(glb.data(), 1, glb.size(), file), glb.size());
+  fclose(file);
+
+  uint32_t header[3];
+  std::memcpy(header, glb.data(), sizeof(header));
+  EXPECT_EQ(header[0], 0x46546C67);
+  EXPECT_EQ(header[1], 2);
+  EXPECT_EQ(header[2], byteLength);
+  uint32_t jsonChunkHeader[2];
+  std::memcpy(jsonChunkHeader, glb.data() + 12, sizeof(jsonChunkHeader));
+  EXPECT_EQ(jsonChunkHeader[0], 8);
+  EXPECT_EQ(jsonChunkHeader[1], 0x4E4F534A);
+  EXPECT_EQ(std::string(glb.begin() + 20, glb.begin() + 28), json + " ");
+  uint32_t binChunkHeader[2];
+  std::memcpy(binChunkHeader, glb.data() + 28, sizeof(binChunkHeader));
+  EXPECT_EQ(binChunkHeader[0], 8);
+  EXPECT_EQ(binChunkHeader[1], 0x004E4942);
+  EXPECT_EQ(glb[36], 1);
+  EXPECT_EQ(glb[40], 5);
+  EXPECT_EQ(glb[43], 0);
+}
+
+TEST(GLTFBufferWriterTest, WriteGLB_TooLarge) {
+  // The data is never read, as the lengths are checked before writing
+  unsigned char data[4] = {};
+  GLTF::BufferWriter buffer;
+  buffer.add(data, GLTF::GLB_MAX_BUFFER_BYTE_LENGTH);
+  buffer.add(data, (size_t)64 << 20);
+
+  FILE* file = tmpfile();
+  ASSERT_TRUE(file != NULL);
+  EXPECT_FALSE(GLTF::writeGLB(file, "{}", buffer, 2));
+  EXPECT_EQ(ftell(file), 0);
+  fclose(file);
+}
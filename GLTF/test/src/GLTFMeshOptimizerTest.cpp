@@ -0,0 +1,271 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "GLTFMeshOptimizerTest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <set>
+#include <tuple>
+#include <vector>
+
+#include "GLTFMeshOptimizer.h"
+
+/**
+ * Builds a grid of quads, each split into two triangles, with the triangles
+ * shuffled.
+ */
+std::vector<unsigned int> shuffledGrid(unsigned int size) {
+  std::vector<std::vector<unsigned int>> triangles;
+  for (unsigned int y = 0; y < size; y++) {
+    for (unsigned int x = 0; x < size; x++) {
+      unsigned int a = y * (size + 1) + x;
+      unsigned int b = a + 1;
+      unsigned int c = a + size + 1;
+      unsigned int d = c + 1;
+      triangles.push_back({a, b, d});
+      triangles.push_back({a, d, c});
+    }
+  }
+  std::shuffle(triangles.begin(), triangles.end(), std::mt19937(0));
+  std::vector<unsigned int> indices;
+  for (const std::vector<unsigned int>& triangle : triangles) {
+    indices.insert(indices.end(), triangle.begin(), triangle.end());
+  }
+  return indices;
+}
+
+/**
+ * Gets the triangles of a triangle list, rotated so that their smallest index
+ * is first, which keeps their winding.
+ */
+std::multiset<std::tuple<unsigned int, unsigned int, unsigned int>>
+getTriangles(const std::vector<unsigned int>& indices) {
+  std::multiset<std::tuple<unsigned int, unsigned int, unsigned int>>
+      triangles;
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    unsigned int a = indices[i];
+    unsigned int b = indices[i + 1];
+    unsigned int c = indices[i + 2];
+    if (b < a && b < c) {
+      triangles.insert(std::make_tuple(b, c, a));
+    } else if (c < a && c < b) {
+      triangles.insert(std::make_tuple(c, a, b));
+    } else {
+      triangles.insert(std::make_tuple(a, b, c));
+    }
+  }
+  return triangles;
+}
+
+TEST(GLTFMeshOptimizerTest, AnalyzeVertexCache) {
+  std::vector<unsigned int> indices = {0, 1, 2, 2, 1, 3, 0, 3, 4};
+  GLTF::MeshOptimizer::VertexCacheStatistics statistics =
+      GLTF::MeshOptimizer::analyzeVertexCache(indices, 5, 16);
+  EXPECT_EQ(statistics.triangleCount, 3);
+  EXPECT_EQ(statistics.vertexCount, 5);
+  EXPECT_EQ(statistics.transformedVertexCount, 5);
+  EXPECT_FLOAT_EQ(statistics.getACMR(), 5.0f / 3);
+  EXPECT_FLOAT_EQ(statistics.getATVR(), 1.0f);
+
+  // With 3 entries, vertex 0 has been evicted by the last triangle
+  statistics = GLTF::MeshOptimizer::analyzeVertexCache(indices, 5, 3);
+  EXPECT_EQ(statistics.transformedVertexCount, 6);
+}
+
+TEST(GLTFMeshOptimizerTest, OptimizeVertexCache) {
+  std::vector<unsigned int> indices = shuffledGrid(64);
+  size_t vertexCount = 65 * 65;
+  GLTF::MeshOptimizer::VertexCacheStatistics before =
+      GLTF::MeshOptimizer::analyzeVertexCache(indices, vertexCount, 32);
+
+  std::vector<unsigned int> optimized = indices;
+  GLTF::MeshOptimizer::optimizeVertexCache(&optimized, vertexCount);
+  GLTF::MeshOptimizer::VertexCacheStatistics after =
+      GLTF::MeshOptimizer::analyzeVertexCache(optimized, vertexCount, 32);
+
+  EXPECT_EQ(getTriangles(indices), getTriangles(optimized));
+  EXPECT_GT(before.getACMR(), 2.5f);
+  EXPECT_LT(after.getACMR(), 0.8f);
+}
+
+TEST(GLTFMeshOptimizerTest, OptimizeVertexCache_DegenerateTriangles) {
+  std::vector<unsigned int> indices = {0, 0, 1, 1, 2, 2, 0, 1, 2};
+  std::vector<unsigned int> optimized = indices;
+  GLTF::MeshOptimizer::optimizeVertexCache(&optimized, 3);
+  EXPECT_EQ(getTriangles(indices), getTriangles(optimized));
+}
+
+TEST(GLTFMeshOptimizerTest, OptimizeVertexFetch) {
+  std::vector<unsigned int> indices = {4, 2, 0, 0, 2, 3};
+  std::vector<unsigned int> remap =
+      GLTF::MeshOptimizer::optimizeVertexFetch(&indices, 6);
+  EXPECT_EQ(indices, std::vector<unsigned int>({0, 1, 2, 2, 1, 3}));
+  // Unused vertices 1 and 5 keep their order at the end
+  EXPECT_EQ(remap, std::vector<unsigned int>({2, 4, 1, 3, 0, 5}));
+}
+
+TEST(GLTFMeshOptimizerTest, AnalyzeVertexFetch) {
+  // 12 byte vertices, so vertex 5 spans the first two cache lines
+  std::vector<unsigned int> indices = {0, 1, 5, 5, 1, 6};
+  GLTF::MeshOptimizer::VertexFetchStatistics statistics =
+      GLTF::MeshOptimizer::analyzeVertexFetch(indices, 7, 12);
+  EXPECT_EQ(statistics.vertexBytes, 48);
+  EXPECT_EQ(statistics.bytesFetched, 128);
+
+  std::vector<unsigned int> shuffled = shuffledGrid(128);
+  size_t vertexCount = 129 * 129;
+  GLTF::MeshOptimizer::VertexFetchStatistics before =
+      GLTF::MeshOptimizer::analyzeVertexFetch(shuffled, vertexCount, 12);
+  GLTF::MeshOptimizer::optimizeVertexCache(&shuffled, vertexCount);
+  GLTF::MeshOptimizer::optimizeVertexFetch(&shuffled, vertexCount);
+  GLTF::MeshOptimizer::VertexFetchStatistics after =
+      GLTF::MeshOptimizer::analyzeVertexFetch(shuffled, vertexCount, 12);
+  EXPECT_GT(before.getOverfetch(), 10.0f);
+  EXPECT_LT(after.getOverfetch(), 2.0f);
+}
+
+TEST(GLTFMeshOptimizerTest, OptimizeOverdraw) {
+  // Two disconnected quads facing +z, one in front of the other
+  std::vector<float> positions = {0, 0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 0,
+                                  0, 0, 1, 1, 0, 1, 0, 1, 1, 1, 1, 1};
+  std::vector<unsigned int> indices = {0, 1, 3, 0, 3, 2, 4, 5, 7, 4, 7, 6};
+  std::vector<unsigned int> optimized = indices;
+  GLTF::MeshOptimizer::optimizeOverdraw(&optimized, positions, 1.05f);
+  EXPECT_EQ(optimized,
+            std::vector<unsigned int>({4, 5, 7, 4, 7, 6, 0, 1, 3, 0, 3, 2}));
+
+  // Reordering clusters keeps every triangle
+  std::vector<unsigned int> grid = shuffledGrid(32);
+  std::vector<float> gridPositions;
+  for (unsigned int y = 0; y <= 32; y++) {
+    for (unsigned int x = 0; x <= 32; x++) {
+      gridPositions.insert(gridPositions.end(),
+                           {static_cast<float>(x), static_cast<float>(y), 0});
+    }
+  }
+  GLTF::MeshOptimizer::optimizeVertexCache(&grid, 33 * 33);
+  optimized = grid;
+  GLTF::MeshOptimizer::optimizeOverdraw(&optimized, gridPositions, 1.05f);
+  EXPECT_EQ(getTriangles(grid), getTriangles(optimized));
+}
+
+TEST(GLTFMeshOptimizerTest, WeldVertices) {
+  // Vertices 2 and 3 differ by float noise across a grid cell boundary
+  std::vector<float> positions = {0,     0, 0, 1,          1, 1,
+                                  0.5f,  0, 0, 0.500001f,  0, 0,
+                                  1e-6f, 1, 1, 1.0000001f, 1, 1};
+  std::vector<float> normals = {0, 0, 1, 0, 0, 1, 0, 0, 1,
+                                0, 0, 1, 0, 0, 1, 0, 1, 0};
+  GLTF::MeshOptimizer::WeldAttribute normal;
+  normal.values = normals.data();
+  normal.numberOfComponents = 3;
+  normal.tolerance = 0.001f;
+  std::vector<unsigned int> remap =
+      GLTF::MeshOptimizer::weldVertices(positions, 1e-5f, {normal});
+  // Vertex 5 is within tolerance of vertex 1, but has a different normal
+  EXPECT_EQ(remap, std::vector<unsigned int>({0, 1, 2, 2, 3, 4}));
+
+  remap = GLTF::MeshOptimizer::weldVertices(positions, 0, {});
+  EXPECT_EQ(remap, std::vector<unsigned int>({0, 1, 2, 3, 4, 5}));
+}
+
+TEST(GLTFMeshOptimizerTest, WeldVertices_OutOfRange) {
+  // Non-finite positions are kept, and positions far outside the grid with
+  // a tiny tolerance still weld
+  float infinity = std::numeric_limits<float>::infinity();
+  float nan = std::numeric_limits<float>::quiet_NaN();
+  std::vector<float> positions = {nan,  0,    0,        nan,   0, 0,
+                                  1e30, 1e30, 1e30,     1e30,  1e30, 1e30,
+                                  0,    0,    infinity, -1e30, 0,    0};
+  std::vector<unsigned int> remap =
+      GLTF::MeshOptimizer::weldVertices(positions, 1e-30f, {});
+  EXPECT_EQ(remap, std::vector<unsigned int>({0, 1, 2, 2, 3, 4}));
+}
+
+TEST(GLTFMeshOptimizerTest, RemoveDegenerateTriangles) {
+  std::vector<unsigned int> indices = {0, 1, 2, 2, 2, 3, 1, 3, 1, 1, 2, 3};
+  EXPECT_EQ(GLTF::MeshOptimizer::removeDegenerateTriangles(&indices), 2);
+  EXPECT_EQ(indices, std::vector<unsigned int>({0, 1, 2, 1, 2, 3}));
+}
+
+TEST(GLTFMeshOptimizerTest, SplitIndices) {
+  std::vector<unsigned int> indices = shuffledGrid(16);
+  std::vector<GLTF::MeshOptimizer::IndexChunk> chunks =
+      GLTF::MeshOptimizer::splitIndices(indices, 3, 100);
+  EXPECT_GT(chunks.size(), 1);
+
+  // Chunks keep every triangle, in order
+  std::vector<unsigned int> joined;
+  for (const GLTF::MeshOptimizer::IndexChunk& chunk : chunks) {
+    EXPECT_LE(chunk.vertices.size(), 100);
+    EXPECT_EQ(chunk.indices.size() % 3, 0);
+    for (unsigned int index : chunk.indices) {
+      joined.push_back(chunk.vertices[index]);
+    }
+  }
+  EXPECT_EQ(joined, indices);
+
+  chunks = GLTF::MeshOptimizer::splitIndices({5, 2, 2, 7}, 2, 2);
+  EXPECT_EQ(chunks.size(), 2);
+  EXPECT_EQ(chunks[0].vertices, std::vector<unsigned int>({5, 2}));
+  EXPECT_EQ(chunks[0].indices, std::vector<unsigned int>({0, 1}));
+  EXPECT_EQ(chunks[1].vertices, std::vector<unsigned int>({2, 7}));
+  EXPECT_EQ(chunks[1].indices, std::vector<unsigned int>({0, 1}));
+}
+
+/**
+ * Gets the positions of a `size` by `size` grid of quads in the XY plane,
+ * with heights from `height`.
+ */
+std::vector<float> getGridPositions(unsigned int size,
+                                    float (*height)(float, float)) {
+  std::vector<float> positions;
+  for (unsigned int y = 0; y <= size; y++) {
+    for (unsigned int x = 0; x <= size; x++) {
+      positions.push_back(static_cast<float>(x));
+      positions.push_back(static_cast<float>(y));
+      positions.push_back(height(static_cast<float>(x), static_cast<float>(y)));
+    }
+  }
+  return positions;
+}
+
+TEST(GLTFMeshOptimizerTest, Simplify) {
+  std::vector<unsigned int> indices = shuffledGrid(16);
+  std::vector<float> positions =
+      getGridPositions(16, [](float /* x */, float /* y */) { return 0.0f; });
+  std::vector<unsigned int> simplified =
+      GLTF::MeshOptimizer::simplify(indices, positions, 0, 0.01f);
+  // The flat interior collapses onto the locked border
+  EXPECT_LT(simplified.size(), indices.size() / 4);
+  std::set<unsigned int> used(simplified.begin(), simplified.end());
+  for (unsigned int i = 0; i <= 16; i++) {
+    EXPECT_EQ(used.count(i), 1);
+    EXPECT_EQ(used.count(16 * 17 + i), 1);
+    EXPECT_EQ(used.count(i * 17), 1);
+    EXPECT_EQ(used.count(i * 17 + 16), 1);
+  }
+  // No triangle flips
+  for (size_t i = 0; i < simplified.size(); i += 3) {
+    const float* a = &positions[simplified[i] * 3];
+    const float* b = &positions[simplified[i + 1] * 3];
+    const float* c = &positions[simplified[i + 2] * 3];
+    float z = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+    EXPECT_GT(z, 0);
+  }
+}
+
+TEST(GLTFMeshOptimizerTest, Simplify_TargetIndexCount) {
+  std::vector<unsigned int> indices = shuffledGrid(16);
+  std::vector<float> positions = getGridPositions(
+      16, [](float x, float y) { return std::sin(x) * std::cos(y); });
+  std::vector<unsigned int> simplified =
+      GLTF::MeshOptimizer::simplify(indices, positions, 600, 1.0f);
+  EXPECT_LE(simplified.size(), 600);
+  EXPECT_GT(simplified.size(), 400);
+
+  // A small error limit keeps the curved surface
+  simplified = GLTF::MeshOptimizer::simplify(indices, positions, 0, 0.0001f);
+  EXPECT_GT(simplified.size(), indices.size() * 9 / 10);
+}
@@ -0,0 +1,124 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "GLTFMeshoptCodecTest.h"
+
+#include <vector>
+
+#include "GLTFMeshoptCodec.h"
+
+TEST(GLTFMeshoptCodecTest, EncodeVertexBuffer) {
+  // A slowly changing float attribute, so deltas compress well
+  std::vector<float> vertices;
+  for (int i = 0; i < 1000; i++) {
+    vertices.push_back(i * 0.5f);
+    vertices.push_back(1.0f);
+    vertices.push_back(-i * 0.25f);
+    vertices.push_back(0.0f);
+  }
+  const unsigned char* bytes =
+      reinterpret_cast<const unsigned char*>(vertices.data());
+  std::vector<unsigned char> data =
+      GLTF::MeshoptCodec::encodeVertexBuffer(bytes, 1000, 16);
+  EXPECT_EQ(data[0], 0xa0);
+  EXPECT_LT(data.size(), vertices.size() * sizeof(float) / 2);
+
+  std::vector<float> decoded(vertices.size());
+  ASSERT_TRUE(GLTF::MeshoptCodec::decodeVertexBuffer(
+      reinterpret_cast<unsigned char*>(decoded.data()), 1000, 16, data));
+  EXPECT_EQ(decoded, vertices);
+}
+
+TEST(GLTFMeshoptCodecTest, EncodeVertexBuffer_Empty) {
+  std::vector<unsigned char> data =
+      GLTF::MeshoptCodec::encodeVertexBuffer(NULL, 0, 12);
+  // The header and the padded tail
+  EXPECT_EQ(data.size(), 33);
+  EXPECT_TRUE(GLTF::MeshoptCodec::decodeVertexBuffer(NULL, 0, 12, data));
+}
+
+TEST(GLTFMeshoptCodecTest, EncodeIndexBuffer) {
+  // A grid of quads, followed by a restart at 0, 1, 2 and a far triangle
+  std::vector<unsigned int> indices;
+  for (unsigned int y = 0; y < 20; y++) {
+    for (unsigned int x = 0; x < 20; x++) {
+      unsigned int a = y * 21 + x;
+      unsigned int c = a + 21;
+      indices.insert(indices.end(), {a, a + 1, c + 1, a, c + 1, c});
+    }
+  }
+  indices.insert(indices.end(), {0, 1, 2, 100000, 5, 70000});
+  std::vector<unsigned char> data =
+      GLTF::MeshoptCodec::encodeIndexBuffer(indices.data(), indices.size());
+  EXPECT_EQ(data[0], 0xe1);
+  EXPECT_LT(data.size(), indices.size());
+
+  std::vector<unsigned int> decoded(indices.size());
+  ASSERT_TRUE(GLTF::MeshoptCodec::decodeIndexBuffer(decoded.data(),
+                                                    decoded.size(), data));
+  // Triangles may be rotated, keeping their winding
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    bool matches = false;
+    for (size_t r = 0; r < 3; r++) {
+      matches = matches || (decoded[i] == indices[i + r] &&
+                            decoded[i + 1] == indices[i + (r + 1) % 3] &&
+                            decoded[i + 2] == indices[i + (r + 2) % 3]);
+    }
+    EXPECT_TRUE(matches);
+  }
+}
+
+TEST(GLTFMeshoptCodecTest, EncodeIndexSequence) {
+  std::vector<unsigned int> indices = {0,   1,  2,   3,     100, 4,
+                                       101, 5,  102, 70000, 6,   0xffffffff};
+  std::vector<unsigned char> data =
+      GLTF::MeshoptCodec::encodeIndexSequence(indices.data(), indices.size());
+  EXPECT_EQ(data[0], 0xd1);
+
+  std::vector<unsigned int> decoded(indices.size());
+  ASSERT_TRUE(GLTF::MeshoptCodec::decodeIndexSequence(decoded.data(),
+                                                      decoded.size(), data));
+  EXPECT_EQ(decoded, indices);
+}
+
+TEST(GLTFMeshoptCodecTest, EncodeVertexBuffer_ExpectedBytes) {
+  // Two vertices, worked through by hand from the EXT_meshopt_compression
+  // bitstream specification
+  unsigned char vertices[8] = {10, 20, 30, 40, 12, 20, 29, 240};
+  std::vector<unsigned char> data =
+      GLTF::MeshoptCodec::encodeVertexBuffer(vertices, 2, 4);
+  std::vector<unsigned char> expected = {
+      0xa0,
+      // Byte 0 deltas 0, +2 zigzag to 0, 4: 2-bit group, 4 escaped
+      0x01, 0x30, 0x00, 0x00, 0x00, 0x04,
+      // Byte 1 deltas are all 0
+      0x00,
+      // Byte 2 deltas 0, -1 zigzag to 0, 1: 2-bit group
+      0x01, 0x10, 0x00, 0x00, 0x00,
+      // Byte 3 deltas 0, -56 zigzag to 0, 111: 2-bit group, 111 escaped
+      0x01, 0x30, 0x00, 0x00, 0x00, 0x6f};
+  // The tail is the first vertex, padded to 32 bytes
+  expected.insert(expected.end(), 28, 0x00);
+  expected.insert(expected.end(), {10, 20, 30, 40});
+  EXPECT_EQ(data, expected);
+}
+
+TEST(GLTFMeshoptCodecTest, EncodeIndexBuffer_ExpectedBytes) {
+  // Three triangles, worked through by hand from the EXT_meshopt_compression
+  // bitstream specification
+  std::vector<unsigned int> indices = {0, 1, 2, 2, 1, 3, 3, 1, 10};
+  std::vector<unsigned char> data =
+      GLTF::MeshoptCodec::encodeIndexBuffer(indices.data(), indices.size());
+  std::vector<unsigned char> expected = {
+      0xe1,
+      // 0, 1, 2 are all the next vertex: codeaux 0x00, table entry 0
+      0xf0,
+      // 2, 1 is edge 1 of the FIFO, and 3 is the next vertex
+      0x10,
+      // 3, 1 is edge 1 of the FIFO, and 10 is coded explicitly
+      0x1f,
+      // 10 as a zigzag varint delta from the last explicit index, 0
+      0x14,
+      // The codeaux table
+      0x00, 0x76, 0x87, 0x56, 0x67, 0x78, 0xa9, 0x86, 0x65, 0x89, 0x68, 0x98,
+      0x01, 0x69, 0x00, 0x00};
+  EXPECT_EQ(data, expected);
+}
@@ -0,0 +1,60 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "GLTFThreadPoolTest.h"
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "GLTFThreadPool.h"
+
+TEST(GLTFThreadPoolTest, Submit) {
+  GLTF::ThreadPool pool(4);
+  std::vector<std::future<int>> futures;
+  for (int i = 0; i < 100; i++) {
+    futures.push_back(pool.submit([i]() { return i * i; }));
+  }
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(futures[i].get(), i * i);
+  }
+}
+
+TEST(GLTFThreadPoolTest, Wait) {
+  GLTF::ThreadPool pool(1);
+  std::atomic<bool> started(false);
+  std::future<int> future = pool.submit([&started]() {
+    started = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    return 1;
+  });
+  while (!started) {
+    std::this_thread::yield();
+  }
+  // With nothing else queued, the waiting thread sleeps instead of spinning
+  std::clock_t start = std::clock();
+  pool.wait(future);
+  double seconds = static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+  EXPECT_EQ(future.get(), 1);
+  EXPECT_LT(seconds, 0.1);
+}
+
+TEST(GLTFThreadPoolTest, ParallelFor) {
+  GLTF::ThreadPool pool(4);
+  std::vector<int> calls(1000, 0);
+  pool.parallelFor(calls.size(), [&calls](size_t i) { calls[i]++; });
+  for (int count : calls) {
+    EXPECT_EQ(count, 1);
+  }
+}
+
+TEST(GLTFThreadPoolTest, ParallelFor_Nested) {
+  // Every worker is busy running an outer task that waits on inner tasks
+  GLTF::ThreadPool pool(2);
+  std::atomic<int> sum(0);
+  pool.parallelFor(8, [&pool, &sum](size_t /* i */) {
+    pool.parallelFor(8, [&sum](size_t j) { sum += static_cast<int>(j); });
+  });
+  EXPECT_EQ(sum.load(), 8 * 28);
+}
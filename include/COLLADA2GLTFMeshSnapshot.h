@@ -0,0 +1,83 @@
+// Copyright 2020 The Khronos® Group Inc.
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "GLTFPrimitive.h"
+
+namespace COLLADA2GLTF {
+/**
+ * The vertex data and primitives of a COLLADA mesh, in the form needed to
+ * build glTF primitives from it.
+ *
+ * A snapshot initially references the arrays of the mesh it was taken from.
+ * Calling `own` copies them into the snapshot, so that it stays valid after the
+ * loader has freed the mesh and can be converted on another thread.
+ */
+class MeshSnapshot {
+ public:
+  /** A float or double array of vertex components. */
+  class VertexData {
+   public:
+    const float* floatValues = NULL;
+    const double* doubleValues = NULL;
+    size_t count = 0;
+    // Values per vertex, or 0 if the source did not declare a stride.
+    unsigned int stride = 0;
+
+    /** Gets the value at `index` as a float. */
+    float getValue(size_t index) const;
+  };
+
+  /** The indices of one texture coordinate or color set in a primitive. */
+  class IndexList {
+   public:
+    const unsigned int* indices = NULL;
+    unsigned int setIndex = 0;
+  };
+
+  class Primitive {
+   public:
+    GLTF::Primitive::Mode mode = GLTF::Primitive::Mode::UNKNOWN;
+    // Polygons that need to be split into triangles using `faceVertexCounts`
+    bool triangulate = false;
+    int materialId = 0;
+    size_t count = 0;
+    const unsigned int* positionIndices = NULL;
+    const unsigned int* normalIndices = NULL;
+    const unsigned int* binormalIndices = NULL;
+    const unsigned int* tangentIndices = NULL;
+    std::vector<IndexList> uvCoordIndices;
+    std::vector<IndexList> colorIndices;
+    std::vector<unsigned int> faceVertexCounts;
+  };
+
+  std::string name;
+  std::string stringId;
+  VertexData positions;
+  VertexData normals;
+  VertexData binormals;
+  VertexData tangents;
+  VertexData uvCoords;
+  VertexData colors;
+  std::vector<Primitive> primitives;
+
+  MeshSnapshot() = default;
+  MeshSnapshot(const MeshSnapshot&) = delete;
+  MeshSnapshot& operator=(const MeshSnapshot&) = delete;
+
+  /**
+   * Copies all referenced vertex data and indices into the snapshot.
+   */
+  void own();
+
+ private:
+  std::vector<std::vector<float>> _floatValues;
+  std::vector<std::vector<double>> _doubleValues;
+  std::vector<std::vector<unsigned int>> _indices;
+
+  void ownVertexData(VertexData* data);
+  const unsigned int* ownIndices(const unsigned int* indices, size_t count);
+};
+}  // namespace COLLADA2GLTF
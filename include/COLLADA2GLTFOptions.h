@@ -12,5 +12,7 @@ class Options : public GLTF::Options {
   std::string basePath;
   std::string outputPath;
   bool invertTransparency = false;
+  bool pipeline = false;
+  bool splitPrimitives = false;
 };
 }  // namespace COLLADA2GLTF
@@ -0,0 +1,50 @@
+// Copyright 2020 The Khronos® Group Inc.
+#pragma once
+
+#include <cstddef>
+
+namespace COLLADA2GLTF {
+/**
+ * Gathers the components of indexed vertices from a COLLADA source array into
+ * a tightly packed float array, converting each value as it goes:
+ *
+ *   output[j * numberOfComponents + k] =
+ *       float(source[indices[j] * stride + k]) * scale[k] + offset[k]
+ *
+ * This covers the conversions applied while building primitives: the asset
+ * scale for positions (`offset` of `-0.0`, which preserves negative zeros) and
+ * the V flip for texture coordinates (`scale` of `-1` and `offset` of `1`).
+ *
+ * Uses AVX2 or SSE2 when the compiler targets them, and scalar code otherwise.
+ *
+ * @param indices The vertex index of each output vertex
+ * @param count The number of output vertices
+ * @param source The COLLADA source values
+ * @param sourceCount The number of values in `source`
+ * @param stride The number of source values per vertex
+ * @param numberOfComponents The number of components to gather per vertex
+ * @param scale The factor to multiply each component by
+ * @param offset The value to add to each component
+ * @param output Receives `count * numberOfComponents` values
+ */
+void gatherVertexData(const unsigned int* indices, size_t count,
+                      const float* source, size_t sourceCount,
+                      unsigned int stride, unsigned int numberOfComponents,
+                      const float* scale, const float* offset, float* output);
+void gatherVertexData(const unsigned int* indices, size_t count,
+                      const double* source, size_t sourceCount,
+                      unsigned int stride, unsigned int numberOfComponents,
+                      const float* scale, const float* offset, float* output);
+
+/**
+ * The scalar implementations of `gatherVertexData`.
+ */
+void gatherVertexDataScalar(const unsigned int* indices, size_t count,
+                            const float* source, unsigned int stride,
+                            unsigned int numberOfComponents, const float* scale,
+                            const float* offset, float* output);
+void gatherVertexDataScalar(const unsigned int* indices, size_t count,
+                            const double* source, unsigned int stride,
+                            unsigned int numberOfComponents, const float* scale,
+                            const float* offset, float* output);
+}  // namespace COLLADA2GLTF
@@ -0,0 +1,50 @@
+// Copyright 2020 The Khronos® Group Inc.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace COLLADA2GLTF {
+/**
+ * Open-addressing hash table used to weld identical vertices while building
+ * glTF primitives.
+ *
+ * A vertex is a fixed number of float components (all of its semantics laid
+ * out one after another). Vertices are compared by the bit patterns of their
+ * components, so two corners share an index only if every value that would be
+ * written for them is identical.
+ */
+class VertexHashTable {
+ private:
+  size_t _vertexLength;
+  size_t _mask;
+  size_t _size;
+  std::vector<uint32_t> _vertices;
+  std::vector<unsigned int> _slots;
+
+  uint64_t hash(const uint32_t* vertex) const;
+  void grow();
+
+ public:
+  /**
+   * @param vertexLength The number of float components in each vertex
+   * @param capacity The expected number of vertices, used to size the table
+   * up front so that it does not need to rehash while building
+   */
+  VertexHashTable(size_t vertexLength, size_t capacity);
+
+  /**
+   * Finds the index of a vertex with identical components, adding the vertex
+   * to the table if it has not been seen before.
+   *
+   * @param vertex The `vertexLength` components of the vertex
+   * @param inserted Set to `true` if the vertex was added by this call
+   * @return The index of the vertex, in order of first insertion
+   */
+  unsigned int findOrInsert(const float* vertex, bool* inserted);
+
+  /** The number of unique vertices in the table. */
+  size_t size() const;
+};
+}  // namespace COLLADA2GLTF
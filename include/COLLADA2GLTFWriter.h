@@ -1,17 +1,23 @@
 // Copyright 2020 The Khronos® Group Inc.
 #pragma once
 
+#include <deque>
+#include <future>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #include "COLLADA2GLTFExtrasHandler.h"
+#include "COLLADA2GLTFMeshSnapshot.h"
 #include "COLLADA2GLTFOptions.h"
 #include "COLLADABU.h"
 #include "COLLADAFW.h"
 #include "GLTFAsset.h"
+#include "GLTFThreadPool.h"
 #include "draco/compression/encode.h"
 
 namespace COLLADA2GLTF {
@@ -60,6 +66,27 @@ class Writer : public COLLADAFW::IWriter {
       _effectTextureMapping;
   std::map<COLLADAFW::UniqueId, COLLADAFW::UniqueId> _meshMorphTargets;
   std::map<std::string, std::vector<COLLADAFW::UniqueId>> _animationClips;
+  GLTF::ThreadPool* _threadPool = NULL;
+
+  /** A glTF mesh converted from a <COLLADA2GLTF::MeshSnapshot>. */
+  struct MeshResult {
+    GLTF::Mesh* mesh = NULL;
+    std::map<int, std::set<GLTF::Primitive*>> materialPrimitiveMapping;
+    std::map<GLTF::Primitive*, std::vector<unsigned int>> positionMapping;
+    std::map<unsigned int, unsigned int> texCoordSetMapping;
+    bool success = true;
+  };
+  std::deque<std::pair<COLLADAFW::UniqueId, std::future<MeshResult>>>
+      _pendingMeshes;
+
+  /** A glTF primitive converted from a <COLLADA2GLTF::MeshSnapshot>. */
+  struct MeshPrimitiveResult {
+    GLTF::Primitive* primitive = NULL;
+    int materialId = 0;
+    std::vector<unsigned int> positionMapping;
+    std::map<unsigned int, unsigned int> texCoordSetMapping;
+    bool success = true;
+  };
 
   bool writeNodeToGroup(std::vector<GLTF::Node*>* group,
                         const COLLADAFW::Node* node);
@@ -70,10 +97,23 @@ class Writer : public COLLADAFW::IWriter {
                                     COLLADAFW::SamplerID samplerId);
   GLTF::Texture* fromColladaTexture(const COLLADAFW::EffectCommon* effectCommon,
                                     COLLADAFW::Texture texture);
+  GLTF::ThreadPool* getThreadPool();
+  MeshResult buildMesh(const MeshSnapshot& snapshot);
+  std::vector<MeshPrimitiveResult> writeMeshPrimitive(
+      const MeshSnapshot& snapshot,
+      const MeshSnapshot::Primitive& colladaPrimitive);
+  bool writePrimitiveAccessors(
+      GLTF::Primitive* primitive,
+      std::map<std::string, std::vector<float>>&& buildAttributes,
+      std::vector<unsigned int>&& buildIndices, size_t vertexCount);
+  bool storeMesh(const COLLADAFW::UniqueId& uniqueId, MeshResult* result);
+  bool waitForMesh(const COLLADAFW::UniqueId& uniqueId);
+  bool waitForMeshes();
 
  public:
   Writer(COLLADASaxFWL::Loader* loader, GLTF::Asset* asset,
          COLLADA2GLTF::Options* options, COLLADA2GLTF::ExtrasHandler* handler);
+  ~Writer();
 
   /**
    * Get animation groupings (from animation clips) by index.
@@ -114,6 +154,13 @@ class Writer : public COLLADAFW::IWriter {
 
   bool writeMesh(const COLLADAFW::Mesh* mesh);
 
+  /**
+   * References vertex data in a snapshot. Sources the mesh does not have are
+   * of unknown type and are left empty.
+   */
+  static void snapshotMeshVertexData(const COLLADAFW::MeshVertexData& data,
+                                     MeshSnapshot::VertexData* snapshot);
+
   /** Writes the geometry.
    @return True on succeeded, false otherwise.*/
   virtual bool writeGeometry(const COLLADAFW::Geometry* geometry);
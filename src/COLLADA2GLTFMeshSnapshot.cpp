@@ -0,0 +1,52 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "COLLADA2GLTFMeshSnapshot.h"
+
+#include <initializer_list>
+
+float COLLADA2GLTF::MeshSnapshot::VertexData::getValue(size_t index) const {
+  if (doubleValues != NULL) {
+    return static_cast<float>(doubleValues[index]);
+  }
+  return floatValues[index];
+}
+
+void COLLADA2GLTF::MeshSnapshot::own() {
+  for (VertexData* data :
+       {&positions, &normals, &binormals, &tangents, &uvCoords, &colors}) {
+    ownVertexData(data);
+  }
+  for (Primitive& primitive : primitives) {
+    size_t count = primitive.count;
+    primitive.positionIndices = ownIndices(primitive.positionIndices, count);
+    primitive.normalIndices = ownIndices(primitive.normalIndices, count);
+    primitive.binormalIndices = ownIndices(primitive.binormalIndices, count);
+    primitive.tangentIndices = ownIndices(primitive.tangentIndices, count);
+    for (IndexList& indexList : primitive.uvCoordIndices) {
+      indexList.indices = ownIndices(indexList.indices, count);
+    }
+    for (IndexList& indexList : primitive.colorIndices) {
+      indexList.indices = ownIndices(indexList.indices, count);
+    }
+  }
+}
+
+void COLLADA2GLTF::MeshSnapshot::ownVertexData(VertexData* data) {
+  if (data->doubleValues != NULL) {
+    _doubleValues.emplace_back(data->doubleValues,
+                               data->doubleValues + data->count);
+    data->doubleValues = _doubleValues.back().data();
+  } else if (data->floatValues != NULL) {
+    _floatValues.emplace_back(data->floatValues,
+                              data->floatValues + data->count);
+    data->floatValues = _floatValues.back().data();
+  }
+}
+
+const unsigned int* COLLADA2GLTF::MeshSnapshot::ownIndices(
+    const unsigned int* indices, size_t count) {
+  if (indices == NULL) {
+    return NULL;
+  }
+  _indices.emplace_back(indices, indices + count);
+  return _indices.back().data();
+}
@@ -0,0 +1,249 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "COLLADA2GLTFVertexGather.h"
+
+#include <cstdint>
+#include <limits>
+
+#if defined(__AVX2__)
+#define GATHER_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GATHER_SSE2
+#include <emmintrin.h>
+#endif
+
+template <typename T>
+void gatherScalar(const unsigned int* indices, size_t begin, size_t end,
+                  const T* source, unsigned int stride,
+                  unsigned int numberOfComponents, const float* scale,
+                  const float* offset, float* output) {
+  for (size_t j = begin; j < end; j++) {
+    const T* vertex = source + static_cast<size_t>(indices[j]) * stride;
+    float* outputVertex = output + j * numberOfComponents;
+    for (unsigned int k = 0; k < numberOfComponents; k++) {
+      outputVertex[k] = static_cast<float>(vertex[k]) * scale[k] + offset[k];
+    }
+  }
+}
+
+#if defined(GATHER_AVX2)
+/**
+ * Lane patterns for gathering blocks of 8 vertices. A block produces
+ * `numberOfComponents` vectors of 8 output values; lane `l` of vector `v` is
+ * component `(8v + l) % numberOfComponents` of vertex `(8v + l) /
+ * numberOfComponents` in the block.
+ */
+struct GatherLanes {
+  __m256i vertices[4];
+  __m256i components[4];
+  __m256 scale[4];
+  __m256 offset[4];
+
+  GatherLanes(unsigned int numberOfComponents, const float* scale,
+              const float* offset) {
+    for (unsigned int v = 0; v < numberOfComponents; v++) {
+      int vertexLanes[8];
+      int componentLanes[8];
+      float scaleLanes[8];
+      float offsetLanes[8];
+      for (unsigned int l = 0; l < 8; l++) {
+        unsigned int position = v * 8 + l;
+        unsigned int k = position % numberOfComponents;
+        vertexLanes[l] = position / numberOfComponents;
+        componentLanes[l] = k;
+        scaleLanes[l] = scale[k];
+        offsetLanes[l] = offset[k];
+      }
+      this->vertices[v] = _mm256_loadu_si256((const __m256i*)vertexLanes);
+      this->components[v] = _mm256_loadu_si256((const __m256i*)componentLanes);
+      this->scale[v] = _mm256_loadu_ps(scaleLanes);
+      this->offset[v] = _mm256_loadu_ps(offsetLanes);
+    }
+  }
+};
+
+size_t gatherAVX2(const unsigned int* indices, size_t count,
+                  const float* source, unsigned int stride,
+                  unsigned int numberOfComponents, const float* scale,
+                  const float* offset, float* output) {
+  GatherLanes lanes(numberOfComponents, scale, offset);
+  __m256i strideVector = _mm256_set1_epi32(stride);
+  size_t blockCount = count / 8;
+  for (size_t b = 0; b < blockCount; b++) {
+    __m256i blockIndices =
+        _mm256_loadu_si256((const __m256i*)(indices + b * 8));
+    float* blockOutput = output + b * 8 * numberOfComponents;
+    for (unsigned int v = 0; v < numberOfComponents; v++) {
+      __m256i vertexIndices =
+          _mm256_permutevar8x32_epi32(blockIndices, lanes.vertices[v]);
+      __m256i valueIndices =
+          _mm256_add_epi32(_mm256_mullo_epi32(vertexIndices, strideVector),
+                           lanes.components[v]);
+      __m256 values = _mm256_i32gather_ps(source, valueIndices, 4);
+      values = _mm256_add_ps(_mm256_mul_ps(values, lanes.scale[v]),
+                             lanes.offset[v]);
+      _mm256_storeu_ps(blockOutput + v * 8, values);
+    }
+  }
+  return blockCount * 8;
+}
+
+size_t gatherAVX2(const unsigned int* indices, size_t count,
+                  const double* source, unsigned int stride,
+                  unsigned int numberOfComponents, const float* scale,
+                  const float* offset, float* output) {
+  GatherLanes lanes(numberOfComponents, scale, offset);
+  __m256i strideVector = _mm256_set1_epi32(stride);
+  size_t blockCount = count / 8;
+  for (size_t b = 0; b < blockCount; b++) {
+    __m256i blockIndices =
+        _mm256_loadu_si256((const __m256i*)(indices + b * 8));
+    float* blockOutput = output + b * 8 * numberOfComponents;
+    for (unsigned int v = 0; v < numberOfComponents; v++) {
+      __m256i vertexIndices =
+          _mm256_permutevar8x32_epi32(blockIndices, lanes.vertices[v]);
+      __m256i valueIndices =
+          _mm256_add_epi32(_mm256_mullo_epi32(vertexIndices, strideVector),
+                           lanes.components[v]);
+      __m128 low = _mm256_cvtpd_ps(_mm256_i32gather_pd(
+          source, _mm256_castsi256_si128(valueIndices), 8));
+      __m128 high = _mm256_cvtpd_ps(_mm256_i32gather_pd(
+          source, _mm256_extracti128_si256(valueIndices, 1), 8));
+      __m256 values =
+          _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+      values = _mm256_add_ps(_mm256_mul_ps(values, lanes.scale[v]),
+                             lanes.offset[v]);
+      _mm256_storeu_ps(blockOutput + v * 8, values);
+    }
+  }
+  return blockCount * 8;
+}
+#elif defined(GATHER_SSE2)
+/**
+ * Converts one vertex at a time with 4-wide loads and stores. A vertex is
+ * only handled here if loading 4 values stays within the source array and
+ * storing 4 values stays within the output; any values stored past the
+ * vertex's own components are overwritten by the vertices after it.
+ */
+size_t gatherSSE2(const unsigned int* indices, size_t count,
+                  const float* source, size_t sourceCount, unsigned int stride,
+                  unsigned int numberOfComponents, const float* scale,
+                  const float* offset, float* output) {
+  float scaleLanes[4] = {1, 1, 1, 1};
+  float offsetLanes[4] = {-0.0f, -0.0f, -0.0f, -0.0f};
+  for (unsigned int k = 0; k < numberOfComponents; k++) {
+    scaleLanes[k] = scale[k];
+    offsetLanes[k] = offset[k];
+  }
+  __m128 scaleVector = _mm_loadu_ps(scaleLanes);
+  __m128 offsetVector = _mm_loadu_ps(offsetLanes);
+  size_t outputCount = count * numberOfComponents;
+  size_t j = 0;
+  for (; j < count && j * numberOfComponents + 4 <= outputCount; j++) {
+    size_t base = static_cast<size_t>(indices[j]) * stride;
+    if (base + 4 > sourceCount) {
+      gatherScalar(indices, j, j + 1, source, stride, numberOfComponents,
+                   scale, offset, output);
+      continue;
+    }
+    __m128 values = _mm_loadu_ps(source + base);
+    values = _mm_add_ps(_mm_mul_ps(values, scaleVector), offsetVector);
+    _mm_storeu_ps(output + j * numberOfComponents, values);
+  }
+  return j;
+}
+
+size_t gatherSSE2(const unsigned int* indices, size_t count,
+                  const double* source, size_t sourceCount,
+                  unsigned int stride, unsigned int numberOfComponents,
+                  const float* scale, const float* offset, float* output) {
+  float scaleLanes[4] = {1, 1, 1, 1};
+  float offsetLanes[4] = {-0.0f, -0.0f, -0.0f, -0.0f};
+  for (unsigned int k = 0; k < numberOfComponents; k++) {
+    scaleLanes[k] = scale[k];
+    offsetLanes[k] = offset[k];
+  }
+  __m128 scaleVector = _mm_loadu_ps(scaleLanes);
+  __m128 offsetVector = _mm_loadu_ps(offsetLanes);
+  size_t outputCount = count * numberOfComponents;
+  size_t j = 0;
+  for (; j < count && j * numberOfComponents + 4 <= outputCount; j++) {
+    size_t base = static_cast<size_t>(indices[j]) * stride;
+    if (base + 4 > sourceCount) {
+      gatherScalar(indices, j, j + 1, source, stride, numberOfComponents,
+                   scale, offset, output);
+      continue;
+    }
+    __m128 low = _mm_cvtpd_ps(_mm_loadu_pd(source + base));
+    __m128 high = _mm_cvtpd_ps(_mm_loadu_pd(source + base + 2));
+    __m128 values = _mm_movelh_ps(low, high);
+    values = _mm_add_ps(_mm_mul_ps(values, scaleVector), offsetVector);
+    _mm_storeu_ps(output + j * numberOfComponents, values);
+  }
+  return j;
+}
+#endif
+
+template <typename T>
+void gather(const unsigned int* indices, size_t count, const T* source,
+            size_t sourceCount, unsigned int stride,
+            unsigned int numberOfComponents, const float* scale,
+            const float* offset, float* output) {
+  size_t gathered = 0;
+  if (numberOfComponents >= 1 && numberOfComponents <= 4) {
+#if defined(GATHER_AVX2)
+    // Gather offsets are 32-bit signed integers
+    if (sourceCount <=
+        static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+      gathered = gatherAVX2(indices, count, source, stride, numberOfComponents,
+                            scale, offset, output);
+    }
+#elif defined(GATHER_SSE2)
+    gathered = gatherSSE2(indices, count, source, sourceCount, stride,
+                          numberOfComponents, scale, offset, output);
+#endif
+  }
+  gatherScalar(indices, gathered, count, source, stride, numberOfComponents,
+               scale, offset, output);
+}
+
+void COLLADA2GLTF::gatherVertexData(const unsigned int* indices, size_t count,
+                                    const float* source, size_t sourceCount,
+                                    unsigned int stride,
+                                    unsigned int numberOfComponents,
+                                    const float* scale, const float* offset,
+                                    float* output) {
+  gather(indices, count, source, sourceCount, stride, numberOfComponents,
+         scale, offset, output);
+}
+
+void COLLADA2GLTF::gatherVertexData(const unsigned int* indices, size_t count,
+                                    const double* source, size_t sourceCount,
+                                    unsigned int stride,
+                                    unsigned int numberOfComponents,
+                                    const float* scale, const float* offset,
+                                    float* output) {
+  gather(indices, count, source, sourceCount, stride, numberOfComponents,
+         scale, offset, output);
+}
+
+void COLLADA2GLTF::gatherVertexDataScalar(const unsigned int* indices,
+                                          size_t count, const float* source,
+                                          unsigned int stride,
+                                          unsigned int numberOfComponents,
+                                          const float* scale,
+                                          const float* offset, float* output) {
+  gatherScalar(indices, 0, count, source, stride, numberOfComponents, scale,
+               offset, output);
+}
+
+void COLLADA2GLTF::gatherVertexDataScalar(const unsigned int* indices,
+                                          size_t count, const double* source,
+                                          unsigned int stride,
+                                          unsigned int numberOfComponents,
+                                          const float* scale,
+                                          const float* offset, float* output) {
+  gatherScalar(indices, 0, count, source, stride, numberOfComponents, scale,
+               offset, output);
+}
@@ -0,0 +1,72 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "COLLADA2GLTFVertexHashTable.h"
+
+#include <cstring>
+#include <limits>
+
+const unsigned int EMPTY_SLOT = std::numeric_limits<unsigned int>::max();
+
+size_t slotCountForCapacity(size_t capacity) {
+  // Keep the load factor at or below one half
+  size_t slotCount = 16;
+  while (slotCount < capacity * 2) {
+    slotCount *= 2;
+  }
+  return slotCount;
+}
+
+COLLADA2GLTF::VertexHashTable::VertexHashTable(size_t vertexLength,
+                                               size_t capacity)
+    : _vertexLength(vertexLength), _size(0) {
+  size_t slotCount = slotCountForCapacity(capacity);
+  _mask = slotCount - 1;
+  _slots.assign(slotCount, EMPTY_SLOT);
+}
+
+uint64_t COLLADA2GLTF::VertexHashTable::hash(const uint32_t* vertex) const {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < _vertexLength; i++) {
+    hash = (hash ^ vertex[i]) * 0x9e3779b97f4a7c15ULL;
+  }
+  return hash ^ (hash >> 29);
+}
+
+void COLLADA2GLTF::VertexHashTable::grow() {
+  size_t slotCount = _slots.size() * 2;
+  _mask = slotCount - 1;
+  _slots.assign(slotCount, EMPTY_SLOT);
+  for (unsigned int index = 0; index < _size; index++) {
+    size_t slot = hash(&_vertices[index * _vertexLength]) & _mask;
+    while (_slots[slot] != EMPTY_SLOT) {
+      slot = (slot + 1) & _mask;
+    }
+    _slots[slot] = index;
+  }
+}
+
+unsigned int COLLADA2GLTF::VertexHashTable::findOrInsert(const float* vertex,
+                                                         bool* inserted) {
+  const uint32_t* bits = reinterpret_cast<const uint32_t*>(vertex);
+  size_t byteLength = _vertexLength * sizeof(uint32_t);
+  size_t slot = hash(bits) & _mask;
+  while (_slots[slot] != EMPTY_SLOT) {
+    unsigned int index = _slots[slot];
+    if (std::memcmp(&_vertices[index * _vertexLength], bits, byteLength) ==
+        0) {
+      *inserted = false;
+      return index;
+    }
+    slot = (slot + 1) & _mask;
+  }
+
+  unsigned int index = static_cast<unsigned int>(_size++);
+  _vertices.insert(_vertices.end(), bits, bits + _vertexLength);
+  _slots[slot] = index;
+  if (_size * 2 > _slots.size()) {
+    grow();
+  }
+  *inserted = true;
+  return index;
+}
+
+size_t COLLADA2GLTF::VertexHashTable::size() const { return _size; }
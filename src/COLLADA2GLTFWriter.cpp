@@ -1,7 +1,14 @@
 // Copyright 2020 The Khronos® Group Inc.
 #include "COLLADA2GLTFWriter.h"
 
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
 #include "Base64.h"
+#include "COLLADA2GLTFVertexGather.h"
+#include "COLLADA2GLTFVertexHashTable.h"
+#include "GLTFMeshOptimizer.h"
 
 const double PI = 3.14159;
 
@@ -13,6 +20,15 @@ COLLADA2GLTF::Writer::Writer(COLLADASaxFWL::Loader* loader, GLTF::Asset* asset,
       _options(options),
       _extrasHandler(extrasHandler) {}
 
+COLLADA2GLTF::Writer::~Writer() { delete _threadPool; }
+
+GLTF::ThreadPool* COLLADA2GLTF::Writer::getThreadPool() {
+  if (_threadPool == NULL && (_options->threads > 1 || _options->pipeline)) {
+    _threadPool = new GLTF::ThreadPool(_options->threads);
+  }
+  return _threadPool;
+}
+
 std::vector<std::vector<size_t>> COLLADA2GLTF::Writer::getAnimationGroups() {
   std::map<GLTF::Animation*, size_t> animationIndexes;
   for (size_t i = 0; i < _asset->animations.size(); i++) {
@@ -38,7 +54,11 @@ void COLLADA2GLTF::Writer::cancel(const std::string& errorMessage) {}
 
 void COLLADA2GLTF::Writer::start() {}
 
-void COLLADA2GLTF::Writer::finish() {}
+void COLLADA2GLTF::Writer::finish() {
+  if (!waitForMeshes()) {
+    std::cout << "ERROR: Unable to convert all meshes" << std::endl;
+  }
+}
 
 bool COLLADA2GLTF::Writer::writeGlobalAsset(const COLLADAFW::FileInfo* asset) {
   const COLLADAFW::FileInfo::ValuePairPointerArray& valuePairs =
@@ -554,6 +574,9 @@ bool COLLADA2GLTF::Writer::writeNodesToGroup(
 
 bool COLLADA2GLTF::Writer::writeVisualScene(
     const COLLADAFW::VisualScene* visualScene) {
+  if (!waitForMeshes()) {
+    return false;
+  }
   GLTF::Asset* asset = this->_asset;
   GLTF::Scene* scene;
   if (asset->scene >= 0) {
@@ -583,6 +606,9 @@ void RecursiveNodeDeleter(const std::vector<GLTF::Node*>& nodes) {
 
 bool COLLADA2GLTF::Writer::writeLibraryNodes(
     const COLLADAFW::LibraryNodes* libraryNodes) {
+  if (!waitForMeshes()) {
+    return false;
+  }
   GLTF::Asset* asset = this->_asset;
   GLTF::Scene* scene = asset->getDefaultScene();
 
@@ -664,23 +690,165 @@ GLTF::Accessor* bufferAndMapVertexData(
   return accessor;
 }
 
-float getMeshVertexDataAtIndex(const COLLADAFW::MeshVertexData& data,
-                               int index) {
-  COLLADAFW::FloatOrDoubleArray::DataType type = data.getType();
-  if (type == COLLADAFW::FloatOrDoubleArray::DATA_TYPE_DOUBLE) {
-    return static_cast<float>(data.getDoubleValues()->getData()[index]);
+void COLLADA2GLTF::Writer::snapshotMeshVertexData(
+    const COLLADAFW::MeshVertexData& data,
+    COLLADA2GLTF::MeshSnapshot::VertexData* snapshot) {
+  switch (data.getType()) {
+    case COLLADAFW::FloatOrDoubleArray::DATA_TYPE_DOUBLE:
+      snapshot->doubleValues = data.getDoubleValues()->getData();
+      break;
+    case COLLADAFW::FloatOrDoubleArray::DATA_TYPE_FLOAT:
+      snapshot->floatValues = data.getFloatValues()->getData();
+      break;
+    default:
+      return;
+  }
+  snapshot->count = data.getValuesCount();
+  if (data.getNumInputInfos() > 0) {
+    snapshot->stride = data.getStride(0);
   }
-  return data.getFloatValues()->getData()[index];
 }
 
-std::string buildAttributeId(const COLLADAFW::MeshVertexData& data, int index,
-                             int count) {
-  std::string id;
-  for (int i = 0; i < count; i++) {
-    id +=
-        std::to_string(getMeshVertexDataAtIndex(data, index * count + i)) + ":";
+void snapshotIndexLists(
+    const COLLADAFW::IndexListArray& indexLists,
+    std::vector<COLLADA2GLTF::MeshSnapshot::IndexList>* snapshot) {
+  for (size_t i = 0; i < indexLists.getCount(); i++) {
+    COLLADA2GLTF::MeshSnapshot::IndexList indexList;
+    indexList.indices = indexLists[i]->getIndices().getData();
+    indexList.setIndex = indexLists[i]->getSetIndex();
+    snapshot->push_back(indexList);
+  }
+}
+
+/**
+ * Takes a <COLLADA2GLTF::MeshSnapshot> referencing the data of a
+ * <COLLADAFW::Mesh>.
+ */
+void snapshotMesh(const COLLADAFW::Mesh* colladaMesh,
+                  COLLADA2GLTF::MeshSnapshot* snapshot) {
+  snapshot->name = colladaMesh->getName();
+  snapshot->stringId = colladaMesh->getOriginalId();
+  if (snapshot->name == "") {
+    snapshot->name = colladaMesh->getOriginalId();
+  }
+  COLLADA2GLTF::Writer::snapshotMeshVertexData(colladaMesh->getPositions(),
+                                                &snapshot->positions);
+  COLLADA2GLTF::Writer::snapshotMeshVertexData(colladaMesh->getNormals(),
+                                                &snapshot->normals);
+  COLLADA2GLTF::Writer::snapshotMeshVertexData(colladaMesh->getBinormals(),
+                                                &snapshot->binormals);
+  COLLADA2GLTF::Writer::snapshotMeshVertexData(colladaMesh->getTangents(),
+                                                &snapshot->tangents);
+  COLLADA2GLTF::Writer::snapshotMeshVertexData(colladaMesh->getUVCoords(),
+                                                &snapshot->uvCoords);
+  COLLADA2GLTF::Writer::snapshotMeshVertexData(colladaMesh->getColors(),
+                                                &snapshot->colors);
+
+  const COLLADAFW::MeshPrimitiveArray& meshPrimitives =
+      colladaMesh->getMeshPrimitives();
+  for (size_t i = 0; i < meshPrimitives.getCount(); i++) {
+    COLLADAFW::MeshPrimitive* colladaPrimitive = meshPrimitives[i];
+    COLLADA2GLTF::MeshSnapshot::Primitive primitive;
+    primitive.materialId = colladaPrimitive->getMaterialId();
+    switch (colladaPrimitive->getPrimitiveType()) {
+      case COLLADAFW::MeshPrimitive::LINES:
+        primitive.mode = GLTF::Primitive::Mode::LINES;
+        break;
+      case COLLADAFW::MeshPrimitive::LINE_STRIPS:
+        primitive.mode = GLTF::Primitive::Mode::LINE_STRIP;
+        break;
+      // Having POLYLIST and POLYGONS map to TRIANGLES produces good output
+      // for cases where the polygons are already triangles, but in other
+      // cases, we may need to triangulate
+      case COLLADAFW::MeshPrimitive::POLYLIST:
+      case COLLADAFW::MeshPrimitive::POLYGONS:
+        primitive.triangulate = true;
+      case COLLADAFW::MeshPrimitive::TRIANGLES:
+        primitive.mode = GLTF::Primitive::Mode::TRIANGLES;
+        break;
+      case COLLADAFW::MeshPrimitive::TRIANGLE_STRIPS:
+        primitive.mode = GLTF::Primitive::Mode::TRIANGLE_STRIP;
+        break;
+      case COLLADAFW::MeshPrimitive::TRIANGLE_FANS:
+        primitive.mode = GLTF::Primitive::Mode::TRIANGLE_FAN;
+        break;
+      case COLLADAFW::MeshPrimitive::POINTS:
+        primitive.mode = GLTF::Primitive::Mode::POINTS;
+        break;
+    }
+    primitive.count = colladaPrimitive->getPositionIndices().getCount();
+    primitive.positionIndices =
+        colladaPrimitive->getPositionIndices().getData();
+    if (colladaPrimitive->hasNormalIndices()) {
+      primitive.normalIndices = colladaPrimitive->getNormalIndices().getData();
+    }
+    if (colladaPrimitive->hasBinormalIndices()) {
+      primitive.binormalIndices =
+          colladaPrimitive->getBinormalIndices().getData();
+    }
+    if (colladaPrimitive->hasTangentIndices()) {
+      primitive.tangentIndices =
+          colladaPrimitive->getTangentIndices().getData();
+    }
+    if (colladaPrimitive->hasUVCoordIndices()) {
+      snapshotIndexLists(colladaPrimitive->getUVCoordIndicesArray(),
+                         &primitive.uvCoordIndices);
+    }
+    if (colladaPrimitive->hasColorIndices()) {
+      snapshotIndexLists(colladaPrimitive->getColorIndicesArray(),
+                         &primitive.colorIndices);
+    }
+    if (primitive.triangulate) {
+      size_t faceCount = colladaPrimitive->getGroupedVertexElementsCount();
+      for (size_t face = 0; face < faceCount; face++) {
+        primitive.faceVertexCounts.push_back(
+            colladaPrimitive->getGroupedVerticesVertexCount(face));
+      }
+    }
+    snapshot->primitives.push_back(primitive);
+  }
+}
+
+/**
+ * The COLLADA source of one semantic in a primitive, resolved once before the
+ * primitive's vertices are built.
+ */
+struct SemanticSource {
+  std::vector<float>* buildData;
+  const unsigned int* indices;
+  const COLLADA2GLTF::MeshSnapshot::VertexData* data;
+  unsigned int numberOfComponents;
+  unsigned int stride;
+  float scale[4];
+  float offset[4];
+  bool position;
+  // Converted components of the corners in the current block
+  std::vector<float> gathered;
+};
+
+// Number of corners converted at a time while building a primitive
+const size_t GATHER_BLOCK_SIZE = 4096;
+
+// Most vertices in a primitive split for UNSIGNED_SHORT indices
+const size_t MAX_SPLIT_VERTEX_COUNT = 65535;
+
+/**
+ * Converts the components of `count` corners of a semantic, starting at
+ * corner `begin`, into `source->gathered`.
+ */
+void gatherSemanticSource(SemanticSource* source, size_t begin, size_t count) {
+  const COLLADA2GLTF::MeshSnapshot::VertexData* data = source->data;
+  if (data->doubleValues != NULL) {
+    COLLADA2GLTF::gatherVertexData(
+        source->indices + begin, count, data->doubleValues, data->count,
+        source->stride, source->numberOfComponents, source->scale,
+        source->offset, source->gathered.data());
+  } else {
+    COLLADA2GLTF::gatherVertexData(
+        source->indices + begin, count, data->floatValues, data->count,
+        source->stride, source->numberOfComponents, source->scale,
+        source->offset, source->gathered.data());
   }
-  return id;
 }
 
 /**
@@ -688,299 +856,455 @@ std::string buildAttributeId(const COLLADAFW::MeshVertexData& data, int index,
  * The produced meshes are stored in `this->_meshInstances` indexed by their
  * <COLLADAFW::UniqueId>.
  *
- * COLLADA has different sets of indices per attribute in primitives while glTF
- * uses a single indices accessor for a primitive and requires attributes to be
- * aligned. Attributes are built using the the COLLADA indices, and duplicate
- * attributes are referenced by index.
+ * When pipelining is enabled, the mesh data is copied into a
+ * <COLLADA2GLTF::MeshSnapshot> and converted on the thread pool while the
+ * loader keeps parsing; the result is stored by `waitForMesh` once something
+ * depends on it. At most two meshes per pool thread are in flight, bounding
+ * the memory held by snapshots.
  *
  * @param colladaMesh The COLLADA mesh to write to glTF
  * @return `true` if the operation completed succesfully, `false` if an error
  * occured
  */
 bool COLLADA2GLTF::Writer::writeMesh(const COLLADAFW::Mesh* colladaMesh) {
-  GLTF::Mesh* mesh = new GLTF::Mesh();
-  mesh->name = colladaMesh->getName();
-  mesh->stringId = colladaMesh->getOriginalId();
-  if (mesh->name == "") {
-    mesh->name = colladaMesh->getOriginalId();
-  }
   const COLLADAFW::UniqueId& uniqueId = colladaMesh->getUniqueId();
-  std::map<GLTF::Primitive*, std::vector<unsigned int>> positionMapping;
+  std::shared_ptr<MeshSnapshot> snapshot(new MeshSnapshot());
+  snapshotMesh(colladaMesh, snapshot.get());
 
-  const COLLADAFW::MeshPrimitiveArray& meshPrimitives =
-      colladaMesh->getMeshPrimitives();
-  std::map<int, std::set<GLTF::Primitive*>> primitiveMaterialMapping;
-  std::map<unsigned int, unsigned int> texCoordSetMapping;
-  size_t meshPrimitivesCount = meshPrimitives.getCount();
-  if (meshPrimitivesCount > 0) {
-    // Create primitives
-    for (size_t i = 0; i < meshPrimitivesCount; i++) {
-      std::map<std::string, std::vector<float>> buildAttributes;
-      std::map<std::string, unsigned int> attributeIndicesMapping;
-      std::vector<unsigned int> buildIndices;
-      COLLADAFW::MeshPrimitive* colladaPrimitive = meshPrimitives[i];
-      GLTF::Primitive* primitive = new GLTF::Primitive();
-
-      int materialId = colladaPrimitive->getMaterialId();
-      std::map<int, std::set<GLTF::Primitive*>>::iterator findPrimitiveSet =
-          primitiveMaterialMapping.find(materialId);
-      if (findPrimitiveSet != primitiveMaterialMapping.end()) {
-        findPrimitiveSet->second.insert(primitive);
-      } else {
-        std::set<GLTF::Primitive*> primitiveSet;
-        primitiveSet.insert(primitive);
-        primitiveMaterialMapping[materialId] = primitiveSet;
-      }
-
-      std::vector<unsigned int> mapping;
-      bool shouldTriangulate = false;
+  GLTF::ThreadPool* threadPool = getThreadPool();
+  if (!_options->pipeline || threadPool == NULL) {
+    MeshResult result = buildMesh(*snapshot);
+    return storeMesh(uniqueId, &result);
+  }
+  if (_pendingMeshes.size() >= threadPool->size() * 2) {
+    if (!waitForMesh(_pendingMeshes.front().first)) {
+      return false;
+    }
+  }
+  snapshot->own();
+  _pendingMeshes.emplace_back(
+      uniqueId,
+      threadPool->submit([this, snapshot]() { return buildMesh(*snapshot); }));
+  return true;
+}
 
-      COLLADAFW::MeshPrimitive::PrimitiveType type =
-          colladaPrimitive->getPrimitiveType();
-      switch (colladaPrimitive->getPrimitiveType()) {
-        case COLLADAFW::MeshPrimitive::LINES:
-          primitive->mode = GLTF::Primitive::Mode::LINES;
-          break;
-        case COLLADAFW::MeshPrimitive::LINE_STRIPS:
-          primitive->mode = GLTF::Primitive::Mode::LINE_STRIP;
-          break;
-        // Having POLYLIST and POLYGONS map to TRIANGLES produces good output
-        // for cases where the polygons are already triangles, but in other
-        // cases, we may need to triangulate
-        case COLLADAFW::MeshPrimitive::POLYLIST:
-        case COLLADAFW::MeshPrimitive::POLYGONS:
-          shouldTriangulate = true;
-        case COLLADAFW::MeshPrimitive::TRIANGLES:
-          primitive->mode = GLTF::Primitive::Mode::TRIANGLES;
-          break;
-        case COLLADAFW::MeshPrimitive::TRIANGLE_STRIPS:
-          primitive->mode = GLTF::Primitive::Mode::TRIANGLE_STRIP;
-          break;
-        case COLLADAFW::MeshPrimitive::TRIANGLE_FANS:
-          primitive->mode = GLTF::Primitive::Mode::TRIANGLE_FAN;
-          break;
-        case COLLADAFW::MeshPrimitive::POINTS:
-          primitive->mode = GLTF::Primitive::Mode::POINTS;
-          break;
-          primitive->mode = GLTF::Primitive::Mode::TRIANGLES;
-          break;
-      }
+/**
+ * Builds a <GLTF::Mesh> from a <COLLADA2GLTF::MeshSnapshot>.
+ *
+ * COLLADA has different sets of indices per attribute in primitives while glTF
+ * uses a single indices accessor for a primitive and requires attributes to be
+ * aligned. Attributes are built using the the COLLADA indices, and duplicate
+ * attributes are referenced by index. Duplicates are found by hashing the
+ * bit patterns of each corner's converted components in a
+ * <COLLADA2GLTF::VertexHashTable>.
+ *
+ * This does not modify the writer, so it may run on a pool thread.
+ *
+ * @param snapshot The COLLADA mesh data to convert
+ * @return The mesh along with the mappings to store for it
+ */
+COLLADA2GLTF::Writer::MeshResult COLLADA2GLTF::Writer::buildMesh(
+    const MeshSnapshot& snapshot) {
+  MeshResult meshResult;
+  GLTF::Mesh* mesh = new GLTF::Mesh();
+  mesh->name = snapshot.name;
+  mesh->stringId = snapshot.stringId;
+  meshResult.mesh = mesh;
 
-      if (primitive->mode == GLTF::Primitive::Mode::UNKNOWN) {
-        continue;
-      }
-      size_t count = colladaPrimitive->getPositionIndices().getCount();
-      std::map<std::string, const unsigned int*> semanticIndices;
-      std::map<std::string, const COLLADAFW::MeshVertexData*> semanticData;
-      std::string semantic = "POSITION";
-      buildAttributes[semantic] = std::vector<float>();
-      semanticIndices[semantic] =
-          colladaPrimitive->getPositionIndices().getData();
-      semanticData[semantic] = &colladaMesh->getPositions();
-      primitive->attributes[semantic] = (GLTF::Accessor*)NULL;
-      if (colladaPrimitive->hasNormalIndices()) {
-        semantic = "NORMAL";
-        buildAttributes[semantic] = std::vector<float>();
-        semanticIndices[semantic] =
-            colladaPrimitive->getNormalIndices().getData();
-        semanticData[semantic] = &colladaMesh->getNormals();
-        primitive->attributes[semantic] = (GLTF::Accessor*)NULL;
-      }
-      if (colladaPrimitive->hasBinormalIndices()) {
-        semantic = "BINORMAL";
-        buildAttributes[semantic] = std::vector<float>();
-        semanticIndices[semantic] =
-            colladaPrimitive->getBinormalIndices().getData();
-        semanticData[semantic] = &colladaMesh->getBinormals();
-        primitive->attributes[semantic] = (GLTF::Accessor*)NULL;
-      }
-      if (colladaPrimitive->hasTangentIndices()) {
-        semantic = "TANGENT";
-        buildAttributes[semantic] = std::vector<float>();
-        semanticIndices[semantic] =
-            colladaPrimitive->getTangentIndices().getData();
-        semanticData[semantic] = &colladaMesh->getTangents();
-        primitive->attributes[semantic] = (GLTF::Accessor*)NULL;
+  size_t meshPrimitivesCount = snapshot.primitives.size();
+  if (meshPrimitivesCount > 0) {
+    // Create primitives, in parallel when threads are available. The results
+    // are merged in order so the output does not depend on scheduling.
+    std::vector<std::vector<MeshPrimitiveResult>> results(meshPrimitivesCount);
+    auto writePrimitive = [this, &snapshot, &results](size_t i) {
+      results[i] = writeMeshPrimitive(snapshot, snapshot.primitives[i]);
+    };
+    if (_threadPool != NULL && _options->threads > 1 &&
+        meshPrimitivesCount > 1) {
+      _threadPool->parallelFor(meshPrimitivesCount, writePrimitive);
+    } else {
+      for (size_t i = 0; i < meshPrimitivesCount; i++) {
+        writePrimitive(i);
       }
-      if (colladaPrimitive->hasUVCoordIndices()) {
-        COLLADAFW::IndexListArray& uvCoordIndicesArray =
-            colladaPrimitive->getUVCoordIndicesArray();
-        size_t uvCoordIndicesArrayCount = uvCoordIndicesArray.getCount();
-        for (size_t j = 0; j < uvCoordIndicesArrayCount; j++) {
-          semantic = "TEXCOORD_" + std::to_string(j);
-          texCoordSetMapping[uvCoordIndicesArray[j]->getSetIndex()] = j;
-          buildAttributes[semantic] = std::vector<float>();
-          semanticIndices[semantic] =
-              uvCoordIndicesArray[j]->getIndices().getData();
-          semanticData[semantic] = &colladaMesh->getUVCoords();
-          primitive->attributes[semantic] = (GLTF::Accessor*)NULL;
+    }
+    for (std::vector<MeshPrimitiveResult>& primitiveResults : results) {
+      for (MeshPrimitiveResult& result : primitiveResults) {
+        GLTF::Primitive* primitive = result.primitive;
+        meshResult.materialPrimitiveMapping[result.materialId].insert(
+            primitive);
+        if (!result.success) {
+          meshResult.success = false;
+          return meshResult;
         }
-      }
-      if (colladaPrimitive->hasColorIndices()) {
-        COLLADAFW::IndexListArray& colorIndicesArray =
-            colladaPrimitive->getColorIndicesArray();
-        size_t colorIndicesArrayCount = colorIndicesArray.getCount();
-        for (size_t j = 0; j < colorIndicesArrayCount; j++) {
-          semantic = "COLOR_" + std::to_string(j);
-          buildAttributes[semantic] = std::vector<float>();
-          semanticIndices[semantic] =
-              colorIndicesArray[j]->getIndices().getData();
-          semanticData[semantic] = &colladaMesh->getColors();
-          primitive->attributes[semantic] = (GLTF::Accessor*)NULL;
+        if (primitive->mode == GLTF::Primitive::Mode::UNKNOWN) {
+          continue;
         }
+        for (const auto& entry : result.texCoordSetMapping) {
+          meshResult.texCoordSetMapping[entry.first] = entry.second;
+        }
+        mesh->primitives.push_back(primitive);
+        meshResult.positionMapping[primitive] =
+            std::move(result.positionMapping);
       }
+    }
+  }
+  return meshResult;
+}
 
-      unsigned int index = 0;
-      unsigned int face = 0;
-      unsigned int startFace = 0;
-      unsigned int totalVertexCount = 0;
-      unsigned int vertexCount = 0;
-      unsigned int faceVertexCount =
-          colladaPrimitive->getGroupedVerticesVertexCount(face);
-      for (int j = 0; j < count; j++) {
-        std::string attributeId;
-        if (shouldTriangulate) {
-          // This approach is very efficient in terms of runtime, but there are
-          // more correct solutions that may be worth considering. Using a 3D
-          // variant of Fortune's Algorithm or something similar to compute a
-          // mesh with no overlapping triangles would be ideal.
-          if (vertexCount >= faceVertexCount) {
-            unsigned int end = buildIndices.size() - 1;
-            if (faceVertexCount > 3) {
-              // Make a triangle with the last two points and the first one
-              buildIndices.push_back(buildIndices[end - 1]);
-              buildIndices.push_back(buildIndices[end]);
-              buildIndices.push_back(buildIndices[startFace]);
-              totalVertexCount += 3;
-            }
-            face++;
-            faceVertexCount =
-                colladaPrimitive->getGroupedVerticesVertexCount(face);
-            startFace = totalVertexCount;
-            vertexCount = 0;
-          } else if (vertexCount >= 3) {
-            // Add the previous two points to complete the triangle
-            unsigned int end = buildIndices.size() - 1;
-            buildIndices.push_back(buildIndices[end - 1]);
-            buildIndices.push_back(buildIndices[end]);
-            totalVertexCount += 2;
-          }
-        }
-        for (const auto& entry : semanticIndices) {
-          semantic = entry.first;
-          unsigned int numberOfComponents = 3;
-          if (semantic.find("TEXCOORD") == 0) {
-            numberOfComponents = 2;
-          }
-          attributeId += buildAttributeId(*semanticData[semantic],
-                                          semanticIndices[semantic][j],
-                                          numberOfComponents);
-        }
-        std::map<std::string, unsigned int>::iterator search =
-            attributeIndicesMapping.find(attributeId);
-        if (search != attributeIndicesMapping.end()) {
-          buildIndices.push_back(search->second);
-        } else {
-          for (const auto& entry : buildAttributes) {
-            semantic = entry.first;
-            unsigned int numberOfComponents = 3;
-            bool flipY = false;
-            bool position = false;
-            if (semantic.find("TEXCOORD") == 0) {
-              numberOfComponents = 2;
-              flipY = true;
-            }
-            unsigned int semanticIndex = semanticIndices[semantic][j];
-            if (semantic == "POSITION") {
-              position = true;
-              mapping.push_back(semanticIndex);
-            }
-            const COLLADAFW::MeshVertexData* vertexData =
-                semanticData[semantic];
-            unsigned int stride = numberOfComponents;
-            if (vertexData->getNumInputInfos() > 0) {
-              stride = vertexData->getStride(0);
-            }
-            for (unsigned int k = 0; k < numberOfComponents; k++) {
-              float value = getMeshVertexDataAtIndex(
-                  *vertexData, semanticIndex * stride + k);
-              if (flipY && k == 1) {
-                value = 1 - value;
-              }
-              if (position) {
-                value = value * _assetScale;
-              }
-              buildAttributes[semantic].push_back(value);
-            }
-          }
-          attributeIndicesMapping[attributeId] = index;
-          buildIndices.push_back(index);
-          index++;
-        }
-        totalVertexCount++;
-        vertexCount++;
+/**
+ * Stores a mesh built by `buildMesh` so that it can be referenced by nodes and
+ * controllers.
+ *
+ * @return `false` if the mesh could not be built
+ */
+bool COLLADA2GLTF::Writer::storeMesh(const COLLADAFW::UniqueId& uniqueId,
+                                     MeshResult* result) {
+  if (!result->success) {
+    return false;
+  }
+  _meshMaterialPrimitiveMapping[uniqueId] =
+      std::move(result->materialPrimitiveMapping);
+  _meshPositionMapping[uniqueId] = std::move(result->positionMapping);
+  _meshTexCoordSetMapping[result->mesh] =
+      std::move(result->texCoordSetMapping);
+  _meshInstances[uniqueId] = result->mesh;
+  return true;
+}
+
+/**
+ * Waits for a pipelined mesh to finish building and stores it. Does nothing if
+ * the mesh is not pending.
+ *
+ * @return `false` if the mesh could not be built
+ */
+bool COLLADA2GLTF::Writer::waitForMesh(const COLLADAFW::UniqueId& uniqueId) {
+  for (auto iter = _pendingMeshes.begin(); iter != _pendingMeshes.end();
+       iter++) {
+    if (iter->first == uniqueId) {
+      std::future<MeshResult> future = std::move(iter->second);
+      _pendingMeshes.erase(iter);
+      _threadPool->wait(future);
+      MeshResult result = future.get();
+      return storeMesh(uniqueId, &result);
+    }
+  }
+  return true;
+}
+
+/**
+ * Waits for all pipelined meshes to finish building and stores them.
+ *
+ * @return `false` if any mesh could not be built
+ */
+bool COLLADA2GLTF::Writer::waitForMeshes() {
+  bool success = true;
+  while (!_pendingMeshes.empty()) {
+    if (!waitForMesh(_pendingMeshes.front().first)) {
+      success = false;
+    }
+  }
+  return success;
+}
+
+/**
+ * Converts a single primitive of a mesh snapshot to a <GLTF::Primitive>,
+ * triangulating polygons and deduplicating vertices. With the
+ * `splitPrimitives` option, primitives with more vertices than `UNSIGNED_SHORT`
+ * indices can reference are split into several primitives.
+ *
+ * This only reads from the snapshot and the writer options, and writes to
+ * the returned results, so it is safe to call for several primitives of the
+ * same mesh in parallel.
+ *
+ * @param snapshot The COLLADA mesh owning the primitive
+ * @param colladaPrimitive The COLLADA primitive to write to glTF
+ * @return The converted primitives along with the mappings `writeMesh` needs
+ * to merge them into the mesh
+ */
+std::vector<COLLADA2GLTF::Writer::MeshPrimitiveResult>
+COLLADA2GLTF::Writer::writeMeshPrimitive(
+    const MeshSnapshot& snapshot,
+    const MeshSnapshot::Primitive& colladaPrimitive) {
+  std::vector<MeshPrimitiveResult> results(1);
+  MeshPrimitiveResult& result = results[0];
+  std::map<std::string, std::vector<float>> buildAttributes;
+  std::vector<unsigned int> buildIndices;
+  GLTF::Primitive* primitive = new GLTF::Primitive();
+  result.primitive = primitive;
+  result.materialId = colladaPrimitive.materialId;
+  primitive->mode = colladaPrimitive.mode;
+
+  std::vector<unsigned int>& mapping = result.positionMapping;
+  bool shouldTriangulate = colladaPrimitive.triangulate;
+  if (primitive->mode == GLTF::Primitive::Mode::UNKNOWN) {
+    return results;
+  }
+  size_t count = colladaPrimitive.count;
+  std::map<std::string, const unsigned int*> semanticIndices;
+  std::map<std::string, const MeshSnapshot::VertexData*> semanticData;
+  std::string semantic = "POSITION";
+  buildAttributes[semantic] = std::vector<float>();
+  semanticIndices[semantic] = colladaPrimitive.positionIndices;
+  semanticData[semantic] = &snapshot.positions;
+  primitive->attributes[semantic] = (GLTF::Accessor*)NULL;
+  if (colladaPrimitive.normalIndices != NULL) {
+    semantic = "NORMAL";
+    buildAttributes[semantic] = std::vector<float>();
+    semanticIndices[semantic] = colladaPrimitive.normalIndices;
+    semanticData[semantic] = &snapshot.normals;
+    primitive->attributes[semantic] = (GLTF::Accessor*)NULL;
+  }
+  if (colladaPrimitive.binormalIndices != NULL) {
+    semantic = "BINORMAL";
+    buildAttributes[semantic] = std::vector<float>();
+    semanticIndices[semantic] = colladaPrimitive.binormalIndices;
+    semanticData[semantic] = &snapshot.binormals;
+    primitive->attributes[semantic] = (GLTF::Accessor*)NULL;
+  }
+  if (colladaPrimitive.tangentIndices != NULL) {
+    semantic = "TANGENT";
+    buildAttributes[semantic] = std::vector<float>();
+    semanticIndices[semantic] = colladaPrimitive.tangentIndices;
+    semanticData[semantic] = &snapshot.tangents;
+    primitive->attributes[semantic] = (GLTF::Accessor*)NULL;
+  }
+  for (size_t j = 0; j < colladaPrimitive.uvCoordIndices.size(); j++) {
+    const MeshSnapshot::IndexList& indexList =
+        colladaPrimitive.uvCoordIndices[j];
+    semantic = "TEXCOORD_" + std::to_string(j);
+    result.texCoordSetMapping[indexList.setIndex] = j;
+    buildAttributes[semantic] = std::vector<float>();
+    semanticIndices[semantic] = indexList.indices;
+    semanticData[semantic] = &snapshot.uvCoords;
+    primitive->attributes[semantic] = (GLTF::Accessor*)NULL;
+  }
+  for (size_t j = 0; j < colladaPrimitive.colorIndices.size(); j++) {
+    semantic = "COLOR_" + std::to_string(j);
+    buildAttributes[semantic] = std::vector<float>();
+    semanticIndices[semantic] = colladaPrimitive.colorIndices[j].indices;
+    semanticData[semantic] = &snapshot.colors;
+    primitive->attributes[semantic] = (GLTF::Accessor*)NULL;
+  }
+
+  std::vector<SemanticSource> sources;
+  size_t vertexLength = 0;
+  for (auto& entry : buildAttributes) {
+    SemanticSource source;
+    source.buildData = &entry.second;
+    source.indices = semanticIndices[entry.first];
+    source.data = semanticData[entry.first];
+    source.numberOfComponents = 3;
+    source.position = entry.first == "POSITION";
+    // Offsets of -0 leave every value, including negative zeros, unchanged
+    for (unsigned int k = 0; k < 4; k++) {
+      source.scale[k] = source.position ? _assetScale : 1;
+      source.offset[k] = -0.0f;
+    }
+    if (entry.first.find("TEXCOORD") == 0) {
+      // Flip V
+      source.numberOfComponents = 2;
+      source.scale[1] = -1;
+      source.offset[1] = 1;
+    }
+    source.stride = source.numberOfComponents;
+    if (source.data->stride > 0) {
+      source.stride = source.data->stride;
+    }
+    source.gathered.resize(std::min(count, GATHER_BLOCK_SIZE) *
+                           source.numberOfComponents);
+    vertexLength += source.numberOfComponents;
+    sources.push_back(source);
+  }
+  std::vector<float> vertex(vertexLength);
+  VertexHashTable vertexHashTable(vertexLength, count);
+
+  unsigned int index = 0;
+  unsigned int face = 0;
+  unsigned int startFace = 0;
+  unsigned int totalVertexCount = 0;
+  unsigned int vertexCount = 0;
+  const std::vector<unsigned int>& faceVertexCounts =
+      colladaPrimitive.faceVertexCounts;
+  unsigned int faceVertexCount =
+      faceVertexCounts.empty() ? 0 : faceVertexCounts[face];
+  size_t blockStart = 0;
+  size_t blockEnd = 0;
+  for (size_t j = 0; j < count; j++) {
+    if (j == blockEnd) {
+      blockStart = j;
+      blockEnd = std::min(count, j + GATHER_BLOCK_SIZE);
+      for (SemanticSource& source : sources) {
+        gatherSemanticSource(&source, blockStart, blockEnd - blockStart);
       }
-      if (shouldTriangulate && faceVertexCount > 3) {
-        // Close the last polyshape
-        int end = buildIndices.size() - 1;
+    }
+    if (shouldTriangulate) {
+      // This approach is very efficient in terms of runtime, but there are
+      // more correct solutions that may be worth considering. Using a 3D
+      // variant of Fortune's Algorithm or something similar to compute a
+      // mesh with no overlapping triangles would be ideal.
+      if (vertexCount >= faceVertexCount) {
+        unsigned int end = buildIndices.size() - 1;
+        if (faceVertexCount > 3) {
+          // Make a triangle with the last two points and the first one
+          buildIndices.push_back(buildIndices[end - 1]);
+          buildIndices.push_back(buildIndices[end]);
+          buildIndices.push_back(buildIndices[startFace]);
+          totalVertexCount += 3;
+        }
+        face++;
+        faceVertexCount =
+            face < faceVertexCounts.size() ? faceVertexCounts[face] : 0;
+        startFace = totalVertexCount;
+        vertexCount = 0;
+      } else if (vertexCount >= 3) {
+        // Add the previous two points to complete the triangle
+        unsigned int end = buildIndices.size() - 1;
         buildIndices.push_back(buildIndices[end - 1]);
         buildIndices.push_back(buildIndices[end]);
-        buildIndices.push_back(buildIndices[startFace]);
+        totalVertexCount += 2;
       }
-      if (_options->dracoCompression) {
-        // Currently only support triangles.
-        if (primitive->mode == GLTF::Primitive::Mode::TRIANGLES) {
-          if (!addAttributesToDracoMesh(primitive, buildAttributes,
-                                        buildIndices)) {
-            // Error adding attributes to draco mesh.
-            return false;
-          }
+    }
+    float* vertexComponent = vertex.data();
+    for (const SemanticSource& source : sources) {
+      size_t offset = (j - blockStart) * source.numberOfComponents;
+      std::memcpy(vertexComponent, &source.gathered[offset],
+                  source.numberOfComponents * sizeof(float));
+      vertexComponent += source.numberOfComponents;
+    }
+    bool inserted;
+    unsigned int vertexIndex =
+        vertexHashTable.findOrInsert(vertex.data(), &inserted);
+    if (inserted) {
+      vertexComponent = vertex.data();
+      for (const SemanticSource& source : sources) {
+        if (source.position) {
+          mapping.push_back(source.indices[j]);
         }
+        source.buildData->insert(
+            source.buildData->end(), vertexComponent,
+            vertexComponent + source.numberOfComponents);
+        vertexComponent += source.numberOfComponents;
       }
-
-      // Create indices accessor
-      GLTF::Accessor* indices = NULL;
-      if (index < 65536) {
-        // We can fit this in an UNSIGNED_SHORT
-        std::vector<uint16_t> unsignedShortIndices(buildIndices.begin(),
-                                                   buildIndices.end());
-        indices =
-            new GLTF::Accessor(GLTF::Accessor::Type::SCALAR,
-                               GLTF::Constants::WebGL::UNSIGNED_SHORT,
-                               (unsigned char*)&unsignedShortIndices[0],
-                               unsignedShortIndices.size(),
-                               GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
-      } else {
-        // Leave as UNSIGNED_INT
-        indices = new GLTF::Accessor(
-            GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::UNSIGNED_INT,
-            (unsigned char*)&buildIndices[0], buildIndices.size(),
-            GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+      index++;
+    }
+    buildIndices.push_back(vertexIndex);
+    totalVertexCount++;
+    vertexCount++;
+  }
+  if (shouldTriangulate && faceVertexCount > 3) {
+    // Close the last polyshape
+    int end = buildIndices.size() - 1;
+    buildIndices.push_back(buildIndices[end - 1]);
+    buildIndices.push_back(buildIndices[end]);
+    buildIndices.push_back(buildIndices[startFace]);
+  }
+  size_t primitiveSize = 0;
+  if (primitive->mode == GLTF::Primitive::Mode::TRIANGLES) {
+    primitiveSize = 3;
+  } else if (primitive->mode == GLTF::Primitive::Mode::LINES) {
+    primitiveSize = 2;
+  } else if (primitive->mode == GLTF::Primitive::Mode::POINTS) {
+    primitiveSize = 1;
+  }
+  if (!_options->splitPrimitives || index <= MAX_SPLIT_VERTEX_COUNT ||
+      primitiveSize == 0) {
+    result.success = writePrimitiveAccessors(
+        primitive, std::move(buildAttributes), std::move(buildIndices), index);
+    return results;
+  }
+
+  // Split into primitives that can use UNSIGNED_SHORT indices, leaving
+  // 65535 free as it is the primitive restart value
+  std::vector<GLTF::MeshOptimizer::IndexChunk> chunks =
+      GLTF::MeshOptimizer::splitIndices(buildIndices, primitiveSize,
+                                        MAX_SPLIT_VERTEX_COUNT);
+  std::vector<MeshPrimitiveResult> chunkResults(chunks.size());
+  for (size_t i = 0; i < chunks.size(); i++) {
+    GLTF::MeshOptimizer::IndexChunk& chunk = chunks[i];
+    MeshPrimitiveResult& chunkResult = chunkResults[i];
+    chunkResult.primitive = new GLTF::Primitive();
+    chunkResult.primitive->mode = primitive->mode;
+    chunkResult.materialId = result.materialId;
+    chunkResult.texCoordSetMapping = result.texCoordSetMapping;
+    std::map<std::string, std::vector<float>> chunkAttributes;
+    for (const auto& entry : buildAttributes) {
+      size_t numberOfComponents = entry.second.size() / index;
+      std::vector<float>& chunkData = chunkAttributes[entry.first];
+      chunkData.reserve(chunk.vertices.size() * numberOfComponents);
+      for (unsigned int vertex : chunk.vertices) {
+        const float* data = &entry.second[vertex * numberOfComponents];
+        chunkData.insert(chunkData.end(), data, data + numberOfComponents);
       }
-      primitive->indices = indices;
-      mesh->primitives.push_back(primitive);
-      // Create attribute accessors
-      for (const auto& entry : buildAttributes) {
-        std::string semantic = entry.first;
-        std::vector<float> attributeData = entry.second;
-        GLTF::Accessor::Type type = GLTF::Accessor::Type::VEC3;
-        if (semantic.find("TEXCOORD") == 0) {
-          type = GLTF::Accessor::Type::VEC2;
-        }
-        GLTF::Accessor* accessor = new GLTF::Accessor(
-            type, GLTF::Constants::WebGL::FLOAT,
-            (unsigned char*)&attributeData[0],
-            attributeData.size() / GLTF::Accessor::getNumberOfComponents(type),
-            GLTF::Constants::WebGL::ARRAY_BUFFER);
-        primitive->attributes[semantic] = accessor;
+    }
+    for (unsigned int vertex : chunk.vertices) {
+      chunkResult.positionMapping.push_back(mapping[vertex]);
+    }
+    chunkResult.success = writePrimitiveAccessors(
+        chunkResult.primitive, std::move(chunkAttributes),
+        std::move(chunk.indices), chunk.vertices.size());
+  }
+  delete primitive;
+  return chunkResults;
+}
+
+/**
+ * Creates the indices and attribute accessors of a primitive, and its Draco
+ * mesh when compressing. The accessors take ownership of the built data
+ * instead of copying it.
+ *
+ * @return `false` if the Draco mesh could not be built
+ */
+bool COLLADA2GLTF::Writer::writePrimitiveAccessors(
+    GLTF::Primitive* primitive,
+    std::map<std::string, std::vector<float>>&& buildAttributes,
+    std::vector<unsigned int>&& buildIndices, size_t vertexCount) {
+  if (_options->dracoCompression) {
+    // Currently only support triangles.
+    if (primitive->mode == GLTF::Primitive::Mode::TRIANGLES) {
+      if (!addAttributesToDracoMesh(primitive, buildAttributes,
+                                    buildIndices)) {
+        // Error adding attributes to draco mesh.
+        return false;
       }
-      positionMapping[primitive] = mapping;
     }
   }
-  _meshMaterialPrimitiveMapping[uniqueId] = primitiveMaterialMapping;
-  _meshPositionMapping[uniqueId] = positionMapping;
-  _meshTexCoordSetMapping[mesh] = texCoordSetMapping;
-  _meshInstances[uniqueId] = mesh;
+
+  // Create indices accessor
+  GLTF::Accessor* indices = NULL;
+  if (_options->splitPrimitives && vertexCount < 256) {
+    std::vector<uint8_t> unsignedByteIndices(buildIndices.begin(),
+                                             buildIndices.end());
+    indices = new GLTF::Accessor(
+        GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::UNSIGNED_BYTE,
+        std::move(unsignedByteIndices),
+        GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+  } else if (vertexCount < 65536) {
+    // We can fit this in an UNSIGNED_SHORT
+    std::vector<uint16_t> unsignedShortIndices(buildIndices.begin(),
+                                               buildIndices.end());
+    indices = new GLTF::Accessor(
+        GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::UNSIGNED_SHORT,
+        std::move(unsignedShortIndices),
+        GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+  } else {
+    // Leave as UNSIGNED_INT
+    indices = new GLTF::Accessor(
+        GLTF::Accessor::Type::SCALAR, GLTF::Constants::WebGL::UNSIGNED_INT,
+        std::move(buildIndices), GLTF::Constants::WebGL::ELEMENT_ARRAY_BUFFER);
+  }
+  primitive->indices = indices;
+  // Create attribute accessors
+  for (auto& entry : buildAttributes) {
+    std::string semantic = entry.first;
+    GLTF::Accessor::Type type = GLTF::Accessor::Type::VEC3;
+    if (semantic.find("TEXCOORD") == 0) {
+      type = GLTF::Accessor::Type::VEC2;
+    }
+    GLTF::Accessor* accessor = new GLTF::Accessor(
+        type, GLTF::Constants::WebGL::FLOAT, std::move(entry.second),
+        GLTF::Constants::WebGL::ARRAY_BUFFER);
+    primitive->attributes[semantic] = accessor;
+  }
   return true;
 }
 
@@ -1010,7 +1334,7 @@ bool COLLADA2GLTF::Writer::addAttributesToDracoMesh(
   for (const auto& entry : buildAttributes) {
     // First create Accessor without data.
     std::string semantic = entry.first;
-    std::vector<float> attributeData = entry.second;
+    const std::vector<float>& attributeData = entry.second;
     GLTF::Accessor::Type type = semantic.find("TEXCOORD") == 0
                                     ? GLTF::Accessor::Type::VEC2
                                     : GLTF::Accessor::Type::VEC3;
@@ -2081,6 +2405,45 @@ bool COLLADA2GLTF::Writer::writeSkinControllerData(
   return true;
 }
 
+/**
+ * Reads the elements of an accessor as floats.
+ */
+std::vector<float> readFloatElements(GLTF::Accessor* accessor) {
+  std::vector<float> values(accessor->count *
+                            accessor->getNumberOfComponents());
+  accessor->getComponents(values.data());
+  return values;
+}
+
+/**
+ * Creates the displacements of a morph target attribute relative to the base
+ * attribute, subtracting all components in a single loop. Elements that a
+ * shorter target does not have are not displaced.
+ *
+ * @param baseAccessor The attribute of the base primitive
+ * @param targetAccessor The same attribute of the morph target primitive, or
+ * `NULL` for no displacement
+ */
+GLTF::Accessor* createMorphTargetAccessor(GLTF::Accessor* baseAccessor,
+                                          GLTF::Accessor* targetAccessor) {
+  size_t numberOfComponents = baseAccessor->getNumberOfComponents();
+  std::vector<float> displacements(baseAccessor->count * numberOfComponents);
+  if (targetAccessor != NULL) {
+    std::vector<float> base = readFloatElements(baseAccessor);
+    std::vector<float> target = readFloatElements(targetAccessor);
+    size_t length = std::min(base.size(), target.size());
+    const float* baseValues = base.data();
+    const float* targetValues = target.data();
+    float* displacementValues = displacements.data();
+    for (size_t i = 0; i < length; i++) {
+      displacementValues[i] = targetValues[i] - baseValues[i];
+    }
+  }
+  return new GLTF::Accessor(baseAccessor->type, GLTF::Constants::WebGL::FLOAT,
+                            std::move(displacements),
+                            GLTF::Constants::WebGL::ARRAY_BUFFER);
+}
+
 /**
  * Creates a placeholder <GLTF::Skin> for each <COLLADAFW::SkinController>.
  * The produced skins are stored in `_skinInstances` indexed by their
@@ -2129,6 +2492,9 @@ bool COLLADA2GLTF::Writer::writeController(
     }
 
     COLLADAFW::UniqueId meshId = skinController->getSource();
+    if (!waitForMesh(meshId)) {
+      return false;
+    }
     GLTF::Mesh* mesh = _meshInstances[meshId];
 
     double* jointComponent = new double[numberOfComponents];
@@ -2137,12 +2503,12 @@ bool COLLADA2GLTF::Writer::writeController(
         _meshPositionMapping[meshId];
     for (const auto& primitiveEntry : positionMapping) {
       GLTF::Primitive* primitive = primitiveEntry.first;
-      int count = primitive->attributes["POSITION"]->count;
+      size_t count = primitive->attributes["POSITION"]->count;
       uint16_t* jointArray = new uint16_t[count * numberOfComponents];
       float* weightArray = new float[count * numberOfComponents];
 
       std::vector<unsigned int> mapping = primitiveEntry.second;
-      for (int i = 0; i < count; i++) {
+      for (size_t i = 0; i < count; i++) {
         int index = mapping[i];
         int* joint = joints[index];
         float* weight = weights[index];
@@ -2184,6 +2550,14 @@ bool COLLADA2GLTF::Writer::writeController(
         morphController->getMorphWeights();
 
     COLLADAFW::UniqueId meshId = morphController->getSource();
+    if (!waitForMesh(meshId)) {
+      return false;
+    }
+    for (size_t i = 0; i < morphTargets.getCount(); i++) {
+      if (!waitForMesh(morphTargets[i])) {
+        return false;
+      }
+    }
     GLTF::Mesh* mesh = _meshInstances[meshId];
 
     for (size_t i = 0; i < morphWeights.getValuesCount(); i++) {
@@ -2208,40 +2582,32 @@ bool COLLADA2GLTF::Writer::writeController(
     for (size_t i = 0; i < morphTargets.getCount(); i++) {
       COLLADAFW::UniqueId targetId = morphTargets[i];
       GLTF::Mesh* meshTarget = _meshInstances[targetId];
-      if (mesh->primitives.size() > 0 && meshTarget->primitives.size() > 0) {
-        // These attributes need to be re-written as displacements relative to
-        // the base primitive
-        std::map<std::string, GLTF::Accessor*> baseAttributes =
-            mesh->primitives[0]->attributes;
-        std::map<std::string, GLTF::Accessor*> targetAttributes =
-            meshTarget->primitives[0]->attributes;
+      // glTF requires every primitive to have the same targets, so targets
+      // are added to each primitive, matched up with the primitives of the
+      // target mesh in order. Primitives the target mesh does not have are
+      // not displaced.
+      for (size_t p = 0; p < mesh->primitives.size(); p++) {
+        GLTF::Primitive* primitive = mesh->primitives[p];
+        GLTF::Primitive* targetPrimitive = p < meshTarget->primitives.size()
+                                               ? meshTarget->primitives[p]
+                                               : NULL;
         std::map<std::string, GLTF::Accessor*> buildAttributes;
-        for (const auto& baseAttributeEntry : baseAttributes) {
+        for (const auto& baseAttributeEntry : primitive->attributes) {
           std::string attribute = baseAttributeEntry.first;
-          auto findAttribute = targetAttributes.find(attribute);
-          if (findAttribute != targetAttributes.end()) {
-            GLTF::Accessor* baseAccessor = baseAttributeEntry.second;
-            GLTF::Accessor* targetAccessor =
-                new GLTF::Accessor(findAttribute->second);
-            size_t numComponents = baseAccessor->getNumberOfComponents();
-            float* baseComponent = new float[numComponents];
-            float* targetComponent = new float[numComponents];
-            for (size_t j = 0;
-                 j < baseAccessor->count && j < targetAccessor->count; j++) {
-              baseAccessor->getComponentAtIndex(j, baseComponent);
-              targetAccessor->getComponentAtIndex(j, targetComponent);
-              for (size_t k = 0; k < numComponents; k++) {
-                targetComponent[k] = targetComponent[k] - baseComponent[k];
-              }
-              targetAccessor->writeComponentAtIndex(j, targetComponent);
+          if (targetPrimitive != NULL) {
+            auto findAttribute = targetPrimitive->attributes.find(attribute);
+            if (findAttribute != targetPrimitive->attributes.end()) {
+              buildAttributes[attribute] = createMorphTargetAccessor(
+                  baseAttributeEntry.second, findAttribute->second);
             }
-            targetAccessor->computeMinMax();
-            buildAttributes[attribute] = targetAccessor;
+          } else if (attribute == "POSITION") {
+            buildAttributes[attribute] =
+                createMorphTargetAccessor(baseAttributeEntry.second, NULL);
           }
         }
         GLTF::Primitive::Target* target = new GLTF::Primitive::Target();
         target->attributes = buildAttributes;
-        mesh->primitives[0]->targets.push_back(target);
+        primitive->targets.push_back(target);
       }
     }
   }
@@ -1,27 +1,36 @@
 // Copyright 2020 The Khronos® Group Inc.
 #include <stdio.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <ctime>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "COLLADA2GLTFExtrasHandler.h"
 #include "COLLADA2GLTFWriter.h"
 #include "COLLADASaxFWLLoader.h"
+#include "GLTFBufferWriter.h"
 #include "ahoy/ahoy.h"
 #include "rapidjson/document.h"
 #include "rapidjson/prettywriter.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
 
-const int HEADER_LENGTH = 12;
-const int CHUNK_HEADER_LENGTH = 8;
-
 int main(int argc, const char** argv) {
   COLLADA2GLTF::Options* options = new COLLADA2GLTF::Options();
 
   bool separate;
   bool separateTextures;
+  std::string bufferSplit;
+  std::string lods;
+  std::string lodScreenCoverage;
 
   ahoy::Parser* parser = new ahoy::Parser();
   parser->name("COLLADA2GLTF")
@@ -114,26 +123,157 @@ int main(int argc, const char** argv) {
 
   parser->define("qp", &options->positionQuantizationBits)
       ->description(
-          "position quantization bits used in Draco compression extension");
+          "position quantization bits used in Draco compression and mesh "
+          "quantization extensions");
 
   parser->define("qn", &options->normalQuantizationBits)
       ->description(
-          "normal quantization bits used in Draco compression extension");
+          "normal quantization bits used in Draco compression and mesh "
+          "quantization extensions");
 
   parser->define("qt", &options->texcoordQuantizationBits)
       ->description(
           "texture coordinate quantization bits used in Draco compression "
-          "extension");
+          "and mesh quantization extensions");
 
   parser->define("qc", &options->colorQuantizationBits)
       ->description(
-          "color quantization bits used in Draco compression extension");
+          "color quantization bits used in Draco compression and mesh "
+          "quantization extensions");
 
   parser->define("qj", &options->jointQuantizationBits)
       ->description(
           "joint indices and weights quantization bits used in Draco "
           "compression extension");
 
+  parser->define("threads", &options->threads)
+      ->description(
+          "number of threads used to build mesh primitives and pack "
+          "accessor data in parallel");
+
+  parser->define("deduplicateMeshes", &options->deduplicateMeshes)
+      ->defaults(false)
+      ->description(
+          "share one mesh between nodes using meshes with identical geometry "
+          "and materials, and report the bytes saved");
+
+  parser->define("deduplicateAccessors", &options->deduplicateAccessors)
+      ->defaults(false)
+      ->description(
+          "share one accessor between users of accessors with identical "
+          "content, and report the bytes saved");
+
+  parser->define("instance", &options->instance)
+      ->defaults(false)
+      ->description(
+          "draw static nodes repeating the same mesh with a single node using "
+          "the EXT_mesh_gpu_instancing extension");
+
+  parser->define("batch", &options->batch)
+      ->defaults(false)
+      ->description(
+          "bake the transforms of static nodes into their vertices and merge "
+          "primitives sharing a material, reducing draw calls");
+
+  parser->define("batchVertexCount", &options->batchVertexCount)
+      ->description("most vertices in a primitive merged by --batch");
+
+  parser->define("weld", &options->weld)
+      ->description(
+          "weld vertices whose positions differ by at most this much and "
+          "whose other attributes are within their tolerances, removing the "
+          "degenerate triangles this creates");
+
+  parser->define("weldNormal", &options->weldNormal)
+      ->description("normal tolerance used when welding vertices");
+
+  parser->define("weldTexcoord", &options->weldTexcoord)
+      ->description("texture coordinate tolerance used when welding vertices");
+
+  parser->define("weldColor", &options->weldColor)
+      ->description("vertex color tolerance used when welding vertices");
+
+  parser->define("optimizeVertexCache", &options->optimizeVertexCache)
+      ->defaults(false)
+      ->description(
+          "reorder triangles to improve GPU vertex cache hit rates and report "
+          "the average cache miss ratio before and after");
+
+  parser->define("optimizeOverdraw", &options->optimizeOverdraw)
+      ->defaults(false)
+      ->description(
+          "reorder clusters of triangles so that outward facing triangles "
+          "are drawn first, reducing overdraw");
+
+  parser->define("optimizeVertexFetch", &options->optimizeVertexFetch)
+      ->defaults(false)
+      ->description(
+          "reorder vertex attributes into the order the indices first use "
+          "them and report the vertex fetch overfetch before and after");
+
+  parser->define("interleave", &options->interleave)
+      ->defaults(false)
+      ->description(
+          "interleave the vertex attributes of each primitive in a single "
+          "bufferView");
+
+  parser->define("bufferSplit", &bufferSplit)
+      ->description(
+          "pack accessor data into several buffers: size:<bytes> for parts of "
+          "at most that size, e.g. size:64MB, mesh for one per mesh, or node "
+          "for one per node");
+
+  parser->define("accessorMinMax", &options->accessorMinMax)
+      ->defaults(false)
+      ->description(
+          "write min and max for every accessor, not only POSITION attributes "
+          "and animation inputs");
+
+  parser->define("sparseMorphTargets", &options->sparseMorphTargets)
+      ->description(
+          "store morph target attributes with fewer than this fraction of "
+          "non-zero displacements as sparse accessors, 0 turns this off");
+
+  parser->define("quantize", &options->quantize)
+      ->defaults(false)
+      ->description(
+          "store vertex attributes in smaller normalized integer types using "
+          "the KHR_mesh_quantization extension");
+
+  parser->define("meshopt", &options->meshoptCompression)
+      ->defaults(false)
+      ->description(
+          "compress vertex, index, animation and skin data using the "
+          "EXT_meshopt_compression extension");
+
+  parser->define("lods", &lods)
+      ->description(
+          "comma separated fractions of triangles to keep in each level of "
+          "detail, e.g. 0.5,0.25, linked with the MSFT_lod extension");
+
+  parser->define("lodScreenCoverage", &lodScreenCoverage)
+      ->description(
+          "comma separated screen coverage below which the full detail mesh "
+          "and each level of detail are no longer used, e.g. 0.5,0.2,0.05");
+
+  parser->define("lodError", &options->lodError)
+      ->description(
+          "largest simplification error for levels of detail, relative to "
+          "the mesh size");
+
+  parser->define("splitPrimitives", &options->splitPrimitives)
+      ->defaults(false)
+      ->description(
+          "split primitives with more than 65535 vertices into several "
+          "primitives with UNSIGNED_SHORT indices, and use UNSIGNED_BYTE "
+          "indices for primitives with fewer than 256 vertices");
+
+  parser->define("pipeline", &options->pipeline)
+      ->defaults(false)
+      ->description(
+          "convert meshes on worker threads while the input is still being "
+          "parsed");
+
   if (parser->parse(argc, argv)) {
     // Resolve and sanitize paths
     COLLADABU::URI inputPathURI =
@@ -194,6 +334,53 @@ int main(int argc, const char** argv) {
       options->embeddedTextures = false;
     }
 
+    for (const auto& list : {std::make_pair(&lods, &options->lods),
+                             std::make_pair(&lodScreenCoverage,
+                                            &options->lodScreenCoverage)}) {
+      std::stringstream stream(*list.first);
+      std::string value;
+      while (std::getline(stream, value, ',')) {
+        if (value.length() > 0) {
+          list.second->push_back(std::strtof(value.c_str(), NULL));
+        }
+      }
+    }
+    for (float ratio : options->lods) {
+      if (!(ratio > 0 && ratio < 1)) {
+        std::cout << "ERROR: lods must be between 0 and 1" << std::endl;
+        return -1;
+      }
+    }
+    for (float coverage : options->lodScreenCoverage) {
+      if (!(coverage >= 0 && coverage <= 1)) {
+        std::cout << "ERROR: lodScreenCoverage must be between 0 and 1"
+                  << std::endl;
+        return -1;
+      }
+    }
+
+    if (bufferSplit == "mesh" || bufferSplit == "node") {
+      options->bufferSplit = bufferSplit;
+    } else if (bufferSplit.compare(0, 5, "size:") == 0) {
+      char* unit;
+      double byteLength = std::strtod(bufferSplit.c_str() + 5, &unit);
+      std::map<std::string, double> units = {
+          {"", 1}, {"B", 1}, {"KB", 1 << 10}, {"MB", 1 << 20}, {"GB", 1 << 30}};
+      auto unitPtr = units.find(unit);
+      if (unitPtr == units.end() || byteLength * unitPtr->second < 4) {
+        std::cout << "ERROR: Invalid bufferSplit size '" << bufferSplit << "'"
+                  << std::endl;
+        return -1;
+      }
+      options->bufferSplit = "size";
+      options->bufferSplitByteLength =
+          static_cast<size_t>(byteLength * unitPtr->second);
+    } else if (bufferSplit != "") {
+      std::cout << "ERROR: bufferSplit must be size:<bytes>, mesh or node"
+                << std::endl;
+      return -1;
+    }
+
     if (options->version == "1.0" && !options->materialsCommon) {
       options->glsl = true;
     }
@@ -219,6 +406,25 @@ int main(int argc, const char** argv) {
       return -1;
     }
 
+    if (options->bufferSplit != "" && options->meshoptCompression) {
+      std::cout << "ERROR: Cannot enable bufferSplit with meshopt, which "
+                   "compresses into a single buffer"
+                << std::endl;
+      return -1;
+    }
+
+    // A weld tolerance of 0 turns welding off
+    if (!(options->weld >= 0) || !std::isfinite(options->weld)) {
+      std::cout << "ERROR: weld must be a finite tolerance of at least 0"
+                << std::endl;
+      return -1;
+    }
+
+    if (options->threads < 1) {
+      std::cout << "ERROR: threads must be at least 1" << std::endl;
+      return -1;
+    }
+
     // Create the output directory if it does not exist
 
     if (!COLLADABU::Utils::directoryExists(outputPathDir)) {
@@ -251,36 +457,139 @@ int main(int argc, const char** argv) {
       asset->removeUnusedSemantics();
     }
 
+    if (options->deduplicateMeshes) {
+      size_t before = 0;
+      size_t after = 0;
+      size_t bytesSaved = 0;
+      asset->deduplicateMeshes(&before, &after, &bytesSaved);
+      std::cout << "Deduplicated meshes: " << before << " -> " << after
+                << ", saved " << bytesSaved << " bytes" << std::endl;
+    }
+
+    if (options->instance && options->version != "1.0") {
+      size_t before = 0;
+      size_t after = 0;
+      asset->instanceMeshes(&before, &after);
+      std::cout << "Instanced nodes: " << before << " -> " << after
+                << std::endl;
+    }
+
+    if (options->batch) {
+      size_t before = 0;
+      size_t after = 0;
+      asset->mergeStaticPrimitives(options->batchVertexCount, &before, &after);
+      std::cout << "Batched draw calls: " << before << " -> " << after
+                << std::endl;
+    }
+
+    if (options->weld > 0) {
+      std::map<std::string, float> tolerances;
+      tolerances["POSITION"] = options->weld;
+      tolerances["NORMAL"] = options->weldNormal;
+      tolerances["TEXCOORD"] = options->weldTexcoord;
+      tolerances["COLOR"] = options->weldColor;
+      size_t before = 0;
+      size_t after = 0;
+      size_t removedTriangles = 0;
+      asset->weldVertices(tolerances, &before, &after, &removedTriangles);
+      std::cout << "Welded vertices: " << before << " -> " << after
+                << ", removed " << removedTriangles << " degenerate triangles"
+                << std::endl;
+    }
+
+    if (options->optimizeVertexCache) {
+      GLTF::MeshOptimizer::VertexCacheStatistics before;
+      GLTF::MeshOptimizer::VertexCacheStatistics after;
+      asset->optimizeVertexCache(&before, &after);
+      std::cout << "Vertex cache ACMR: " << before.getACMR() << " -> "
+                << after.getACMR() << ", ATVR: " << before.getATVR() << " -> "
+                << after.getATVR() << std::endl;
+    }
+
+    if (options->optimizeOverdraw) {
+      asset->optimizeOverdraw(1.05f);
+    }
+
+    // Vertex order depends on the final triangle order, so this comes last
+    if (options->optimizeVertexFetch) {
+      GLTF::MeshOptimizer::VertexFetchStatistics before;
+      GLTF::MeshOptimizer::VertexFetchStatistics after;
+      asset->optimizeVertexFetch(&before, &after);
+      std::cout << "Vertex fetch overfetch: " << before.getOverfetch()
+                << " -> " << after.getOverfetch() << std::endl;
+    }
+
+    if (options->lods.size() > 0 && options->version != "1.0") {
+      asset->generateLods(options->lods, options->lodScreenCoverage,
+                          options->lodError);
+    }
+
     if (options->dracoCompression) {
       asset->removeUncompressedBufferViews();
       asset->compressPrimitives(options);
     }
 
-    GLTF::Buffer* buffer = asset->packAccessors();
+    if (options->quantize) {
+      asset->quantizeAttributes(options);
+    }
+
+    if (options->sparseMorphTargets > 0 && options->version != "1.0") {
+      asset->sparsifyMorphTargets(options->sparseMorphTargets);
+    }
+
+    if (options->deduplicateAccessors) {
+      size_t before = 0;
+      size_t after = 0;
+      size_t bytesSaved = 0;
+      asset->deduplicateAccessors(&before, &after, &bytesSaved);
+      std::cout << "Deduplicated accessors: " << before << " -> " << after
+                << ", saved " << bytesSaved << " bytes" << std::endl;
+    }
+
+    std::vector<GLTF::Buffer*> buffers;
+    GLTF::Buffer* buffer = asset->packAccessors(options, &buffers);
+    if (buffers.size() > 1) {
+      std::cout << "Packed accessor data into " << buffers.size()
+                << " buffers" << std::endl;
+    }
+    if (options->meshoptCompression && options->version != "1.0") {
+      buffer = asset->compressBufferViews(buffer);
+    }
     if (options->binary && options->version == "1.0") {
       buffer->stringId = "binary_glTF";
     }
 
-    // Create image bufferViews for binary glTF
-    if (options->binary && options->embeddedTextures) {
-      size_t imageBufferLength = 0;
-      std::vector<GLTF::Image*> images = asset->getAllImages();
-      for (GLTF::Image* image : images) {
-        imageBufferLength += image->byteLength;
+    // Binary glTF holds at most 4 GiB, so larger buffers are split, with the
+    // parts that don't fit written to external files
+    if (options->binary && options->embeddedBuffers &&
+        options->version != "1.0" && !options->meshoptCompression) {
+      size_t maxByteLength = GLTF::GLB_MAX_BUFFER_BYTE_LENGTH;
+      if (options->embeddedTextures) {
+        for (GLTF::Image* image : asset->getAllImages()) {
+          maxByteLength -= std::min(maxByteLength, image->byteLength + 3);
+        }
       }
-      unsigned char* bufferData = buffer->data;
-      bufferData = (unsigned char*)realloc(
-          bufferData, buffer->byteLength + imageBufferLength);
-      size_t byteOffset = buffer->byteLength;
-      for (GLTF::Image* image : images) {
-        GLTF::BufferView* bufferView =
+      std::vector<GLTF::Buffer*> parts =
+          asset->splitBuffer(buffer, maxByteLength);
+      if (parts.size() > 1) {
+        std::cout << "Split buffer into " << parts.size()
+                  << " buffers for binary glTF" << std::endl;
+        buffers.insert(buffers.end(), parts.begin() + 1, parts.end());
+      }
+    }
+
+    // Lay out the binary buffer: the packed accessor data, followed by the
+    // images of binary glTF. Nothing is copied; each part is streamed from
+    // where it already is when the buffer is written.
+    GLTF::BufferWriter bufferWriter;
+    bufferWriter.add(buffer->data, buffer->byteLength);
+    if (options->binary && options->embeddedTextures) {
+      for (GLTF::Image* image : asset->getAllImages()) {
+        size_t byteOffset = bufferWriter.add(image->data, image->byteLength);
+        image->bufferView =
             new GLTF::BufferView(byteOffset, image->byteLength, buffer);
-        image->bufferView = bufferView;
-        std::memcpy(bufferData + byteOffset, image->data, image->byteLength);
-        byteOffset += image->byteLength;
       }
-      buffer->data = bufferData;
-      buffer->byteLength += imageBufferLength;
+      buffer->byteLength = bufferWriter.getByteLength();
     }
 
     rapidjson::StringBuffer s;
@@ -314,7 +623,25 @@ int main(int argc, const char** argv) {
           bufferURI.toNativePath(COLLADABU::Utils::getSystemType());
       FILE* file = fopen(bufferString.c_str(), "wb");
       if (file != NULL) {
-        fwrite(buffer->data, sizeof(unsigned char), buffer->byteLength, file);
+        bufferWriter.write(file);
+        fclose(file);
+      } else {
+        std::cout << "ERROR: Couldn't write buffer to path '" << bufferString
+                  << "'" << std::endl;
+      }
+    }
+
+    for (GLTF::Buffer* part : buffers) {
+      if (!part->external) {
+        continue;
+      }
+      COLLADABU::URI bufferURI =
+          COLLADABU::URI::nativePathToUri(outputPathDir + part->uri);
+      std::string bufferString =
+          bufferURI.toNativePath(COLLADABU::Utils::getSystemType());
+      FILE* file = fopen(bufferString.c_str(), "wb");
+      if (file != NULL) {
+        fwrite(part->data, sizeof(unsigned char), part->byteLength, file);
         fclose(file);
       } else {
         std::cout << "ERROR: Couldn't write buffer to path '" << bufferString
@@ -360,52 +687,11 @@ int main(int argc, const char** argv) {
     } else {
       FILE* file = fopen(options->outputPath.c_str(), "wb");
       if (file != NULL) {
-        fwrite("glTF", sizeof(char), 4, file);  // magic
-
-        uint32_t* writeHeader = new uint32_t[2];
-        // version
-        if (options->version == "1.0") {
-          writeHeader[0] = 1;
-        } else {
-          writeHeader[0] = 2;
+        int version = options->version == "1.0" ? 1 : 2;
+        if (!GLTF::writeGLB(file, jsonString, bufferWriter, version)) {
+          std::cout << "ERROR couldn't write binary glTF to path '"
+                    << options->outputPath << "'" << std::endl;
         }
-
-        int jsonPadding = (4 - (jsonString.length() & 3)) & 3;
-        int binPadding = (4 - (buffer->byteLength & 3)) & 3;
-
-        writeHeader[1] =
-            HEADER_LENGTH +
-            (CHUNK_HEADER_LENGTH + jsonString.length() + jsonPadding +
-             buffer->byteLength + binPadding);  // length
-        if (options->version != "1.0") {
-          writeHeader[1] += CHUNK_HEADER_LENGTH;
-        }
-        fwrite(writeHeader, sizeof(uint32_t), 2, file);  // GLB header
-
-        writeHeader[0] =
-            jsonString.length() +
-            jsonPadding;  // 2.0 - chunkLength / 1.0 - contentLength
-        if (options->version == "1.0") {
-          writeHeader[1] = 0;  // 1.0 - contentFormat
-        } else {
-          writeHeader[1] = 0x4E4F534A;  // 2.0 - chunkType JSON
-        }
-        fwrite(writeHeader, sizeof(uint32_t), 2, file);
-        fwrite(jsonString.c_str(), sizeof(char), jsonString.length(), file);
-        for (int i = 0; i < jsonPadding; i++) {
-          fwrite(" ", sizeof(char), 1, file);
-        }
-        if (options->version != "1.0") {
-          writeHeader[0] = buffer->byteLength + binPadding;  // chunkLength
-          writeHeader[1] = 0x004E4942;                       // chunkType BIN
-          fwrite(writeHeader, sizeof(uint32_t), 2, file);
-        }
-        fwrite(buffer->data, sizeof(unsigned char), buffer->byteLength, file);
-        for (int i = 0; i < binPadding; i++) {
-          fwrite("\0", sizeof(char), 1, file);
-        }
-        delete[] writeHeader;
-
         fclose(file);
       } else {
         std::cout << "ERROR couldn't write binary glTF to path '"
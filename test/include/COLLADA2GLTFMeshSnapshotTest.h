@@ -0,0 +1,7 @@
+// Copyright 2020 The Khronos® Group Inc.
+#pragma once
+
+#include "COLLADA2GLTFMeshSnapshot.h"
+#include "gtest/gtest.h"
+
+class COLLADA2GLTFMeshSnapshotTest : public ::testing::Test {};
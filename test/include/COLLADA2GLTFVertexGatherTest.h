@@ -0,0 +1,7 @@
+// Copyright 2020 The Khronos® Group Inc.
+#pragma once
+
+#include "COLLADA2GLTFVertexGather.h"
+#include "gtest/gtest.h"
+
+class COLLADA2GLTFVertexGatherTest : public ::testing::Test {};
@@ -0,0 +1,7 @@
+// Copyright 2020 The Khronos® Group Inc.
+#pragma once
+
+#include "COLLADA2GLTFVertexHashTable.h"
+#include "gtest/gtest.h"
+
+class COLLADA2GLTFVertexHashTableTest : public ::testing::Test {};
@@ -0,0 +1,86 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "COLLADA2GLTFMeshSnapshotTest.h"
+
+#include <vector>
+
+TEST(COLLADA2GLTFMeshSnapshotTest, VertexData_GetValue) {
+  float floatValues[2] = {1.5, 2.5};
+  double doubleValues[2] = {3.5, 4.5};
+  COLLADA2GLTF::MeshSnapshot::VertexData floatData;
+  floatData.floatValues = floatValues;
+  floatData.count = 2;
+  COLLADA2GLTF::MeshSnapshot::VertexData doubleData;
+  doubleData.doubleValues = doubleValues;
+  doubleData.count = 2;
+
+  EXPECT_EQ(floatData.getValue(1), 2.5);
+  EXPECT_EQ(doubleData.getValue(0), 3.5);
+}
+
+TEST(COLLADA2GLTFMeshSnapshotTest, Own_CopiesReferencedData) {
+  std::vector<float> positions = {0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0, 0.0};
+  std::vector<double> uvCoords = {0.0, 0.0, 1.0, 0.0, 0.0, 1.0};
+  std::vector<unsigned int> positionIndices = {0, 1, 2};
+  std::vector<unsigned int> uvCoordIndices = {2, 1, 0};
+
+  COLLADA2GLTF::MeshSnapshot snapshot;
+  snapshot.positions.floatValues = positions.data();
+  snapshot.positions.count = positions.size();
+  snapshot.uvCoords.doubleValues = uvCoords.data();
+  snapshot.uvCoords.count = uvCoords.size();
+  COLLADA2GLTF::MeshSnapshot::Primitive primitive;
+  primitive.mode = GLTF::Primitive::Mode::TRIANGLES;
+  primitive.count = 3;
+  primitive.positionIndices = positionIndices.data();
+  COLLADA2GLTF::MeshSnapshot::IndexList indexList;
+  indexList.indices = uvCoordIndices.data();
+  indexList.setIndex = 1;
+  primitive.uvCoordIndices.push_back(indexList);
+  snapshot.primitives.push_back(primitive);
+
+  snapshot.own();
+  positions.assign(positions.size(), -1.0);
+  uvCoords.assign(uvCoords.size(), -1.0);
+  positionIndices.assign(positionIndices.size(), 7);
+  uvCoordIndices.assign(uvCoordIndices.size(), 7);
+
+  EXPECT_NE(snapshot.positions.floatValues, positions.data());
+  EXPECT_EQ(snapshot.positions.getValue(3), 1.0);
+  EXPECT_EQ(snapshot.uvCoords.getValue(5), 1.0);
+  EXPECT_TRUE(snapshot.normals.floatValues == NULL);
+  const COLLADA2GLTF::MeshSnapshot::Primitive& ownedPrimitive =
+      snapshot.primitives[0];
+  EXPECT_EQ(ownedPrimitive.positionIndices[2], 2);
+  EXPECT_TRUE(ownedPrimitive.normalIndices == NULL);
+  EXPECT_EQ(ownedPrimitive.uvCoordIndices[0].indices[0], 2);
+  EXPECT_EQ(ownedPrimitive.uvCoordIndices[0].setIndex, 1);
+}
+
+TEST(COLLADA2GLTFMeshSnapshotTest, Own_MissingSources) {
+  // A mesh with only positions; its other sources are left empty
+  std::vector<float> positions = {0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0, 0.0};
+  std::vector<unsigned int> positionIndices = {0, 1, 2};
+
+  COLLADA2GLTF::MeshSnapshot snapshot;
+  snapshot.positions.floatValues = positions.data();
+  snapshot.positions.count = positions.size();
+  COLLADA2GLTF::MeshSnapshot::Primitive primitive;
+  primitive.mode = GLTF::Primitive::Mode::TRIANGLES;
+  primitive.count = 3;
+  primitive.positionIndices = positionIndices.data();
+  snapshot.primitives.push_back(primitive);
+
+  snapshot.own();
+  EXPECT_EQ(snapshot.positions.getValue(3), 1.0);
+  for (const COLLADA2GLTF::MeshSnapshot::VertexData* data :
+       {&snapshot.normals, &snapshot.tangents, &snapshot.colors}) {
+    EXPECT_TRUE(data->floatValues == NULL);
+    EXPECT_TRUE(data->doubleValues == NULL);
+    EXPECT_EQ(data->count, 0);
+  }
+  const COLLADA2GLTF::MeshSnapshot::Primitive& ownedPrimitive =
+      snapshot.primitives[0];
+  EXPECT_TRUE(ownedPrimitive.normalIndices == NULL);
+  EXPECT_TRUE(ownedPrimitive.tangentIndices == NULL);
+  EXPECT_TRUE(ownedPrimitive.colorIndices.empty());
+}
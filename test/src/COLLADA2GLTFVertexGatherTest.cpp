@@ -0,0 +1,147 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "COLLADA2GLTFVertexGatherTest.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+template <typename T>
+void expectMatchesScalar(unsigned int numberOfComponents, unsigned int stride,
+                         size_t count, const float* scale,
+                         const float* offset) {
+  std::mt19937 random(numberOfComponents * 31 + stride * 7 + count);
+  std::uniform_real_distribution<double> values(-100.0, 100.0);
+  size_t vertexCount = 50;
+  std::vector<T> source(vertexCount * stride);
+  for (T& value : source) {
+    value = static_cast<T>(values(random));
+  }
+  source[0] = static_cast<T>(-0.0);
+  std::uniform_int_distribution<unsigned int> vertices(0, vertexCount - 1);
+  std::vector<unsigned int> indices(count);
+  for (unsigned int& index : indices) {
+    index = vertices(random);
+  }
+  // Always gather the last vertex, so reads at the end of the source are
+  // exercised
+  indices[count / 2] = vertexCount - 1;
+
+  std::vector<float> expected(count * numberOfComponents);
+  std::vector<float> actual(count * numberOfComponents);
+  COLLADA2GLTF::gatherVertexDataScalar(indices.data(), count, source.data(),
+                                       stride, numberOfComponents, scale,
+                                       offset, expected.data());
+  COLLADA2GLTF::gatherVertexData(indices.data(), count, source.data(),
+                                 source.size(), stride, numberOfComponents,
+                                 scale, offset, actual.data());
+  // Compare bit patterns so that signed zeros must match too
+  EXPECT_EQ(std::memcmp(expected.data(), actual.data(),
+                        expected.size() * sizeof(float)),
+            0)
+      << numberOfComponents << " components, stride " << stride << ", "
+      << count << " vertices";
+}
+
+TEST(COLLADA2GLTFVertexGatherTest, GatherVertexData_MatchesScalar) {
+  float scale[4] = {2.54, 0.5, -3.0, 1.0};
+  float offset[4] = {-0.0f, -0.0f, -0.0f, -0.0f};
+  float flipScale[4] = {1.0, -1.0, 1.0, 1.0};
+  float flipOffset[4] = {-0.0f, 1.0, -0.0f, -0.0f};
+  for (unsigned int numberOfComponents = 1; numberOfComponents <= 4;
+       numberOfComponents++) {
+    for (unsigned int stride = numberOfComponents;
+         stride <= numberOfComponents + 1; stride++) {
+      for (size_t count : {1, 7, 8, 9, 64, 67}) {
+        expectMatchesScalar<float>(numberOfComponents, stride, count, scale,
+                                   offset);
+        expectMatchesScalar<double>(numberOfComponents, stride, count, scale,
+                                    offset);
+        expectMatchesScalar<float>(numberOfComponents, stride, count,
+                                   flipScale, flipOffset);
+        expectMatchesScalar<double>(numberOfComponents, stride, count,
+                                    flipScale, flipOffset);
+      }
+    }
+  }
+}
+
+TEST(COLLADA2GLTFVertexGatherTest, GatherVertexData_ConvertsValues) {
+  double source[6] = {0.25, 0.75, 1.0, 0.0, -0.0, 2.0};
+  unsigned int indices[3] = {2, 0, 1};
+  float flipScale[2] = {1.0, -1.0};
+  float flipOffset[2] = {-0.0f, 1.0};
+  float output[6];
+  COLLADA2GLTF::gatherVertexData(indices, 3, source, 6, 2, 2, flipScale,
+                                 flipOffset, output);
+  EXPECT_EQ(output[0], -0.0);
+  EXPECT_TRUE(std::signbit(output[0]));
+  EXPECT_EQ(output[1], -1.0);
+  EXPECT_EQ(output[2], 0.25);
+  EXPECT_EQ(output[3], 0.25);
+  EXPECT_EQ(output[4], 1.0);
+  EXPECT_EQ(output[5], 1.0);
+}
+
+// Compares the vectorized kernel against the scalar path for a large
+// POSITION-like semantic. Run with `--gtest_also_run_disabled_tests`.
+TEST(COLLADA2GLTFVertexGatherTest, DISABLED_Benchmark_GatherVertexData) {
+  const size_t vertexCount = 1000000;
+  const size_t count = 6000000;
+  std::mt19937 random(0);
+  std::uniform_real_distribution<double> values(-100.0, 100.0);
+  std::uniform_int_distribution<unsigned int> vertices(0, vertexCount - 1);
+  std::vector<float> floatSource(vertexCount * 3);
+  std::vector<double> doubleSource(vertexCount * 3);
+  for (size_t i = 0; i < floatSource.size(); i++) {
+    doubleSource[i] = values(random);
+    floatSource[i] = static_cast<float>(doubleSource[i]);
+  }
+  std::vector<unsigned int> indices(count);
+  for (unsigned int& index : indices) {
+    index = vertices(random);
+  }
+  float scale[3] = {0.0254, 0.0254, 0.0254};
+  float offset[3] = {-0.0f, -0.0f, -0.0f};
+  std::vector<float> expected(count * 3);
+  std::vector<float> actual(count * 3);
+
+  auto time = [](const std::function<void()>& function) {
+    auto start = std::chrono::steady_clock::now();
+    function();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  };
+  auto floatScalarTime = time([&]() {
+    COLLADA2GLTF::gatherVertexDataScalar(indices.data(), count,
+                                         floatSource.data(), 3, 3, scale,
+                                         offset, expected.data());
+  });
+  auto floatTime = time([&]() {
+    COLLADA2GLTF::gatherVertexData(indices.data(), count, floatSource.data(),
+                                   floatSource.size(), 3, 3, scale, offset,
+                                   actual.data());
+  });
+  EXPECT_EQ(expected, actual);
+  auto doubleScalarTime = time([&]() {
+    COLLADA2GLTF::gatherVertexDataScalar(indices.data(), count,
+                                         doubleSource.data(), 3, 3, scale,
+                                         offset, expected.data());
+  });
+  auto doubleTime = time([&]() {
+    COLLADA2GLTF::gatherVertexData(indices.data(), count, doubleSource.data(),
+                                   doubleSource.size(), 3, 3, scale, offset,
+                                   actual.data());
+  });
+  EXPECT_EQ(expected, actual);
+
+  std::cout << count << " vertices" << std::endl;
+  std::cout << "float scalar: " << floatScalarTime << " ms, vectorized: "
+            << floatTime << " ms" << std::endl;
+  std::cout << "double scalar: " << doubleScalarTime << " ms, vectorized: "
+            << doubleTime << " ms" << std::endl;
+}
@@ -0,0 +1,116 @@
+// Copyright 2020 The Khronos® Group Inc.
+#include "COLLADA2GLTFVertexHashTableTest.h"
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+TEST(COLLADA2GLTFVertexHashTableTest, FindOrInsert_DuplicateVertices) {
+  COLLADA2GLTF::VertexHashTable table(5, 4);
+  float a[5] = {1.0, 2.0, 3.0, 0.5, 0.25};
+  float b[5] = {1.0, 2.0, 3.0, 0.5, 0.75};
+  bool inserted;
+
+  EXPECT_EQ(table.findOrInsert(a, &inserted), 0);
+  EXPECT_TRUE(inserted);
+  EXPECT_EQ(table.findOrInsert(b, &inserted), 1);
+  EXPECT_TRUE(inserted);
+  EXPECT_EQ(table.findOrInsert(a, &inserted), 0);
+  EXPECT_FALSE(inserted);
+  EXPECT_EQ(table.findOrInsert(b, &inserted), 1);
+  EXPECT_FALSE(inserted);
+  EXPECT_EQ(table.size(), 2);
+}
+
+TEST(COLLADA2GLTFVertexHashTableTest, FindOrInsert_ComparesBitPatterns) {
+  COLLADA2GLTF::VertexHashTable table(1, 4);
+  float positiveZero = 0.0f;
+  float negativeZero = -0.0f;
+  bool inserted;
+
+  EXPECT_EQ(table.findOrInsert(&positiveZero, &inserted), 0);
+  EXPECT_EQ(table.findOrInsert(&negativeZero, &inserted), 1);
+  EXPECT_TRUE(inserted);
+}
+
+TEST(COLLADA2GLTFVertexHashTableTest, FindOrInsert_GrowsPastCapacity) {
+  COLLADA2GLTF::VertexHashTable table(3, 1);
+  bool inserted;
+  for (int i = 0; i < 1000; i++) {
+    float vertex[3] = {static_cast<float>(i), static_cast<float>(i % 7), 1.0};
+    EXPECT_EQ(table.findOrInsert(vertex, &inserted), i);
+    EXPECT_TRUE(inserted);
+  }
+  for (int i = 0; i < 1000; i++) {
+    float vertex[3] = {static_cast<float>(i), static_cast<float>(i % 7), 1.0};
+    EXPECT_EQ(table.findOrInsert(vertex, &inserted), i);
+    EXPECT_FALSE(inserted);
+  }
+  EXPECT_EQ(table.size(), 1000);
+}
+
+// Compares against the string keyed map previously used by
+// `Writer::writeMesh`. Run with `--gtest_also_run_disabled_tests`.
+TEST(COLLADA2GLTFVertexHashTableTest, DISABLED_Benchmark_LargeMesh) {
+  // A 1000x1000 grid of quads with per-corner POSITION, NORMAL and TEXCOORD_0
+  const int gridSize = 1000;
+  const int vertexLength = 8;
+  std::vector<float> corners;
+  for (int y = 0; y < gridSize; y++) {
+    for (int x = 0; x < gridSize; x++) {
+      int quad[6][2] = {{x, y},     {x + 1, y}, {x + 1, y + 1},
+                        {x, y + 1}, {x, y},     {x + 1, y + 1}};
+      for (int i = 0; i < 6; i++) {
+        float u = static_cast<float>(quad[i][0]) / gridSize;
+        float v = static_cast<float>(quad[i][1]) / gridSize;
+        float vertex[vertexLength] = {u * 10, v * 10, 0, 0, 0, 1, u, 1 - v};
+        corners.insert(corners.end(), vertex, vertex + vertexLength);
+      }
+    }
+  }
+  size_t count = corners.size() / vertexLength;
+
+  auto start = std::chrono::steady_clock::now();
+  std::map<std::string, unsigned int> attributeIndicesMapping;
+  std::vector<unsigned int> mapIndices;
+  for (size_t i = 0; i < count; i++) {
+    std::string attributeId;
+    for (int k = 0; k < vertexLength; k++) {
+      attributeId += std::to_string(corners[i * vertexLength + k]) + ":";
+    }
+    auto search = attributeIndicesMapping.find(attributeId);
+    if (search != attributeIndicesMapping.end()) {
+      mapIndices.push_back(search->second);
+    } else {
+      unsigned int index = attributeIndicesMapping.size();
+      attributeIndicesMapping[attributeId] = index;
+      mapIndices.push_back(index);
+    }
+  }
+  auto mapTime = std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  COLLADA2GLTF::VertexHashTable table(vertexLength, count);
+  std::vector<unsigned int> tableIndices;
+  bool inserted;
+  for (size_t i = 0; i < count; i++) {
+    tableIndices.push_back(
+        table.findOrInsert(&corners[i * vertexLength], &inserted));
+  }
+  auto tableTime = std::chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(mapIndices, tableIndices);
+  EXPECT_EQ(attributeIndicesMapping.size(), table.size());
+  std::cout << count << " corners, " << table.size() << " vertices"
+            << std::endl;
+  std::cout << "std::map<std::string>: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(mapTime)
+                   .count()
+            << " ms" << std::endl;
+  std::cout << "VertexHashTable: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(tableTime)
+                   .count()
+            << " ms" << std::endl;
+}
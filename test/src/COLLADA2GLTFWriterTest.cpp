@@ -151,3 +151,19 @@ TEST_F(COLLADA2GLTFWriterTest, WriteVisualScene_MultipleLevelsOfInstanceNodes) {
   ASSERT_EQ(sceneNodes[0]->children[0]->children.size(), 1);
   ASSERT_EQ(sceneNodes[1]->children[0]->children.size(), 1);
 }
+
+TEST_F(COLLADA2GLTFWriterTest, SnapshotMeshVertexData_UnknownType) {
+  // A mesh without normals has a normal source of unknown type
+  COLLADAFW::Mesh* mesh = new COLLADAFW::Mesh(
+      COLLADAFW::UniqueId(COLLADAFW::COLLADA_TYPE::MESH, 0, 0));
+  const COLLADAFW::MeshVertexData& normals = mesh->getNormals();
+  ASSERT_EQ(normals.getType(),
+            COLLADAFW::FloatOrDoubleArray::DATA_TYPE_UNKNOWN);
+  COLLADA2GLTF::MeshSnapshot::VertexData snapshot;
+  COLLADA2GLTF::Writer::snapshotMeshVertexData(normals, &snapshot);
+  EXPECT_TRUE(snapshot.floatValues == NULL);
+  EXPECT_TRUE(snapshot.doubleValues == NULL);
+  EXPECT_EQ(snapshot.count, 0);
+  EXPECT_EQ(snapshot.stride, 0);
+  delete mesh;
+}